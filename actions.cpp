@@ -8,6 +8,8 @@
 #include <shlobj_core.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <thread>
 
 static BOOL CALLBACK FindTreeViewCallback(HWND hwnd, LPARAM lParam);
 static int CALLBACK BFF_Callback(HWND hwnd, UINT uMsg, LPARAM lParam, LPARAM lpData);
@@ -141,6 +143,57 @@ LShellError:
     return true;
 }
 
+bool ShellChooseSaveFile(HWND hwnd, const WCHAR* title, const WCHAR* filter_name, const WCHAR* extension, std::wstring& inout)
+{
+    ThreadDpiAwarenessContext dpiContext(DPI_AWARENESS_CONTEXT_SYSTEM_AWARE);
+
+    SPI<IFileSaveDialog> spfd;
+    HRESULT hr = CoCreateInstance(CLSID_FileSaveDialog, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&spfd));
+    if (SUCCEEDED(hr))
+    {
+        DWORD dwOptions;
+        if (SUCCEEDED(spfd->GetOptions(&dwOptions)))
+            spfd->SetOptions(dwOptions|FOS_FORCEFILESYSTEM|FOS_OVERWRITEPROMPT|FOS_NOREADONLYRETURN|FOS_DONTADDTORECENT);
+
+        std::wstring spec(TEXT("*."));
+        spec.append(extension);
+        COMDLG_FILTERSPEC filter = { filter_name, spec.c_str() };
+        spfd->SetFileTypes(1, &filter);
+        spfd->SetDefaultExtension(extension);
+        if (inout.length())
+            spfd->SetFileName(inout.c_str());
+        if (title && *title)
+            spfd->SetTitle(title);
+
+        hr = spfd->Show(hwnd);
+        if (hr == HRESULT_FROM_WIN32(ERROR_CANCELLED))
+            return false;
+
+        SPI<IShellItem> spsi;
+        if (SUCCEEDED(hr))
+            hr = spfd->GetResult(&spsi);
+
+        LPWSTR pszName;
+        if (SUCCEEDED(hr))
+            hr = spsi->GetDisplayName(SIGDN_FILESYSPATH, &pszName);
+
+        if (SUCCEEDED(hr))
+        {
+            inout = pszName;
+            CoTaskMemFree(pszName);
+            return true;
+        }
+    }
+
+    WCHAR sz[2048];
+    DWORD const dwFlags = FORMAT_MESSAGE_FROM_SYSTEM|FORMAT_MESSAGE_IGNORE_INSERTS;
+    DWORD cch = FormatMessage(dwFlags, 0, hr, MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT), sz, _countof(sz), 0);
+    if (!cch)
+        swprintf_s(sz, _countof(sz), TEXT("Error 0x%08X."), hr);
+    MessageBox(hwnd, sz, TEXT("Elucidisk"), MB_OK|MB_ICONERROR);
+    return false;
+}
+
 //----------------------------------------------------------------------------
 // Helpers.
 
@@ -429,3 +482,264 @@ static bool ShellDeleteInternal(HWND hwnd, const WCHAR* _path, bool permanent)
     return true;
 }
 
+
+//----------------------------------------------------------------------------
+// Bulk delete.
+
+static bool ConfirmBulkDelete(HWND hwnd, const std::vector<std::wstring>& paths, bool permanent)
+{
+    size_t cautions = 0;
+    for (const auto& path : paths)
+    {
+        switch (AssessCautionLevel(path.c_str()))
+        {
+        case CautionLevel::Normal:
+            break;
+        case CautionLevel::Windows:
+            MessageBox(hwnd, TEXT("Sorry, deleting core Windows OS files and directories is too dangerous."), TEXT("Caution - Operating System Directories"), MB_OK|MB_ICONSTOP);
+            return false;
+        case CautionLevel::Error:
+            MessageBeep(0xffffffff);
+            return false;
+        default:
+            ++cautions;
+            break;
+        }
+    }
+
+    WCHAR message[2048];
+    if (cautions)
+    {
+        swprintf_s(message, _countof(message), TEXT("%zu of the %zu selected items are System Files or Special Directories.\r\n\r\nAre you sure you want to continue?"), cautions, paths.size());
+        if (MessageBox(hwnd, message, TEXT("Caution - System Files"), MB_YESNOCANCEL|MB_ICONWARNING) != IDYES)
+            return false;
+    }
+    else if (permanent)
+    {
+        swprintf_s(message, _countof(message), TEXT("Are you sure you want to permanently delete these %zu items?"), paths.size());
+        if (MessageBox(hwnd, message, TEXT("Confirm Delete"), MB_YESNOCANCEL|MB_ICONQUESTION) != IDYES)
+            return false;
+    }
+
+#ifdef DEBUG
+    if (MessageBox(hwnd, TEXT("FIRST EXTRA CONFIRMATION IN DEBUG BUILDS!"), TEXT("Caution - First Chance"), MB_YESNOCANCEL|MB_ICONWARNING) != IDYES)
+        return false;
+    if (MessageBox(hwnd, TEXT("LAST EXTRA CONFIRMATION IN DEBUG BUILDS!"), TEXT("Caution - Last Chance"), MB_YESNOCANCEL|MB_ICONWARNING) != IDYES)
+        return false;
+#endif
+
+    return true;
+}
+
+bool ShellRecycleMany(HWND hwnd, const std::vector<std::wstring>& paths)
+{
+    if (paths.empty() || !ConfirmBulkDelete(hwnd, paths, false/*permanent*/))
+        return false;
+
+    // One operation for the whole batch means one progress dialog (with
+    // Cancel) and one undo entry.
+    std::vector<WCHAR> pathzz;
+    for (const auto& path : paths)
+    {
+        pathzz.insert(pathzz.end(), path.begin(), path.end());
+        pathzz.push_back('\0');
+    }
+    pathzz.push_back('\0');
+
+    SHFILEOPSTRUCT op = { 0 };
+    op.hwnd = hwnd;
+    op.wFunc = FO_DELETE;
+    op.pFrom = pathzz.data();
+    op.fFlags = FOF_ALLOWUNDO|FOF_NO_CONNECTED_ELEMENTS|FOF_SIMPLEPROGRESS|FOF_WANTNUKEWARNING|FOF_NOCONFIRMATION;
+    op.lpszProgressTitle = TEXT("Recycling");
+
+    // Some items may have been recycled even if it fails or is cancelled,
+    // so the caller checks which ones are gone.
+    SHFileOperation(&op);
+    return true;
+}
+
+// The listed items are the units of work, which suits the usual case of many
+// build outputs; each tree is deleted depth first by the thread that picks
+// it up.  Reparse points are removed, never followed.
+
+constexpr unsigned c_max_delete_threads = 8;
+constexpr DWORD c_delete_progress_interval = 100;   // Milliseconds.
+
+BulkDeleter::~BulkDeleter()
+{
+    InterlockedExchange(&m_cancel, 1);
+    Finish();
+}
+
+void BulkDeleter::Start(HWND hwnd, UINT msg)
+{
+    m_hwnd = hwnd;
+    m_msg = msg;
+
+    // The progress dialog runs on its own thread, so Cancel stays
+    // responsive; it's checked whenever progress is posted.
+    if (SUCCEEDED(CoCreateInstance(CLSID_ProgressDialog, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&m_spProgress))))
+    {
+        m_spProgress->SetTitle(TEXT("Deleting"));
+        m_spProgress->StartProgressDialog(hwnd, nullptr, PROGDLG_NORMAL|PROGDLG_NOMINIMIZE, nullptr);
+    }
+
+    if (m_paths.empty())
+    {
+        PostMessage(m_hwnd, m_msg, BDM_DONE, 0);
+        return;
+    }
+
+    const unsigned count = std::max(1u, std::min<unsigned>(std::min<unsigned>(std::thread::hardware_concurrency(), c_max_delete_threads), unsigned(m_paths.size())));
+    for (unsigned ii = 0; ii < count; ++ii)
+        m_threads.emplace_back(WorkerProc, this);
+}
+
+void BulkDeleter::UpdateProgress()
+{
+    if (!m_spProgress)
+        return;
+
+    if (m_spProgress->HasUserCancelled())
+        InterlockedExchange(&m_cancel, 1);
+
+    WCHAR sz[100];
+    swprintf_s(sz, _countof(sz), TEXT("Deleted %llu items"), ULONGLONG(m_entries));
+    m_spProgress->SetLine(1, sz, false, nullptr);
+    m_spProgress->SetProgress(DWORD(m_finished), DWORD(m_paths.size()));
+}
+
+void BulkDeleter::Finish()
+{
+    for (auto& thread : m_threads)
+        thread.join();
+    m_threads.clear();
+
+    if (m_spProgress)
+    {
+        m_spProgress->StopProgressDialog();
+        m_spProgress.Release();
+    }
+}
+
+void BulkDeleter::PostProgress()
+{
+    // At most one progress message per interval, from whichever thread
+    // gets there first.
+    const LONG now = LONG(GetTickCount());
+    const LONG posted = m_posted;
+    if (DWORD(now - posted) >= c_delete_progress_interval && InterlockedCompareExchange(&m_posted, now, posted) == posted)
+        PostMessage(m_hwnd, m_msg, BDM_PROGRESS, 0);
+}
+
+void BulkDeleter::WorkerProc(BulkDeleter* pThis)
+{
+    while (true)
+    {
+        const LONG index = InterlockedIncrement(&pThis->m_next) - 1;
+        if (index >= LONG(pThis->m_paths.size()))
+            break;
+
+        if (!pThis->IsCancelled())
+            pThis->DeleteTree(pThis->m_paths[index]);
+
+        if (InterlockedIncrement(&pThis->m_finished) == LONG(pThis->m_paths.size()))
+            PostMessage(pThis->m_hwnd, pThis->m_msg, BDM_DONE, 0);
+        else
+            pThis->PostProgress();
+    }
+}
+
+bool BulkDeleter::DeleteEntry(const std::wstring& path, DWORD attr)
+{
+    if (attr & FILE_ATTRIBUTE_READONLY)
+        SetFileAttributes(path.c_str(), attr & ~FILE_ATTRIBUTE_READONLY);
+
+    const bool ok = (attr & FILE_ATTRIBUTE_DIRECTORY) ? RemoveDirectory(path.c_str()) : DeleteFile(path.c_str());
+    if (ok)
+    {
+        InterlockedIncrement64(&m_entries);
+        PostProgress();
+    }
+    return ok;
+}
+
+void BulkDeleter::DeleteTree(const std::wstring& root)
+{
+    std::wstring path(root);
+    strip_separator(path);
+
+    const DWORD root_attr = GetFileAttributes(path.c_str());
+    if (root_attr == INVALID_FILE_ATTRIBUTES)
+        return;
+    if (!(root_attr & FILE_ATTRIBUTE_DIRECTORY) || (root_attr & FILE_ATTRIBUTE_REPARSE_POINT))
+    {
+        DeleteEntry(path, root_attr);
+        return;
+    }
+
+    // Each directory is visited twice:  first to delete its files and queue
+    // its subdirectories, and then to remove it once they're gone.
+    struct Pending
+    {
+        std::wstring        path;
+        DWORD               attr;
+        bool                emptied;
+    };
+
+    std::vector<Pending> stack;
+    stack.push_back({ path, root_attr, false });
+
+    std::wstring find;
+    std::wstring child;
+    while (!stack.empty() && !IsCancelled())
+    {
+        if (stack.back().emptied)
+        {
+            DeleteEntry(stack.back().path, stack.back().attr);
+            stack.pop_back();
+            continue;
+        }
+
+        stack.back().emptied = true;
+        const std::wstring dir = stack.back().path;
+
+        find = dir;
+        ensure_separator(find);
+        const size_t base_len = find.length();
+        find.append(TEXT("*"));
+
+        WIN32_FIND_DATA fd;
+        SFindHandle shFind = FindFirstFileEx(find.c_str(), FindExInfoBasic, &fd, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+        if (shFind.IsEmpty())
+            continue;
+
+        do
+        {
+            if (fd.cFileName[0] == '.' && (!fd.cFileName[1] || (fd.cFileName[1] == '.' && !fd.cFileName[2])))
+                continue;
+
+            child.assign(find.c_str(), base_len);
+            child.append(fd.cFileName);
+
+            if ((fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && !(fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT))
+                stack.push_back({ child, fd.dwFileAttributes, false });
+            else
+                DeleteEntry(child, fd.dwFileAttributes);
+        }
+        while (!IsCancelled() && FindNextFile(shFind, &fd));
+    }
+}
+
+std::unique_ptr<BulkDeleter> ShellDeleteMany(HWND hwnd, const std::vector<std::wstring>& paths, UINT msg)
+{
+    if (paths.empty() || !ConfirmBulkDelete(hwnd, paths, true/*permanent*/))
+        return nullptr;
+
+    // Some items may have been deleted even if it is cancelled, so the
+    // caller checks which ones are gone once it's done.
+    std::unique_ptr<BulkDeleter> deleter = std::make_unique<BulkDeleter>(paths);
+    deleter->Start(hwnd, msg);
+    return deleter;
+}
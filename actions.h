@@ -4,14 +4,59 @@
 #pragma once
 
 #include <shlobj_core.h>
+#include <memory>
+#include <thread>
+#include <vector>
 
 class SH_SHFree { protected: void Free(LPITEMIDLIST pidl) { SHFree(pidl); } };
 typedef SH<LPITEMIDLIST, NULL, SH_SHFree> SPIDL;
 
+class BulkDeleter;
+
 void ShellOpen(HWND hwnd, const WCHAR* path);
 void ShellOpenRecycleBin(HWND hwnd);
 bool ShellRecycle(HWND hwnd, const WCHAR* path);
 bool ShellDelete(HWND hwnd, const WCHAR* path);
+bool ShellRecycleMany(HWND hwnd, const std::vector<std::wstring>& paths);
+std::unique_ptr<BulkDeleter> ShellDeleteMany(HWND hwnd, const std::vector<std::wstring>& paths, UINT msg);
 bool ShellEmptyRecycleBin(HWND hwnd, const WCHAR* path);
 bool ShellBrowseForFolder(HWND hwnd, const WCHAR* title, std::wstring& inout);
+bool ShellChooseSaveFile(HWND hwnd, const WCHAR* title, const WCHAR* filter_name, const WCHAR* extension, std::wstring& inout);
+
+// BulkDeleter permanently deletes a list of files and directory trees on
+// worker threads.  It posts msg to the window with WPARAM BDM_PROGRESS as it
+// goes, and BDM_DONE once every item has been deleted, has failed, or was
+// cancelled.  The window passes BDM_PROGRESS to UpdateProgress(), and calls
+// Finish() on BDM_DONE.
+
+enum { BDM_PROGRESS, BDM_DONE };
+
+class BulkDeleter
+{
+public:
+                            BulkDeleter(const std::vector<std::wstring>& paths) : m_paths(paths) {}
+                            ~BulkDeleter();
+
+    void                    Start(HWND hwnd, UINT msg);
+    void                    UpdateProgress();
+    void                    Finish();
+
+protected:
+    void                    DeleteTree(const std::wstring& path);
+    bool                    DeleteEntry(const std::wstring& path, DWORD attr);
+    bool                    IsCancelled() const { return !!m_cancel; }
+    void                    PostProgress();
+    static void             WorkerProc(BulkDeleter* pThis);
 
+private:
+    const std::vector<std::wstring> m_paths;
+    HWND                    m_hwnd = 0;
+    UINT                    m_msg = 0;
+    SPI<IProgressDialog>    m_spProgress;
+    std::vector<std::thread> m_threads;
+    volatile LONG           m_next = 0;
+    volatile LONG           m_finished = 0;
+    volatile LONGLONG       m_entries = 0;
+    volatile LONG           m_cancel = 0;
+    volatile LONG           m_posted = 0;   // Tick count of the last progress message.
+};
@@ -0,0 +1,121 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "arctext.h"
+#include <cmath>
+#include <functional>
+
+static const size_t c_max_arc_text_fits = 8192;
+static const uint32_t c_min_arc_text_length = 1;
+static const wchar_t c_arc_ellipsis[] = L"...";
+static const size_t c_arc_ellipsis_len = sizeof(c_arc_ellipsis) / sizeof(c_arc_ellipsis[0]) - 1;
+
+static inline bool is_high_surrogate(const wchar_t ch)
+{
+    return ch >= 0xd800 && ch <= 0xdbff;
+}
+
+static void make_truncated(std::wstring& out, const std::wstring& text, const size_t keep)
+{
+    out.assign(text.c_str(), keep);
+    out.append(c_arc_ellipsis, c_arc_ellipsis_len);
+    out.append(L" ");
+}
+
+void FitArcText(ArcTextMeasurer& measurer, const wchar_t* name, const float span, const float radius, ArcTextFit& out)
+{
+    out.m_fits = false;
+    out.m_shape.reset();
+
+    std::wstring text;
+    text.append(L" ");
+    text.append(name);
+    text.append(L" ");
+
+    const uint32_t length = uint32_t(text.length());
+    const int result = measurer.TestFit(text.c_str(), length, span, radius, &out.m_shape);
+    if (result >= 0)
+    {
+        out.m_fits = (result > 0);
+        out.m_text = std::move(text);
+        return;
+    }
+
+    // Binary search for the longest truncation that fits.
+
+    std::wstring truncated;
+    uint32_t lo = c_min_arc_text_length;
+    uint32_t hi = (length > 4) ? length - 2 - 2 : 0; // -2 for the padding spaces, -2 to ensure truncation doesn't just replace a character with an ellipsis.
+    uint32_t fits = 0;
+    while (lo <= hi)
+    {
+        const uint32_t mid = (lo + hi) / 2;
+        make_truncated(truncated, text, mid + 1); // +1 for leading space.
+        const int probe = measurer.TestFit(truncated.c_str(), uint32_t(truncated.length()), span, radius, nullptr);
+        if (probe == 0)
+            return;
+        else if (probe < 0)
+            hi = mid - 1;
+        else
+        {
+            lo = mid + 1;
+            if (fits < mid)
+                fits = mid;
+        }
+    }
+
+    if (fits >= c_min_arc_text_length && fits < text.length())
+    {
+        ++fits; // Including the leading space.
+        fits -= is_high_surrogate(text[fits - 1]);
+        if (fits <= 1) // Must end up with more than just the leading space.
+            return;
+        make_truncated(truncated, text, fits);
+        out.m_fits = (measurer.TestFit(truncated.c_str(), uint32_t(truncated.length()), span, radius, &out.m_shape) > 0);
+        out.m_text = std::move(truncated);
+    }
+}
+
+bool ArcTextFitCache::Key::operator==(const Key& other) const
+{
+    return (m_font_size == other.m_font_size &&
+            m_span == other.m_span &&
+            m_radius == other.m_radius &&
+            m_name == other.m_name);
+}
+
+size_t ArcTextFitCache::KeyHash::operator()(const Key& key) const
+{
+    size_t hash = std::hash<std::wstring>()(key.m_name);
+    hash ^= std::hash<float>()(key.m_font_size) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<float>()(key.m_span) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    hash ^= std::hash<int32_t>()(key.m_radius) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    return hash;
+}
+
+const ArcTextFit& ArcTextFitCache::Fit(ArcTextMeasurer& measurer, const wchar_t* name, const float font_size, const float span, const float radius)
+{
+    Key key;
+    key.m_name = name;
+    key.m_font_size = font_size;
+    key.m_span = span;
+    key.m_radius = int32_t(std::lround(radius));
+
+    const auto it = m_fits.find(key);
+    if (it != m_fits.end())
+    {
+        ++m_hits;
+        return it->second;
+    }
+
+    ++m_misses;
+
+    // The cache only needs to hold the labels of the current layout, so when
+    // it grows past that, starting over is simpler than tracking recency.
+    if (m_fits.size() >= c_max_arc_text_fits)
+        m_fits.clear();
+
+    ArcTextFit& fit = m_fits[std::move(key)];
+    FitArcText(measurer, name, span, radius, fit);
+    return fit;
+}
@@ -0,0 +1,73 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+// Fitting names into arcs.
+//
+// A name that doesn't fit in its arc is truncated with an ellipsis, using a
+// binary search over the truncation length.  Each probe needs a text layout,
+// so the chosen text and its shaped layout are cached, keyed by the name,
+// font size, angular span, and radius.  The arcs don't change between paints
+// unless the layout changes, so most paints only look up cached fits.
+//
+// Measuring happens behind ArcTextMeasurer (see DWriteArcTextMeasurer).
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// Opaque shaped text (e.g. a DirectWrite text layout), ready to draw.
+class ArcTextShape
+{
+public:
+    virtual                 ~ArcTextShape() {}
+};
+
+class ArcTextMeasurer
+{
+public:
+    virtual                 ~ArcTextMeasurer() {}
+    // Returns 1 if the text fits in an arc with the given span (in degrees)
+    // and radius, -1 if it's too long, or 0 on failure.  When shape is not
+    // null and the text fits, it receives the shaped text.
+    virtual int             TestFit(const wchar_t* text, uint32_t length, float span, float radius, std::shared_ptr<ArcTextShape>* shape) = 0;
+};
+
+struct ArcTextFit
+{
+    bool                    m_fits = false; // Whether there's anything to draw.
+    std::wstring            m_text;         // Padded, and truncated if necessary.
+    std::shared_ptr<ArcTextShape> m_shape;
+};
+
+void FitArcText(ArcTextMeasurer& measurer, const wchar_t* name, float span, float radius, ArcTextFit& out);
+
+class ArcTextFitCache
+{
+    struct Key
+    {
+        std::wstring        m_name;
+        float               m_font_size;
+        float               m_span;
+        int32_t             m_radius;       // Rounded to whole pixels.
+        bool                operator==(const Key& other) const;
+    };
+
+    struct KeyHash
+    {
+        size_t              operator()(const Key& key) const;
+    };
+
+public:
+    const ArcTextFit&       Fit(ArcTextMeasurer& measurer, const wchar_t* name, float font_size, float span, float radius);
+    void                    Clear() { m_fits.clear(); }
+    size_t                  Hits() const { return m_hits; }
+    size_t                  Misses() const { return m_misses; }
+
+private:
+    std::unordered_map<Key, ArcTextFit, KeyHash> m_fits;
+    size_t                  m_hits = 0;
+    size_t                  m_misses = 0;
+};
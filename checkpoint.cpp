@@ -0,0 +1,774 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "main.h"
+#include "data.h"
+#include "checkpoint.h"
+#include <shlobj_core.h>
+
+constexpr DWORD c_checkpoint_magic = 0x4b434c45;    // "ELCK"
+constexpr DWORD c_checkpoint_version = 2;
+constexpr DWORD c_flush_interval = 2000;        // Milliseconds.
+constexpr size_t c_flush_threshold = 1024 * 1024;
+constexpr ULONGLONG c_abandoned_age = 7ull * 24 * 60 * 60 * 10000000;   // 7 days, in FILETIME units.
+
+enum CheckpointRecordType : BYTE
+{
+    CRT_LISTING             = 'L',
+    CRT_FINISHED            = 'F',
+};
+
+enum CheckpointEntryKind : BYTE
+{
+    CEK_FILE                = 1,
+    CEK_DIR                 = 2,
+};
+
+struct CheckpointHeader
+{
+    DWORD                   magic;
+    DWORD                   version;
+    DWORD                   options;
+};
+
+//----------------------------------------------------------------------------
+// Serialization helpers.
+
+static void put_bytes(std::vector<BYTE>& data, const void* p, size_t len)
+{
+    const BYTE* const b = static_cast<const BYTE*>(p);
+    data.insert(data.end(), b, b + len);
+}
+
+template <typename T> void put_value(std::vector<BYTE>& data, const T value)
+{
+    put_bytes(data, &value, sizeof(value));
+}
+
+static void put_string(std::vector<BYTE>& data, const WCHAR* s, size_t len)
+{
+    assert(len <= 0xffff);
+    put_value<WORD>(data, WORD(len));
+    put_bytes(data, s, len * sizeof(*s));
+}
+
+static bool read_at(HANDLE h, ULONGLONG offset, void* p, DWORD len)
+{
+    // A positioned read doesn't disturb anyone else using the handle.
+    OVERLAPPED ov = {};
+    ov.Offset = DWORD(offset);
+    ov.OffsetHigh = DWORD(offset >> 32);
+    DWORD bytes;
+    return ReadFile(h, p, len, &bytes, &ov) && bytes == len;
+}
+
+class CheckpointReader
+{
+public:
+                            CheckpointReader(const BYTE* p, const BYTE* end) : m_p(p), m_end(end) {}
+    bool                    AtEnd() const { return m_p >= m_end; }
+    const BYTE*             Position() const { return m_p; }
+    size_t                  Remaining() const { return size_t(m_end - m_p); }
+    void                    Skip(size_t len) { m_p += std::min<size_t>(len, Remaining()); }
+
+    template <typename T> bool Get(T& value)
+    {
+        if (Remaining() < sizeof(value))
+            return false;
+        memcpy(&value, m_p, sizeof(value));
+        m_p += sizeof(value);
+        return true;
+    }
+
+    bool                    GetString(std::wstring& out)
+    {
+        WORD len;
+        if (!Get(len) || Remaining() < len * sizeof(WCHAR))
+            return false;
+        out.assign(reinterpret_cast<const WCHAR*>(m_p), len);
+        m_p += len * sizeof(WCHAR);
+        return true;
+    }
+
+    bool                    GetEntry(CheckpointEntry& entry)
+    {
+        BYTE kind;
+        if (!Get(kind) || !Get(entry.m_flags) || !GetString(entry.m_name))
+            return false;
+        entry.m_dir = (kind == CEK_DIR);
+        entry.m_size = 0;
+        return entry.m_dir || Get(entry.m_size);
+    }
+
+    bool                    GetListingHeader(std::wstring& relative, CheckpointListing& listing)
+    {
+        BYTE type;
+        return (Get(type) && type == CRT_LISTING &&
+                GetString(relative) &&
+                Get(listing.m_token) &&
+                Get(listing.m_flags));
+    }
+
+private:
+    const BYTE*             m_p;
+    const BYTE* const       m_end;
+};
+
+static void add_totals(CheckpointTotals& to, const CheckpointTotals& from)
+{
+    to.m_size += from.m_size;
+    to.m_count_dirs += from.m_count_dirs;
+    to.m_count_files += from.m_count_files;
+    to.m_self_contained = to.m_self_contained && from.m_self_contained;
+}
+
+//----------------------------------------------------------------------------
+// CheckpointSnapshot.
+//
+// Each listing is [DWORD len][entries], and each entry is [BYTE kind][BYTE
+// flags][name].  A file entry is followed by its size.  A directory entry is
+// followed by the offset of its listing, and the totals of its subtree.
+
+static void put_snapshot_file(std::vector<BYTE>& data, const CheckpointEntry& entry)
+{
+    put_value<BYTE>(data, CEK_FILE);
+    put_value<BYTE>(data, entry.m_flags);
+    put_string(data, entry.m_name.c_str(), entry.m_name.length());
+    put_value<ULONGLONG>(data, entry.m_size);
+}
+
+static void put_snapshot_dir(std::vector<BYTE>& data, const CheckpointEntry& entry, const CheckpointListing& listing)
+{
+    assert(listing.m_snapshot);
+    put_value<BYTE>(data, CEK_DIR);
+    put_value<BYTE>(data, entry.m_flags);
+    put_string(data, entry.m_name.c_str(), entry.m_name.length());
+    put_value<ULONGLONG>(data, listing.m_snapshot);
+    put_value<ULONGLONG>(data, listing.m_subtree.m_size);
+    put_value<ULONGLONG>(data, listing.m_subtree.m_count_dirs);
+    put_value<ULONGLONG>(data, listing.m_subtree.m_count_files);
+}
+
+bool CheckpointSnapshot::ReadListing(ULONGLONG offset, std::vector<CheckpointEntry>& out) const
+{
+    DWORD len;
+    if (!read_at(m_hFile, offset, &len, sizeof(len)))
+        return false;
+
+    std::vector<BYTE> data(len);
+    if (!read_at(m_hFile, offset + sizeof(len), data.data(), len))
+        return false;
+
+    out.clear();
+    CheckpointReader record(data.data(), data.data() + data.size());
+    while (!record.AtEnd())
+    {
+        CheckpointEntry entry;
+        BYTE kind;
+        if (!record.Get(kind) || !record.Get(entry.m_flags) || !record.GetString(entry.m_name))
+            return false;
+
+        entry.m_dir = (kind == CEK_DIR);
+        if (!entry.m_dir)
+        {
+            if (!record.Get(entry.m_size))
+                return false;
+        }
+        else
+        {
+            if (!record.Get(entry.m_snapshot) ||
+                !record.Get(entry.m_subtree.m_size) ||
+                !record.Get(entry.m_subtree.m_count_dirs) ||
+                !record.Get(entry.m_subtree.m_count_files))
+                return false;
+        }
+        out.emplace_back(std::move(entry));
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// Checkpoint files.
+
+static bool get_checkpoint_dir(std::wstring& out)
+{
+    WCHAR* pszPath = nullptr;
+    const HRESULT hr = SHGetKnownFolderPath(FOLDERID_LocalAppData, KF_FLAG_DEFAULT, nullptr, &pszPath);
+    if (SUCCEEDED(hr))
+        out = pszPath;
+    if (pszPath)
+        CoTaskMemFree(pszPath);
+    if (FAILED(hr) || out.empty())
+        return false;
+
+    ensure_separator(out);
+    out.append(TEXT("Elucidisk"));
+    CreateDirectory(out.c_str(), nullptr);
+    out.append(TEXT("\\Checkpoints"));
+    CreateDirectory(out.c_str(), nullptr);
+    return true;
+}
+
+static bool get_checkpoint_filename(const WCHAR* root, std::wstring& out)
+{
+    if (!get_checkpoint_dir(out))
+        return false;
+
+    // FNV-1a hash of the case-folded root path names the checkpoint file.
+    ULONGLONG hash = 0xcbf29ce484222325;
+    for (const WCHAR* p = root; *p; ++p)
+    {
+        const WCHAR ch = is_separator(*p) ? '\\' : towlower(*p);
+        hash ^= ch;
+        hash *= 0x100000001b3;
+    }
+
+    WCHAR sz[40];
+    swprintf_s(sz, _countof(sz), TEXT("\\%016llx.ckpt"), hash);
+    out.append(sz);
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// CheckpointRecord.
+
+void CheckpointRecord::Begin(const std::wstring& relative, ULONGLONG token, BYTE flags)
+{
+    m_data.clear();
+    put_value<DWORD>(m_data, 0);    // Length; filled in by AppendListing.
+    put_value<BYTE>(m_data, CRT_LISTING);
+    put_string(m_data, relative.c_str(), relative.length());
+    put_value<ULONGLONG>(m_data, token);
+    put_value<BYTE>(m_data, flags);
+}
+
+void CheckpointRecord::AddFile(const WCHAR* name, ULONGLONG size, BYTE flags)
+{
+    assert(!m_data.empty());
+    put_value<BYTE>(m_data, CEK_FILE);
+    put_value<BYTE>(m_data, flags);
+    put_string(m_data, name, wcslen(name));
+    put_value<ULONGLONG>(m_data, size);
+}
+
+void CheckpointRecord::AddDir(const WCHAR* name, BYTE flags)
+{
+    assert(!m_data.empty());
+    put_value<BYTE>(m_data, CEK_DIR);
+    put_value<BYTE>(m_data, flags);
+    put_string(m_data, name, wcslen(name));
+}
+
+//----------------------------------------------------------------------------
+// ScanCheckpoint.
+
+ScanCheckpoint::ScanCheckpoint(const WCHAR* root)
+: m_root(root)
+{
+}
+
+ScanCheckpoint::~ScanCheckpoint()
+{
+    StopWriter();
+}
+
+// A checkpoint is only discarded when its scan completes, so the checkpoint
+// of a root that never gets scanned again would stay forever.  Once per run,
+// delete the ones that haven't been written to in a while.  Checkpoints in
+// use can't be deleted, since they're open without delete sharing.
+static void delete_abandoned_checkpoints()
+{
+    std::wstring dir;
+    if (!get_checkpoint_dir(dir))
+        return;
+
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+    ULARGE_INTEGER now;
+    now.LowPart = ft.dwLowDateTime;
+    now.HighPart = ft.dwHighDateTime;
+
+    std::wstring file(dir);
+    file.append(TEXT("\\*.ckpt"));
+
+    WIN32_FIND_DATA fd;
+    SFindHandle shFind = FindFirstFile(file.c_str(), &fd);
+    if (shFind.IsEmpty())
+        return;
+
+    do
+    {
+        if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            continue;
+
+        ULARGE_INTEGER written;
+        written.LowPart = fd.ftLastWriteTime.dwLowDateTime;
+        written.HighPart = fd.ftLastWriteTime.dwHighDateTime;
+        if (written.QuadPart + c_abandoned_age > now.QuadPart)
+            continue;
+
+        file = dir;
+        file.append(TEXT("\\"));
+        file.append(fd.cFileName);
+        DeleteFile(file.c_str());
+    }
+    while (FindNextFile(shFind, &fd));
+}
+
+std::shared_ptr<ScanCheckpoint> ScanCheckpoint::Open(const WCHAR* root, DWORD options)
+{
+    static std::once_flag s_once;
+    std::call_once(s_once, delete_abandoned_checkpoints);
+
+    std::shared_ptr<ScanCheckpoint> checkpoint(new ScanCheckpoint(root));
+    if (!checkpoint->Load(options))
+        return nullptr;
+
+    checkpoint->m_hWake = CreateEvent(nullptr, false, false, nullptr);
+    if (!checkpoint->m_hWake)
+        return nullptr;
+
+    checkpoint->m_writer = std::make_unique<std::thread>(WriterProc, checkpoint.get());
+    return checkpoint;
+}
+
+bool ScanCheckpoint::Load(DWORD options)
+{
+    if (!get_checkpoint_filename(m_root.c_str(), m_file))
+        return false;
+
+    m_hFile = CreateFile(m_file.c_str(), GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_hFile.IsEmpty())
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_hFile, &size))
+        return false;
+
+    // Replay the log.  A crash can leave a torn record at the end; replay
+    // stops at the first incomplete record and the file is truncated there.
+
+    LONGLONG valid = 0;
+    if (size.QuadPart >= LONGLONG(sizeof(CheckpointHeader)))
+    {
+        SHandle hMap = CreateFileMapping(m_hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        const BYTE* const view = hMap ? static_cast<const BYTE*>(MapViewOfFile(hMap, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+        if (view)
+        {
+            CheckpointReader file(view, view + size.QuadPart);
+
+            CheckpointHeader header;
+            if (file.Get(header) &&
+                header.magic == c_checkpoint_magic &&
+                header.version == c_checkpoint_version &&
+                header.options == options)
+            {
+                valid = file.Position() - view;
+
+                DWORD len;
+                CheckpointEntry entry;
+                while (file.Get(len) && len <= file.Remaining())
+                {
+                    CheckpointReader record(file.Position(), file.Position() + len);
+                    BYTE type;
+                    std::wstring relative;
+                    if (!record.Get(type) || !record.GetString(relative))
+                        break;
+
+                    if (type == CRT_LISTING)
+                    {
+                        // Only the index is kept; the entries are checked
+                        // here, and read again when they're needed.
+                        CheckpointListing listing;
+                        listing.m_offset = file.Position() - view;
+                        listing.m_length = len;
+                        if (!record.Get(listing.m_token) || !record.Get(listing.m_flags))
+                            break;
+
+                        bool ok = true;
+                        while (ok && !record.AtEnd())
+                            ok = record.GetEntry(entry);
+                        if (!ok)
+                            break;
+
+                        // A new listing supersedes any earlier one, including
+                        // whether its subtree was finished.
+                        m_listings[relative] = std::move(listing);
+                    }
+                    else if (type == CRT_FINISHED)
+                    {
+                        const auto iter = m_listings.find(relative);
+                        if (iter != m_listings.end())
+                            iter->second.m_finished = true;
+                    }
+
+                    file.Skip(len);
+                    valid = file.Position() - view;
+                }
+
+                SumSubtrees(view);
+                WriteSnapshot(view);
+            }
+
+            UnmapViewOfFile(view);
+        }
+    }
+
+    LARGE_INTEGER pos;
+    pos.QuadPart = valid;
+    if (!SetFilePointerEx(m_hFile, pos, nullptr, FILE_BEGIN) || !SetEndOfFile(m_hFile))
+        return false;
+
+    if (!valid)
+    {
+        m_listings.clear();
+
+        const CheckpointHeader header = { c_checkpoint_magic, c_checkpoint_version, options };
+        DWORD written;
+        if (!WriteFile(m_hFile, &header, sizeof(header), &written, nullptr) || written != sizeof(header))
+            return false;
+    }
+
+    // Stubs read from the snapshot instead, so this handle is only used
+    // during the scan, and Discard() closes it before deleting the file.
+    m_hRead = CreateFile(m_file.c_str(), GENERIC_READ, FILE_SHARE_READ|FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_hRead.IsEmpty())
+    {
+        m_listings.clear();
+        m_snapshot.reset();
+    }
+
+    return true;
+}
+
+void ScanCheckpoint::SumSubtrees(const BYTE* view)
+{
+    // Each listing's subtree totals come from walking its entries down
+    // through the listings of its subdirectories.  Walking down (rather than
+    // adding each listing into its ancestors) ignores stale listings of
+    // directories that have since been deleted.  An explicit stack keeps a
+    // deep tree from overflowing the thread's stack.
+    struct Frame
+    {
+        CheckpointListing*  listing;
+        std::wstring        relative;
+        CheckpointReader    record;
+    };
+
+    auto make_frame = [view](const std::wstring& relative, CheckpointListing& listing)
+    {
+        Frame frame = { &listing, relative, CheckpointReader(view + listing.m_offset, view + listing.m_offset + listing.m_length) };
+        std::wstring ignore;
+        CheckpointListing header;
+        frame.record.GetListingHeader(ignore, header);
+        listing.m_summed = true;
+        return frame;
+    };
+
+    std::vector<Frame> stack;
+    CheckpointEntry entry;
+    std::wstring key;
+    for (auto& it : m_listings)
+    {
+        if (it.second.m_summed)
+            continue;
+
+        stack.emplace_back(make_frame(it.first, it.second));
+        while (!stack.empty())
+        {
+            Frame& frame = stack.back();
+            if (frame.record.AtEnd() || !frame.record.GetEntry(entry))
+            {
+                const CheckpointListing* const done = frame.listing;
+                stack.pop_back();
+                if (!stack.empty())
+                    add_totals(stack.back().listing->m_subtree, done->m_subtree);
+                continue;
+            }
+
+            CheckpointTotals& totals = frame.listing->m_subtree;
+            if (!entry.m_dir)
+            {
+                totals.m_size += entry.m_size;
+                totals.m_count_files++;
+                continue;
+            }
+
+            totals.m_count_dirs++;
+            if (entry.m_flags & CPF_MOUNT_POINT)
+                totals.m_self_contained = false;
+
+            key = frame.relative;
+            key.append(entry.m_name);
+            ensure_separator(key);
+
+            const auto child = m_listings.find(key);
+            if (child == m_listings.end() || !child->second.m_finished)
+                totals.m_self_contained = false;
+            else if (child->second.m_summed)
+                add_totals(totals, child->second.m_subtree);
+            else
+                stack.emplace_back(make_frame(key, child->second));
+        }
+    }
+}
+
+bool ScanCheckpoint::WriteSnapshot(const BYTE* view)
+{
+    // Listings are written in post order, so that each directory entry can
+    // refer to its subdirectory's listing.  Every subdirectory of a self
+    // contained listing has a finished listing, which is self contained too.
+    std::wstring file;
+    WCHAR sz[MAX_PATH];
+    if (!get_checkpoint_dir(file) || !GetTempFileName(file.c_str(), TEXT("ckp"), 0, sz))
+        return false;
+
+    std::shared_ptr<CheckpointSnapshot> snapshot = std::make_shared<CheckpointSnapshot>();
+    snapshot->m_hFile = CreateFile(sz, GENERIC_READ|GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY|FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+    if (snapshot->m_hFile.IsEmpty())
+    {
+        DeleteFile(sz);
+        return false;
+    }
+
+    struct Frame
+    {
+        CheckpointListing*  listing;
+        std::wstring        relative;
+        CheckpointReader    record;
+        std::vector<BYTE>   out;
+        CheckpointEntry     waiting;    // Subdirectory whose listing is being written.
+    };
+
+    auto make_frame = [view](const std::wstring& relative, CheckpointListing& listing)
+    {
+        Frame frame = { &listing, relative, CheckpointReader(view + listing.m_offset, view + listing.m_offset + listing.m_length) };
+        std::wstring ignore;
+        CheckpointListing header;
+        frame.record.GetListingHeader(ignore, header);
+        put_value<DWORD>(frame.out, 0);
+        return frame;
+    };
+
+    // The magic number keeps offset 0 free to mean none.
+    std::vector<BYTE> data;
+    ULONGLONG flushed = 0;
+    put_value<DWORD>(data, c_checkpoint_magic);
+
+    auto flush = [&data, &flushed, &snapshot]()
+    {
+        DWORD written;
+        if (!WriteFile(snapshot->m_hFile, data.data(), DWORD(data.size()), &written, nullptr) || written != data.size())
+            return false;
+        flushed += data.size();
+        data.clear();
+        return true;
+    };
+
+    std::vector<Frame> stack;
+    CheckpointEntry entry;
+    std::wstring key;
+    for (auto& it : m_listings)
+    {
+        if (!it.second.m_finished || !it.second.m_subtree.m_self_contained || it.second.m_snapshot)
+            continue;
+
+        stack.emplace_back(make_frame(it.first, it.second));
+        while (!stack.empty())
+        {
+            Frame& frame = stack.back();
+            if (frame.record.AtEnd() || !frame.record.GetEntry(entry))
+            {
+                const DWORD len = DWORD(frame.out.size() - sizeof(DWORD));
+                memcpy(frame.out.data(), &len, sizeof(len));
+                frame.listing->m_snapshot = flushed + data.size();
+                data.insert(data.end(), frame.out.begin(), frame.out.end());
+                if (data.size() >= c_flush_threshold && !flush())
+                    return false;
+
+                const CheckpointListing* const done = frame.listing;
+                stack.pop_back();
+                if (!stack.empty())
+                    put_snapshot_dir(stack.back().out, stack.back().waiting, *done);
+                continue;
+            }
+
+            if (!entry.m_dir)
+            {
+                put_snapshot_file(frame.out, entry);
+                continue;
+            }
+
+            key = frame.relative;
+            key.append(entry.m_name);
+            ensure_separator(key);
+
+            const auto child = m_listings.find(key);
+            if (child == m_listings.end() || !child->second.m_finished)
+                return false;
+            if (child->second.m_snapshot)
+            {
+                put_snapshot_dir(frame.out, entry, child->second);
+            }
+            else
+            {
+                frame.waiting = entry;
+                stack.emplace_back(make_frame(key, child->second));
+            }
+        }
+    }
+
+    if (!data.empty() && !flush())
+        return false;
+
+    m_snapshot = std::move(snapshot);
+    return true;
+}
+
+bool ScanCheckpoint::GetRelativePath(const std::wstring& path, std::wstring& out) const
+{
+    if (path.length() < m_root.length() || wcsnicmp(path.c_str(), m_root.c_str(), m_root.length()))
+        return false;
+
+    out.assign(path.c_str() + m_root.length(), path.length() - m_root.length());
+    return true;
+}
+
+bool ScanCheckpoint::ReadFinished(const std::wstring& relative, CheckpointListing& out)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_listings_mutex);
+
+        const auto iter = m_listings.find(relative);
+        if (iter == m_listings.end() || !iter->second.m_finished)
+            return false;
+
+        out = iter->second;
+    }
+
+    // The writer has its own handle.
+    std::vector<BYTE> data(out.m_length);
+    if (!read_at(m_hRead, ULONGLONG(out.m_offset), data.data(), out.m_length))
+        return false;
+
+    CheckpointReader record(data.data(), data.data() + data.size());
+    std::wstring check;
+    CheckpointListing header;
+    if (!record.GetListingHeader(check, header) || check != relative)
+        return false;
+
+    out.m_entries.clear();
+    CheckpointEntry entry;
+    while (!record.AtEnd())
+    {
+        if (!record.GetEntry(entry))
+            return false;
+        out.m_entries.emplace_back(std::move(entry));
+    }
+    return true;
+}
+
+bool ScanCheckpoint::GetStub(const std::wstring& relative, ULONGLONG& snapshot, CheckpointTotals& totals)
+{
+    std::lock_guard<std::mutex> lock(m_listings_mutex);
+
+    const auto iter = m_listings.find(relative);
+    if (!m_snapshot || iter == m_listings.end() || !iter->second.m_snapshot)
+        return false;
+
+    snapshot = iter->second.m_snapshot;
+    totals = iter->second.m_subtree;
+    return true;
+}
+
+void ScanCheckpoint::AppendListing(CheckpointRecord& record)
+{
+    assert(record.m_data.size() > sizeof(DWORD));
+    const DWORD len = DWORD(record.m_data.size() - sizeof(DWORD));
+    memcpy(record.m_data.data(), &len, sizeof(len));
+    Append(record.m_data.data(), record.m_data.size());
+}
+
+void ScanCheckpoint::AppendFinished(const std::wstring& relative)
+{
+    std::vector<BYTE> data;
+    put_value<DWORD>(data, 0);
+    put_value<BYTE>(data, CRT_FINISHED);
+    put_string(data, relative.c_str(), relative.length());
+
+    const DWORD len = DWORD(data.size() - sizeof(DWORD));
+    memcpy(data.data(), &len, sizeof(len));
+    Append(data.data(), data.size());
+}
+
+void ScanCheckpoint::Append(const BYTE* data, size_t len)
+{
+    bool wake;
+
+    {
+        std::lock_guard<std::mutex> lock(m_pending_mutex);
+        m_pending.insert(m_pending.end(), data, data + len);
+        wake = (m_pending.size() >= c_flush_threshold);
+    }
+
+    if (wake)
+        SetEvent(m_hWake);
+}
+
+void ScanCheckpoint::Discard()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_pending_mutex);
+        m_pending.clear();
+    }
+
+    StopWriter();
+    m_hRead.Close();
+    m_hFile.Close();
+
+    if (!m_file.empty())
+        DeleteFile(m_file.c_str());
+
+    // Stubs only need the snapshot.
+    std::lock_guard<std::mutex> lock(m_listings_mutex);
+    m_listings.clear();
+}
+
+void ScanCheckpoint::StopWriter()
+{
+    if (m_writer)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_pending_mutex);
+            m_stop = true;
+        }
+
+        SetEvent(m_hWake);
+        m_writer->join();
+        m_writer.reset();
+    }
+}
+
+void ScanCheckpoint::WriterProc(ScanCheckpoint* pThis)
+{
+    std::vector<BYTE> data;
+    bool stop = false;
+
+    while (!stop)
+    {
+        WaitForSingleObject(pThis->m_hWake, c_flush_interval);
+
+        {
+            std::lock_guard<std::mutex> lock(pThis->m_pending_mutex);
+            data.swap(pThis->m_pending);
+            stop = pThis->m_stop;
+        }
+
+        if (!data.empty())
+        {
+            DWORD written;
+            WriteFile(pThis->m_hFile, data.data(), DWORD(data.size()), &written, nullptr);
+            data.clear();
+        }
+    }
+}
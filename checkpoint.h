@@ -0,0 +1,148 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+// ScanCheckpoint persists scan progress in an append-only log on local disk,
+// so that an interrupted scan of the same root can resume where it left off.
+//
+// The scanner appends a listing record for each directory it enumerates, and
+// a finished record once the directory's whole subtree has been scanned.  A
+// later scan of the same root replays the log, and restores each finished
+// subtree whose change tokens still match.  The change token is the
+// directory's last write time, read from the directory itself when it's
+// opened.  It doesn't propagate to ancestors, so every directory in a
+// subtree is checked before the subtree is restored, and the ones that
+// changed are scanned again.  Unfinished directories are the pending
+// frontier, and get enumerated again.
+//
+// NOTE:  The last write time of a directory changes when entries are added,
+// removed, or renamed, but not when an existing file grows in place.  So a
+// restored subtree can be stale in that respect; Rescan is always fresh.
+//
+// Checkpoints that haven't been written to for a week are deleted, so that
+// roots which are never scanned again don't leave files behind.
+//
+// Only an index of the listings is kept in memory:  where each record is in
+// the file, and the totals of its subtree.  The entries are read from the
+// file when a listing is restored.
+//
+// Restored subtrees stay stubs until they're browsed, and stubs can outlive
+// the scan and the checkpoint.  So Load() also copies the finished, self
+// contained listings into a CheckpointSnapshot:  a temporary file that is
+// deleted when it's closed.  Each directory entry in the snapshot has the
+// offset and totals of the subdirectory's listing, so paging in a stub needs
+// neither the index nor the checkpoint file.
+
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+enum CheckpointFlags
+{
+    CPF_NONE                = 0x00,
+    CPF_COMPRESSED          = 0x01,
+    CPF_SPARSE              = 0x02,
+    CPF_MOUNT_POINT         = 0x10,
+
+    // Scan options; only used in the header.
+    CPF_SIZE_ON_DISK        = 0x04,
+    CPF_LINKS_ONCE          = 0x08,
+    CPF_CROSS_MOUNTS        = 0x20,
+};
+
+struct CheckpointTotals
+{
+    ULONGLONG               m_size = 0;
+    ULONGLONG               m_count_dirs = 0;
+    ULONGLONG               m_count_files = 0;
+    bool                    m_self_contained = true;    // No mount points, and no listings missing.
+};
+
+struct CheckpointEntry
+{
+    std::wstring            m_name;
+    ULONGLONG               m_size = 0;
+    BYTE                    m_flags = 0;
+    bool                    m_dir = false;
+    ULONGLONG               m_snapshot = 0;     // Subdirectory's listing; only from a snapshot.
+    CheckpointTotals        m_subtree;          // Only from a snapshot.
+};
+
+struct CheckpointListing
+{
+    ULONGLONG               m_token = 0;
+    BYTE                    m_flags = 0;
+    bool                    m_finished = false;
+    LONGLONG                m_offset = 0;   // Of the record in the file.
+    DWORD                   m_length = 0;
+    CheckpointTotals        m_subtree;
+    bool                    m_summed = false;
+    ULONGLONG               m_snapshot = 0; // Of the listing in the snapshot; 0 is none.
+    std::vector<CheckpointEntry> m_entries; // Only filled in by ReadFinished.
+};
+
+class CheckpointRecord
+{
+    friend class ScanCheckpoint;
+public:
+    void                    Begin(const std::wstring& relative, ULONGLONG token, BYTE flags);
+    void                    AddFile(const WCHAR* name, ULONGLONG size, BYTE flags);
+    void                    AddDir(const WCHAR* name, BYTE flags);
+    bool                    IsEmpty() const { return m_data.empty(); }
+private:
+    std::vector<BYTE>       m_data;
+};
+
+class CheckpointSnapshot
+{
+    friend class ScanCheckpoint;
+public:
+    bool                    ReadListing(ULONGLONG offset, std::vector<CheckpointEntry>& out) const;
+private:
+    SFileHandle             m_hFile;
+};
+
+class ScanCheckpoint
+{
+public:
+                            ~ScanCheckpoint();
+
+    static std::shared_ptr<ScanCheckpoint> Open(const WCHAR* root, DWORD options);
+
+    bool                    GetRelativePath(const std::wstring& path, std::wstring& out) const;
+    bool                    ReadFinished(const std::wstring& relative, CheckpointListing& out);
+    bool                    GetStub(const std::wstring& relative, ULONGLONG& snapshot, CheckpointTotals& totals);
+    const std::shared_ptr<CheckpointSnapshot>& GetSnapshot() const { return m_snapshot; }
+    void                    AppendListing(CheckpointRecord& record);
+    void                    AppendFinished(const std::wstring& relative);
+    void                    Discard();
+
+protected:
+                            ScanCheckpoint(const WCHAR* root);
+    bool                    Load(DWORD options);
+    void                    SumSubtrees(const BYTE* view);
+    bool                    WriteSnapshot(const BYTE* view);
+    void                    Append(const BYTE* data, size_t len);
+    void                    StopWriter();
+    static void             WriterProc(ScanCheckpoint* pThis);
+
+private:
+    const std::wstring      m_root;
+    std::wstring            m_file;
+    SFileHandle             m_hFile;
+    SFileHandle             m_hRead;
+    SHandle                 m_hWake;
+    std::shared_ptr<CheckpointSnapshot> m_snapshot;
+
+    std::mutex              m_listings_mutex;
+    std::unordered_map<std::wstring, CheckpointListing> m_listings;
+
+    std::mutex              m_pending_mutex;
+    std::vector<BYTE>       m_pending;
+    bool                    m_stop = false;
+    std::unique_ptr<std::thread> m_writer;
+};
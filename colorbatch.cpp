@@ -0,0 +1,185 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "colorbatch.h"
+#include <cmath>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define USE_SSE_COLORBATCH
+#include <emmintrin.h>
+#endif
+
+// Same constants as HSLColorType.
+static const float c_hue = 360;
+static const float c_sat = 240;
+static const float c_lum = 240;
+
+static inline float quantize(const float value)
+{
+    return float(uint8_t((value * 255.0f) + 0.5f)) / 255;
+}
+
+static inline float hsl_channel(float rm1, const float rm2, float h)
+{
+    if (h >= c_hue)
+        h -= c_hue;
+    else if (h < 0)
+        h += c_hue;
+
+    if (h < c_hue / 6)
+        rm1 = rm1 + (rm2 - rm1) * h / (c_hue / 6);
+    else if (h < c_hue / 2)
+        rm1 = rm2;
+    else if (h < c_hue - (c_hue / 3))
+        rm1 = rm1 + (rm2 - rm1) * ((c_hue - (c_hue / 3)) - h) / (c_hue / 6);
+
+    return quantize(rm1);
+}
+
+static inline void hsl_to_rgb(float h, float s, float l, float& r, float& g, float& b)
+{
+    h = (h < 0) ? 0 : (h > c_hue) ? c_hue : h;
+    s = (s < 0) ? 0 : (s > c_sat) ? c_sat : s;
+    l = (l < 0) ? 0 : (l > c_lum) ? c_lum : l;
+
+    if (!s)
+    {
+        r = g = b = float(uint8_t(l * 255 / c_lum)) / 255;
+        return;
+    }
+
+    const float sat_ratio = s / c_sat;
+    const float lum_ratio = l / c_lum;
+
+    float rm2;
+    if (l <= c_lum / 2)
+        rm2 = lum_ratio + (lum_ratio * sat_ratio);
+    else
+        rm2 = (lum_ratio + sat_ratio) - (lum_ratio * sat_ratio);
+
+    const float rm1 = (2.0f * lum_ratio) - rm2;
+
+    r = hsl_channel(rm1, rm2, h + (c_hue / 3));
+    g = hsl_channel(rm1, rm2, h);
+    b = hsl_channel(rm1, rm2, h - (c_hue / 3));
+}
+
+void HslToRgbBatchScalar(const float* h, const float* s, const float* l, const size_t count, float* r, float* g, float* b)
+{
+    for (size_t ii = 0; ii < count; ++ii)
+        hsl_to_rgb(h[ii], s[ii], l[ii], r[ii], g[ii], b[ii]);
+}
+
+#ifdef USE_SSE_COLORBATCH
+
+static inline __m128 select_ps(const __m128 mask, const __m128 a, const __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128 quantize_ps(const __m128 value)
+{
+    const __m128 c255 = _mm_set1_ps(255.0f);
+    const __m128i bytes = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(value, c255), _mm_set1_ps(0.5f)));
+    return _mm_div_ps(_mm_cvtepi32_ps(bytes), c255);
+}
+
+static inline __m128 hsl_channel_ps(const __m128 rm1, const __m128 rm2, __m128 h)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 hue = _mm_set1_ps(c_hue);
+    const __m128 sixth = _mm_set1_ps(c_hue / 6);
+    const __m128 half = _mm_set1_ps(c_hue / 2);
+    const __m128 two_thirds = _mm_set1_ps(c_hue - (c_hue / 3));
+
+    const __m128 over = _mm_cmpge_ps(h, hue);
+    const __m128 under = _mm_cmplt_ps(h, zero);
+    h = _mm_sub_ps(h, _mm_and_ps(over, hue));
+    h = _mm_add_ps(h, _mm_and_ps(under, hue));
+
+    const __m128 delta = _mm_sub_ps(rm2, rm1);
+    const __m128 rising = _mm_add_ps(rm1, _mm_div_ps(_mm_mul_ps(delta, h), sixth));
+    const __m128 falling = _mm_add_ps(rm1, _mm_div_ps(_mm_mul_ps(delta, _mm_sub_ps(two_thirds, h)), sixth));
+
+    __m128 value = rm1;
+    value = select_ps(_mm_cmplt_ps(h, two_thirds), falling, value);
+    value = select_ps(_mm_cmplt_ps(h, half), rm2, value);
+    value = select_ps(_mm_cmplt_ps(h, sixth), rising, value);
+
+    return quantize_ps(value);
+}
+
+void HslToRgbBatch(const float* h, const float* s, const float* l, const size_t count, float* r, float* g, float* b)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 hue = _mm_set1_ps(c_hue);
+    const __m128 sat = _mm_set1_ps(c_sat);
+    const __m128 lum = _mm_set1_ps(c_lum);
+    const __m128 half_lum = _mm_set1_ps(c_lum / 2);
+    const __m128 third = _mm_set1_ps(c_hue / 3);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 c255 = _mm_set1_ps(255.0f);
+
+    size_t ii = 0;
+    for (; ii + 4 <= count; ii += 4)
+    {
+        const __m128 vh = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(h + ii), zero), hue);
+        const __m128 vs = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(s + ii), zero), sat);
+        const __m128 vl = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(l + ii), zero), lum);
+
+        const __m128 sat_ratio = _mm_div_ps(vs, sat);
+        const __m128 lum_ratio = _mm_div_ps(vl, lum);
+        const __m128 product = _mm_mul_ps(lum_ratio, sat_ratio);
+
+        const __m128 rm2 = select_ps(_mm_cmple_ps(vl, half_lum),
+                                     _mm_add_ps(lum_ratio, product),
+                                     _mm_sub_ps(_mm_add_ps(lum_ratio, sat_ratio), product));
+        const __m128 rm1 = _mm_sub_ps(_mm_mul_ps(two, lum_ratio), rm2);
+
+        const __m128 gray_mask = _mm_cmpeq_ps(vs, zero);
+        const __m128 gray = _mm_div_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_div_ps(_mm_mul_ps(vl, c255), lum))), c255);
+
+        _mm_storeu_ps(r + ii, select_ps(gray_mask, gray, hsl_channel_ps(rm1, rm2, _mm_add_ps(vh, third))));
+        _mm_storeu_ps(g + ii, select_ps(gray_mask, gray, hsl_channel_ps(rm1, rm2, vh)));
+        _mm_storeu_ps(b + ii, select_ps(gray_mask, gray, hsl_channel_ps(rm1, rm2, _mm_sub_ps(vh, third))));
+    }
+
+    HslToRgbBatchScalar(h + ii, s + ii, l + ii, count - ii, r + ii, g + ii, b + ii);
+}
+
+#else
+
+void HslToRgbBatch(const float* h, const float* s, const float* l, const size_t count, float* r, float* g, float* b)
+{
+    HslToRgbBatchScalar(h, s, l, count, r, g, b);
+}
+
+#endif
+
+static inline float linear_to_srgb(const float value)
+{
+    const float x = (value >= 0.0031308f) ? (1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f) : (12.92f * value);
+    const int byte = int(x * 255);
+    return float((byte < 0) ? 0 : (byte > 255) ? 255 : byte) / 255;
+}
+
+void OklabToRgbBatch(const float* L, const float* A, const float* B, const size_t count, float* r, float* g, float* b)
+{
+    // The gamma curve needs pow(), which has no SSE equivalent, so this stays
+    // scalar; batching still keeps it out of the per-arc paint path.
+    for (size_t ii = 0; ii < count; ++ii)
+    {
+        float l = L[ii] + 0.3963377774f * A[ii] + 0.2158037573f * B[ii];
+        float m = L[ii] - 0.1055613458f * A[ii] - 0.0638541728f * B[ii];
+        float s = L[ii] - 0.0894841775f * A[ii] - 1.2914855480f * B[ii];
+
+        l = l * l * l;
+        m = m * m * m;
+        s = s * s * s;
+
+        r[ii] = linear_to_srgb(+4.0767416621f * l - 3.3077115913f * m + 0.2309699292f * s);
+        g[ii] = linear_to_srgb(-1.2684380046f * l + 2.6097574011f * m - 0.3413193965f * s);
+        b[ii] = linear_to_srgb(-0.0041960863f * l - 0.7034186147f * m + 1.7076147010f * s);
+    }
+}
@@ -0,0 +1,20 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+// Batched color space conversion.
+//
+// The sunburst colors every arc once per layout, so conversions are done a
+// whole ring at a time over parallel arrays, which lets the HSL conversion
+// use SSE on x86-64.  The results match HSLColorType::ToRGB and
+// Oklab::to_rgb exactly:  each channel is quantized to a byte and returned
+// as byte / 255.
+
+#pragma once
+
+#include <cstddef>
+
+// Hue is 0..360, saturation and luminance are 0..240.
+void HslToRgbBatch(const float* h, const float* s, const float* l, size_t count, float* r, float* g, float* b);
+void HslToRgbBatchScalar(const float* h, const float* s, const float* l, size_t count, float* r, float* g, float* b);
+
+void OklabToRgbBatch(const float* L, const float* A, const float* B, size_t count, float* r, float* g, float* b);
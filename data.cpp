@@ -5,6 +5,10 @@
 #include "data.h"
 #include <shellapi.h>
 #include <assert.h>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <thread>
 
 #ifdef DEBUG
 static thread_local bool s_make_fake = false;
@@ -45,37 +49,112 @@ void skip_nonseparators(const WCHAR*& path)
         ++path;
 }
 
-static void build_full_path(std::wstring& path, const std::shared_ptr<const Node>& node)
+//----------------------------------------------------------------------------
+// Path cache.
+//
+// Hovering, scan progress, and context menus all ask for full paths, and
+// most of those requests are for siblings or near relatives of the previous
+// request.  A small direct-mapped cache of directory paths means building a
+// path usually only walks up to the parent, so the cost is proportional to
+// the length of the name rather than the depth of the tree.  A node's name
+// and parent never change, so entries never go stale; the weak_ptr keeps a
+// freed node's address from aliasing a new node.
+
+static const size_t c_path_cache_size = 256;
+
+struct PathCacheEntry
 {
-    if (!node)
-    {
-        path.clear();
-    }
-    else if (node->AsFreeSpace())
+    std::weak_ptr<const DirNode> dir;
+    std::wstring            path;           // With trailing separator.
+};
+
+static std::mutex s_path_cache_mutex;
+static PathCacheEntry s_path_cache[c_path_cache_size];
+
+static PathCacheEntry& path_cache_entry(const DirNode* dir)
+{
+    return s_path_cache[std::hash<const DirNode*>()(dir) % c_path_cache_size];
+}
+
+static bool lookup_path_cache(const DirNode* dir, std::wstring& path)
+{
+    std::lock_guard<std::mutex> lock(s_path_cache_mutex);
+
+    const PathCacheEntry& entry = path_cache_entry(dir);
+    if (entry.dir.lock().get() != dir)
+        return false;
+
+    path = entry.path;
+    return true;
+}
+
+static void store_path_cache(const std::shared_ptr<const DirNode>& dir, const std::wstring& path)
+{
+    std::lock_guard<std::mutex> lock(s_path_cache_mutex);
+
+    PathCacheEntry& entry = path_cache_entry(dir.get());
+    entry.dir = dir;
+    entry.path = path;
+}
+
+static bool build_special_path(std::wstring& path, const Node* node)
+{
+    if (node->AsFreeSpace())
     {
         path = node->GetName();
+        return true;
     }
-    else
+
+    const DirNode* dir = node->AsDir();
+    if (dir && dir->IsRecycleBin())
     {
-        const DirNode* dir = node->AsDir();
-        if (dir && dir->IsRecycleBin())
+        const auto parent = dir->GetParent();
+        path = dir->GetName();
+        if (parent)
         {
-            const auto parent = dir->GetParent();
-            path = dir->GetName();
-            if (parent)
-            {
-                path.append(TEXT(" on "));
-                path.append(parent->GetName());
-                strip_separator(path);
-            }
+            path.append(TEXT(" on "));
+            path.append(parent->GetName());
+            strip_separator(path);
         }
-        else
+        return true;
+    }
+
+    return false;
+}
+
+static void build_full_path(std::wstring& path, const std::shared_ptr<const Node>& node)
+{
+    path.clear();
+    if (!node)
+        return;
+
+    // Walk up until reaching an ancestor whose path is known, then append
+    // the names back down.  The chain holds references so that ancestors
+    // can't be freed partway through.
+
+    static thread_local std::vector<std::shared_ptr<const Node>> s_chain;
+    assert(s_chain.empty());
+
+    for (std::shared_ptr<const Node> walk = node; walk; walk = walk->GetParent())
+    {
+        if (build_special_path(path, walk.get()))
+            break;
+        const DirNode* dir = walk->AsDir();
+        if (dir && lookup_path_cache(dir, path))
+            break;
+        s_chain.emplace_back(std::move(walk));
+    }
+
+    while (s_chain.size())
+    {
+        const std::shared_ptr<const Node>& link = s_chain.back();
+        path.append(link->GetName());
+        if (link->AsDir())
         {
-            build_full_path(path, node->GetParent());
-            path.append(node->GetName());
-            if (dir)
-                ensure_separator(path);
+            ensure_separator(path);
+            store_path_cache(std::static_pointer_cast<const DirNode>(link), path);
         }
+        s_chain.pop_back();
     }
 }
 
@@ -220,6 +299,12 @@ static volatile LONG s_cNodes = 0;
 LONG CountNodes() { return s_cNodes; }
 #endif
 
+// Approximate memory used by nodes:  the node itself, its shared_ptr control
+// block, its slot in the parent, and its name.
+constexpr LONGLONG c_node_overhead = 128;
+static volatile LONGLONG s_node_bytes = 0;
+ULONGLONG GetNodeBytes() { return ULONGLONG(s_node_bytes); }
+
 Node::Node(const WCHAR* name, const std::shared_ptr<DirNode>& parent)
 : m_name(name)
 , m_parent(parent)
@@ -227,6 +312,7 @@ Node::Node(const WCHAR* name, const std::shared_ptr<DirNode>& parent)
 , m_fake(s_make_fake)
 #endif
 {
+    InterlockedAdd64(&s_node_bytes, c_node_overhead + LONGLONG(m_name.length() * sizeof(WCHAR)));
 #ifdef DEBUG
     InterlockedIncrement(&s_cNodes);
 #endif
@@ -234,6 +320,7 @@ Node::Node(const WCHAR* name, const std::shared_ptr<DirNode>& parent)
 
 Node::~Node()
 {
+    InterlockedAdd64(&s_node_bytes, -(c_node_overhead + LONGLONG(m_name.length() * sizeof(WCHAR))));
 #ifdef DEBUG
     InterlockedDecrement(&s_cNodes);
 #endif
@@ -253,9 +340,24 @@ void Node::GetFullPath(std::wstring& out) const
 
 std::vector<std::shared_ptr<DirNode>> DirNode::CopyDirs(bool include_recycle) const
 {
+    const_cast<DirNode*>(this)->PageIn();
+
     std::lock_guard<std::recursive_mutex> lock(m_node_mutex);
 
-    std::vector<std::shared_ptr<DirNode>> dirs = m_dirs;
+    std::vector<std::shared_ptr<DirNode>> dirs;
+    if (!m_dead_dirs)
+    {
+        dirs = m_dirs;
+    }
+    else
+    {
+        dirs.reserve(m_dirs.size() - m_dead_dirs + 1);
+        for (const auto& dir : m_dirs)
+        {
+            if (dir)
+                dirs.emplace_back(dir);
+        }
+    }
     if (include_recycle && GetRecycleBin())
         dirs.emplace_back(GetRecycleBin());
     return dirs;
@@ -263,9 +365,21 @@ std::vector<std::shared_ptr<DirNode>> DirNode::CopyDirs(bool include_recycle) co
 
 std::vector<std::shared_ptr<FileNode>> DirNode::CopyFiles() const
 {
+    const_cast<DirNode*>(this)->PageIn();
+
     std::lock_guard<std::recursive_mutex> lock(m_node_mutex);
 
-    return m_files;
+    if (!m_dead_files)
+        return m_files;
+
+    std::vector<std::shared_ptr<FileNode>> files;
+    files.reserve(m_files.size() - m_dead_files);
+    for (const auto& file : m_files)
+    {
+        if (file)
+            files.emplace_back(file);
+    }
+    return files;
 }
 
 ULONGLONG DirNode::GetEffectiveSize() const
@@ -276,29 +390,114 @@ ULONGLONG DirNode::GetEffectiveSize() const
         return std::max<ULONGLONG>(GetFreeSpace()->GetUsedSize(), GetSize());
 }
 
-std::shared_ptr<DirNode> DirNode::AddDir(const WCHAR* name)
+static std::atomic<ULONGLONG> s_change_generation(0);
+
+static ULONGLONG next_change_generation()
 {
-    std::shared_ptr<DirNode> parent(std::static_pointer_cast<DirNode>(shared_from_this()));
-    std::shared_ptr<DirNode> dir = std::make_shared<DirNode>(name, parent);
+    return ++s_change_generation;
+}
 
+void DirNode::RaiseChangeGeneration(const ULONGLONG gen)
+{
+    // Writers can race, e.g. a scan worker finishing a directory while
+    // another adds to the same ancestor, so a generation never goes back.
+    ULONGLONG prev = m_change_gen;
+    while (prev < gen)
     {
-        std::lock_guard<std::recursive_mutex> lock(m_node_mutex);
+        if (m_change_gen.compare_exchange_weak(prev, gen))
+            break;
+    }
+}
 
-        m_dirs.emplace_back(dir);
+void DirNode::MarkChanged()
+{
+    const ULONGLONG gen = next_change_generation();
 
-        m_count_dirs++;
+    RaiseChangeGeneration(gen);
 
-        std::shared_ptr<DirNode> parent(m_parent.lock());
-        while (parent)
-        {
-            parent->m_count_dirs++;
-            parent = parent->m_parent.lock();
-        }
+    std::shared_ptr<DirNode> parent(GetLinkedParent());
+    while (parent)
+    {
+        parent->RaiseChangeGeneration(gen);
+        parent = parent->GetLinkedParent();
     }
+}
+
+void DirNode::Finish()
+{
+    m_finished = true;
+    MarkChanged();
+}
+
+void DirNode::Hide(bool hide)
+{
+    m_hide = hide;
+    MarkChanged();
+}
 
+std::shared_ptr<DirNode> DirNode::AddDir(const WCHAR* name)
+{
+    std::shared_ptr<DirNode> parent(std::static_pointer_cast<DirNode>(shared_from_this()));
+    std::shared_ptr<DirNode> dir = std::make_shared<DirNode>(name, parent);
+    LinkDir(dir);
     return dir;
 }
 
+std::shared_ptr<MountPointNode> DirNode::AddMountPoint(const WCHAR* name, const WCHAR* volume)
+{
+    std::shared_ptr<DirNode> parent(std::static_pointer_cast<DirNode>(shared_from_this()));
+    std::shared_ptr<MountPointNode> mount = std::make_shared<MountPointNode>(name, volume, parent);
+    LinkDir(mount);
+    return mount;
+}
+
+std::shared_ptr<DirNode> DirNode::AddStubDir(const WCHAR* name, ULONGLONG size, ULONGLONG count_dirs, ULONGLONG count_files, const std::shared_ptr<DirSource>& source, const ULONGLONG key)
+{
+    std::shared_ptr<DirNode> parent(std::static_pointer_cast<DirNode>(shared_from_this()));
+    std::shared_ptr<DirNode> dir = std::make_shared<DirNode>(name, parent);
+    dir->m_size = size;
+    dir->m_count_dirs = count_dirs;
+    dir->m_count_files = count_files;
+    dir->m_source = source;
+    dir->m_source_key = key;
+    dir->m_finished = true;
+    LinkDir(dir);
+    return dir;
+}
+
+void DirNode::LinkDir(const std::shared_ptr<DirNode>& dir)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_node_mutex);
+
+    dir->m_slot = m_dirs.size();
+    m_dirs.emplace_back(dir);
+
+    if (m_paging)
+        return;
+
+    // A stub arrives with its subtree totals already in place.
+    const ULONGLONG count_dirs = 1 + dir->m_count_dirs;
+    const ULONGLONG count_files = dir->m_count_files;
+    const ULONGLONG size = dir->m_size;
+
+    const ULONGLONG gen = next_change_generation();
+
+    m_count_dirs += count_dirs;
+    m_count_files += count_files;
+    m_size += size;
+    RaiseChangeGeneration(gen);
+
+    std::shared_ptr<DirNode> parent(GetLinkedParent());
+    while (parent)
+    {
+        parent->m_count_dirs += count_dirs;
+        parent->m_count_files += count_files;
+        parent->m_size += size;
+        parent->RaiseChangeGeneration(gen);
+        parent = parent->GetLinkedParent();
+    }
+}
+
 std::shared_ptr<FileNode> DirNode::AddFile(const WCHAR* name, ULONGLONG size)
 {
     std::shared_ptr<DirNode> parent(std::static_pointer_cast<DirNode>(shared_from_this()));
@@ -307,27 +506,120 @@ std::shared_ptr<FileNode> DirNode::AddFile(const WCHAR* name, ULONGLONG size)
     {
         std::lock_guard<std::recursive_mutex> lock(m_node_mutex);
 
+        file->m_slot = m_files.size();
         m_files.emplace_back(file);
 
-        m_size += size;
-        m_count_files++;
-
-        std::shared_ptr<DirNode> parent(m_parent.lock());
-        while (parent)
+        if (!m_paging)
         {
-            parent->m_size += size;
-            parent->m_count_files++;
-            parent = parent->m_parent.lock();
+            const ULONGLONG gen = next_change_generation();
+
+            m_size += size;
+            m_count_files++;
+            RaiseChangeGeneration(gen);
+
+            std::shared_ptr<DirNode> parent(GetLinkedParent());
+            while (parent)
+            {
+                parent->m_size += size;
+                parent->m_count_files++;
+                parent->RaiseChangeGeneration(gen);
+                parent = parent->GetLinkedParent();
+            }
         }
     }
 
     return file;
 }
 
+std::shared_ptr<AggregateNode> DirNode::AddToAggregate(ULONGLONG size)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_node_mutex);
+
+    if (!m_aggregate)
+    {
+        std::shared_ptr<DirNode> parent(std::static_pointer_cast<DirNode>(shared_from_this()));
+        m_aggregate = std::make_shared<AggregateNode>(parent);
+        m_aggregate->m_slot = m_files.size();
+        m_files.emplace_back(m_aggregate);
+    }
+
+    m_aggregate->Add(size);
+
+    if (m_paging)
+        return m_aggregate;
+
+    const ULONGLONG gen = next_change_generation();
+
+    m_size += size;
+    m_count_files++;
+    RaiseChangeGeneration(gen);
+
+    std::shared_ptr<DirNode> parent(GetLinkedParent());
+    while (parent)
+    {
+        parent->m_size += size;
+        parent->m_count_files++;
+        parent->RaiseChangeGeneration(gen);
+        parent = parent->GetLinkedParent();
+    }
+
+    return m_aggregate;
+}
+
+void DirNode::CollapseFiles(ULONGLONG below)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_node_mutex);
+
+    // The files move into the aggregate, so the totals don't change.
+    std::shared_ptr<AggregateNode> aggregate = m_aggregate;
+    std::vector<std::shared_ptr<FileNode>> keep;
+    keep.reserve(m_files.size());
+
+    for (auto& file : m_files)
+    {
+        if (!file)
+            continue;
+
+        if (file->GetSize() >= below || file->AsAggregate())
+        {
+            file->m_slot = keep.size();
+            keep.emplace_back(std::move(file));
+            continue;
+        }
+
+        if (!aggregate)
+            aggregate = std::make_shared<AggregateNode>(std::static_pointer_cast<DirNode>(shared_from_this()));
+        aggregate->Add(file->GetSize());
+    }
+
+    if (aggregate && !m_aggregate)
+    {
+        m_aggregate = aggregate;
+        m_aggregate->m_slot = keep.size();
+        keep.emplace_back(std::move(aggregate));
+    }
+
+    m_files.swap(keep);
+    m_dead_files = 0;
+
+    MarkChanged();
+}
+
+void AggregateNode::Add(ULONGLONG size)
+{
+    m_size += size;
+    m_count++;
+    m_max = std::max(m_max, size);
+}
+
 void DirNode::DeleteChild(const std::shared_ptr<Node>& node)
 {
     std::lock_guard<std::recursive_mutex> lock(m_node_mutex);
 
+    // Paging the children in again would bring the deleted child back.
+    if (m_paged_in)
+        m_source.reset();
+
     if (node->AsDir())
     {
         DirNode* dir = node->AsDir();
@@ -337,46 +629,89 @@ void DirNode::DeleteChild(const std::shared_ptr<Node>& node)
             return;
         }
 
-        for (auto iter = m_dirs.begin(); iter != m_dirs.end(); ++iter)
+        const size_t slot = dir->m_slot;
+        if (slot >= m_dirs.size() || m_dirs[slot].get() != dir)
+            return;
+
+        const ULONGLONG gen = next_change_generation();
+
+        std::shared_ptr<DirNode> parent(std::static_pointer_cast<DirNode>(shared_from_this()));
+        while (parent)
         {
-            if (iter->get() == dir)
-            {
-                std::shared_ptr<DirNode> parent(std::static_pointer_cast<DirNode>(shared_from_this()));
-                while (parent)
-                {
-                    parent->m_size -= dir->GetSize();
-                    parent->m_count_dirs -= dir->CountDirs();
-                    parent->m_count_files -= dir->CountFiles();
-                    parent = parent->m_parent.lock();
-                }
-
-                m_dirs.erase(iter);
-                return;
-            }
+            parent->m_size -= dir->GetSize();
+            parent->m_count_dirs -= dir->CountDirs();
+            parent->m_count_files -= dir->CountFiles();
+            parent->RaiseChangeGeneration(gen);
+            parent = parent->GetLinkedParent();
         }
+
+        std::shared_ptr<DirNode> reclaim = std::move(m_dirs[slot]);
+        m_dead_dirs++;
+        CompactIfSparse();
+        ReclaimInBackground(reclaim);
     }
     else
     {
         FileNode* file = node->AsFile();
-        for (auto iter = m_files.begin(); iter != m_files.end(); ++iter)
+        const size_t slot = file->m_slot;
+        if (slot >= m_files.size() || m_files[slot].get() != file)
+            return;
+
+        const ULONGLONG count = file->AsAggregate() ? file->AsAggregate()->CountFiles() : 1;
+
+        const ULONGLONG gen = next_change_generation();
+
+        std::shared_ptr<DirNode> parent(std::static_pointer_cast<DirNode>(shared_from_this()));
+        while (parent)
         {
-            if (iter->get() == file)
-            {
-                std::shared_ptr<DirNode> parent(std::static_pointer_cast<DirNode>(shared_from_this()));
-                while (parent)
-                {
-                    parent->m_size -= file->GetSize();
-                    parent->m_count_files--;
-                    parent = parent->m_parent.lock();
-                }
-
-                m_files.erase(iter);
-                return;
-            }
+            parent->m_size -= file->GetSize();
+            parent->m_count_files -= count;
+            parent->RaiseChangeGeneration(gen);
+            parent = parent->GetLinkedParent();
         }
+
+        if (file == m_aggregate.get())
+            m_aggregate.reset();
+        m_files[slot].reset();
+        m_dead_files++;
+        CompactIfSparse();
+    }
+}
+
+// Deleting a child leaves a tombstone, so that deleting is O(1) and the rest
+// of the children keep their order for layout.  Compacting once tombstones
+// fill half the slots keeps the cost amortized O(1).
+constexpr size_t c_min_compact = 64;
+
+void DirNode::CompactIfSparse()
+{
+    if (m_dead_dirs >= c_min_compact && m_dead_dirs * 2 >= m_dirs.size())
+    {
+        Compact(m_dirs);
+        m_dead_dirs = 0;
+    }
+    if (m_dead_files >= c_min_compact && m_dead_files * 2 >= m_files.size())
+    {
+        Compact(m_files);
+        m_dead_files = 0;
     }
 }
 
+template <class T> void DirNode::Compact(std::vector<std::shared_ptr<T>>& children)
+{
+    size_t slot = 0;
+    for (size_t ii = 0; ii < children.size(); ++ii)
+    {
+        if (!children[ii])
+            continue;
+        children[ii]->m_slot = slot;
+        if (ii != slot)
+            children[slot] = std::move(children[ii]);
+        ++slot;
+    }
+    children.resize(slot);
+}
+
 void DirNode::Clear()
 {
     std::lock_guard<std::recursive_mutex> lock(m_node_mutex);
@@ -389,12 +724,15 @@ void DirNode::Clear()
     }
 #endif
 
+    const ULONGLONG gen = next_change_generation();
+
     std::shared_ptr<DirNode> parent(GetParent());
     while (parent)
     {
         parent->m_size -= GetSize();
         parent->m_count_dirs -= CountDirs();
         parent->m_count_files -= CountFiles();
+        parent->RaiseChangeGeneration(gen);
 
         std::shared_ptr<DirNode> up = parent->m_parent.lock();
         if (!up)
@@ -402,8 +740,15 @@ void DirNode::Clear()
         parent = up;
     }
 
+    ReclaimInBackground(std::move(m_dirs), std::move(m_files));
     m_dirs.clear();
     m_files.clear();
+    m_aggregate.reset();
+    m_source.reset();
+    m_source_key = 0;
+    m_paged_in = false;
+    m_dead_dirs = 0;
+    m_dead_files = 0;
     m_count_dirs = 0;
     m_count_files = 0;
     m_size = 0;
@@ -412,8 +757,392 @@ void DirNode::Clear()
         AsDrive()->AddFreeSpace();
 
     m_finished = false;
+    RaiseChangeGeneration(gen);
+}
+
+std::shared_ptr<DirNode> DirNode::MakeShadow()
+{
+    // Top level roots have no parent to swap a shadow into, and the Recycle
+    // Bin is never scanned.
+    std::shared_ptr<DirNode> parent = GetParent();
+    if (!parent || IsRecycleBin() || IsDrive())
+        return nullptr;
+
+    std::shared_ptr<DirNode> shadow;
+    if (AsMountPoint())
+        shadow = std::make_shared<MountPointNode>(GetName(), AsMountPoint()->GetVolumeName(), parent);
+    else
+        shadow = std::make_shared<DirNode>(GetName(), parent);
+    shadow->m_original = std::static_pointer_cast<DirNode>(shared_from_this());
+    shadow->m_hide = m_hide;
+    return shadow;
 }
 
+std::shared_ptr<DirNode> DirNode::Attach()
+{
+    assert(IsShadow());
+
+    std::shared_ptr<DirNode> original;
+    original.swap(m_original);
+
+    // The original may have been deleted while the shadow was being built;
+    // in that case there is nothing to replace.
+    std::shared_ptr<DirNode> parent = GetParent();
+    if (!original || !parent || !parent->ReplaceDir(original, std::static_pointer_cast<DirNode>(shared_from_this())))
+        return nullptr;
+
+    return original;
+}
+
+bool DirNode::ReplaceDir(const std::shared_ptr<DirNode>& original, const std::shared_ptr<DirNode>& shadow)
+{
+    std::lock_guard<std::recursive_mutex> lock(m_node_mutex);
+
+    // Paging the children in again would bring back the stale original.
+    if (m_paged_in)
+        m_source.reset();
+
+    const size_t slot = original->m_slot;
+    if (slot >= m_dirs.size() || m_dirs[slot] != original)
+        return false;
+
+    // Adjust the ancestors by the delta in one pass.  Unsigned wraparound
+    // makes subtract-then-add correct even when the subtree shrank.
+    const ULONGLONG gen = next_change_generation();
+
+    std::shared_ptr<DirNode> parent(std::static_pointer_cast<DirNode>(shared_from_this()));
+    while (parent)
+    {
+        parent->m_size = parent->m_size - original->GetSize() + shadow->GetSize();
+        parent->m_count_dirs = parent->m_count_dirs - original->CountDirs() + shadow->CountDirs();
+        parent->m_count_files = parent->m_count_files - original->CountFiles() + shadow->CountFiles();
+        parent->RaiseChangeGeneration(gen);
+        parent = parent->GetLinkedParent();
+    }
+
+    shadow->m_slot = slot;
+    m_dirs[slot] = shadow;
+    return true;
+}
+
+//----------------------------------------------------------------------------
+// Paging stubs.
+//
+// Paged in stubs are queued oldest first.  The clock algorithm approximates
+// LRU:  a stub that was queried since the last sweep goes to the back of the
+// queue instead of being paged out.  So does a stub whose children are still
+// referenced elsewhere, for example by arcs on screen.
+
+constexpr size_t c_max_paged_in = 4096;
+constexpr size_t c_max_sweep = 64;
+
+static std::mutex s_paged_mutex;            // Never held while acquiring another lock.
+static std::deque<std::weak_ptr<DirNode>> s_paged_in;
+
+void DirNode::PageIn()
+{
+    std::shared_ptr<DirSource> source;
+    ULONGLONG key = 0;
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_node_mutex);
+
+        if (!m_source)
+            return;
+        m_touched = true;
+        if (m_paged_in)
+            return;
+
+        source = m_source;
+        key = m_source_key;
+    }
+
+    // Reading is the slow part, so the node isn't locked meanwhile.
+    std::unique_ptr<DirSource::Listing> listing = source->ReadChildren(key);
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_node_mutex);
+
+        // Another thread may have paged it in first, or the node may have
+        // been changed so that its source no longer applies.
+        if (m_paged_in || m_source != source)
+            return;
+
+        // The children are already counted in the totals.
+        m_paged_in = true;
+        if (listing)
+        {
+            m_paging = true;
+            source->AddChildren(std::static_pointer_cast<DirNode>(shared_from_this()), *listing);
+            m_paging = false;
+        }
+    }
+
+    std::vector<std::shared_ptr<DirNode>> sweep;
+    {
+        std::lock_guard<std::mutex> lock(s_paged_mutex);
+
+        s_paged_in.emplace_back(std::static_pointer_cast<DirNode>(shared_from_this()));
+        while (s_paged_in.size() > c_max_paged_in && sweep.size() < c_max_sweep)
+        {
+            std::shared_ptr<DirNode> old = s_paged_in.front().lock();
+            s_paged_in.pop_front();
+            if (old)
+                sweep.emplace_back(std::move(old));
+        }
+    }
+
+    for (auto iter = sweep.begin(); iter != sweep.end();)
+    {
+        if ((*iter)->PageOut())
+            iter = sweep.erase(iter);
+        else
+            ++iter;
+    }
+
+    if (!sweep.empty())
+    {
+        std::lock_guard<std::mutex> lock(s_paged_mutex);
+
+        for (auto& old : sweep)
+            s_paged_in.emplace_back(old);
+    }
+}
+
+bool DirNode::PageOut()
+{
+    // Only try the lock, since the caller may hold some other node's lock.
+    std::unique_lock<std::recursive_mutex> lock(m_node_mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return false;
+
+    if (!m_source || !m_paged_in)
+        return true;
+
+    if (m_touched)
+    {
+        m_touched = false;
+        return false;
+    }
+
+    // Subdirectories must be stubs themselves, so that nothing deeper gets
+    // dropped along with them.
+    for (const auto& dir : m_dirs)
+    {
+        if (dir && (dir.use_count() > 1 || !dir->IsStub()))
+            return false;
+    }
+    for (const auto& file : m_files)
+    {
+        if (file && file.use_count() > (file == m_aggregate ? 2 : 1))
+            return false;
+    }
+
+    ReclaimInBackground(std::move(m_dirs), std::move(m_files));
+    m_dirs.clear();
+    m_files.clear();
+    m_aggregate.reset();
+    m_dead_dirs = 0;
+    m_dead_files = 0;
+    m_paged_in = false;
+    return true;
+}
+
+void DirNode::Teardown(std::shared_ptr<DirNode>&& top)
+{
+    // Release the subtree iteratively, so that a deep tree can't overflow
+    // the stack.  The stack holds the only reference to each directory it
+    // owns, so a higher use count means something else (e.g. a layout, the
+    // hover node, or the back stack) still refers to the directory.  Those
+    // are left intact, and are released normally once the last outside
+    // reference goes away.
+    std::vector<std::shared_ptr<DirNode>> stack;
+    stack.emplace_back(std::move(top));
+
+    while (!stack.empty())
+    {
+        std::shared_ptr<DirNode> dir = std::move(stack.back());
+        stack.pop_back();
+
+        if (dir.use_count() > 1)
+            continue;
+
+        std::vector<std::shared_ptr<DirNode>> dirs;
+        std::vector<std::shared_ptr<FileNode>> files;
+        {
+            std::lock_guard<std::recursive_mutex> lock(dir->m_node_mutex);
+            dirs.swap(dir->m_dirs);
+            files.swap(dir->m_files);
+            dir->m_aggregate.reset();
+            dir->m_dead_dirs = 0;
+            dir->m_dead_files = 0;
+        }
+
+        files.clear();
+        for (auto& child : dirs)
+        {
+            if (child)
+                stack.emplace_back(std::move(child));
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// Reclaimer.
+//
+// Releasing a large tree means freeing millions of nodes.  Detached subtrees
+// are handed to a low priority thread that tears them down iteratively, so
+// the UI thread never pays for it.  A subtree that is still referenced
+// elsewhere (e.g. by a layout that hasn't been replaced yet) is retried
+// later, rather than emptied out from under its users.
+
+constexpr DWORD c_reclaim_retry_ms = 1000;
+
+class Reclaimer
+{
+    struct Item
+    {
+        std::vector<std::shared_ptr<DirNode>> m_dirs;
+        std::vector<std::shared_ptr<FileNode>> m_files;
+        ULONGLONG           m_bytes = 0;
+    };
+
+public:
+    void                    Add(std::vector<std::shared_ptr<DirNode>>&& dirs, std::vector<std::shared_ptr<FileNode>>&& files);
+    ULONGLONG               GetPendingBytes();
+
+protected:
+    static void             ThreadProc(Reclaimer* pThis);
+
+private:
+    std::mutex              m_mutex;
+    SHandle                 m_hWake;
+    std::vector<Item>       m_queue;
+    ULONGLONG               m_pending_bytes = 0;
+    bool                    m_started = false;
+};
+
+// Intentionally never destroyed; the thread runs until the process exits,
+// and process exit releases everything anyway.
+static Reclaimer* const s_reclaimer = new Reclaimer;
+
+static ULONGLONG estimate_bytes(const DirNode& dir)
+{
+    // Approximate; doesn't include names or vector slack.
+    return (dir.CountDirs() + 1) * sizeof(DirNode) + dir.CountFiles() * sizeof(FileNode);
+}
+
+void Reclaimer::Add(std::vector<std::shared_ptr<DirNode>>&& dirs, std::vector<std::shared_ptr<FileNode>>&& files)
+{
+    if (dirs.empty() && files.empty())
+        return;
+
+    Item item;
+    for (const auto& dir : dirs)
+    {
+        if (dir)
+            item.m_bytes += estimate_bytes(*dir);
+    }
+    item.m_bytes += files.size() * sizeof(FileNode);
+    item.m_dirs = std::move(dirs);
+    item.m_files = std::move(files);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!m_started)
+        {
+            m_hWake = CreateEvent(nullptr, false, false, nullptr);
+            if (m_hWake.IsEmpty())
+                return;     // Release synchronously instead.
+            std::thread(ThreadProc, this).detach();
+            m_started = true;
+        }
+
+        m_pending_bytes += item.m_bytes;
+        m_queue.emplace_back(std::move(item));
+    }
+
+    SetEvent(m_hWake);
+}
+
+ULONGLONG Reclaimer::GetPendingBytes()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending_bytes;
+}
+
+void Reclaimer::ThreadProc(Reclaimer* pThis)
+{
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+
+    std::vector<Item> deferred;
+    while (true)
+    {
+        WaitForSingleObject(pThis->m_hWake, deferred.empty() ? INFINITE : c_reclaim_retry_ms);
+
+        if (!deferred.empty())
+        {
+            std::lock_guard<std::mutex> lock(pThis->m_mutex);
+            for (auto& item : deferred)
+                pThis->m_queue.emplace_back(std::move(item));
+            deferred.clear();
+        }
+
+        while (true)
+        {
+            Item item;
+            {
+                std::lock_guard<std::mutex> lock(pThis->m_mutex);
+                if (pThis->m_queue.empty())
+                    break;
+                item = std::move(pThis->m_queue.back());
+                pThis->m_queue.pop_back();
+            }
+
+            item.m_files.clear();
+
+            bool referenced = false;
+            for (auto& dir : item.m_dirs)
+            {
+                if (!dir)
+                    continue;
+                if (dir.use_count() > 1)
+                    referenced = true;
+                else
+                    DirNode::Teardown(std::move(dir));
+            }
+
+            if (referenced)
+            {
+                deferred.emplace_back(std::move(item));
+                continue;
+            }
+
+            std::lock_guard<std::mutex> lock(pThis->m_mutex);
+            pThis->m_pending_bytes -= item.m_bytes;
+        }
+    }
+}
+
+void ReclaimInBackground(const std::shared_ptr<DirNode>& dir)
+{
+    std::vector<std::shared_ptr<DirNode>> dirs;
+    dirs.emplace_back(dir);
+    s_reclaimer->Add(std::move(dirs), std::vector<std::shared_ptr<FileNode>>());
+}
+
+void ReclaimInBackground(std::vector<std::shared_ptr<DirNode>>&& dirs, std::vector<std::shared_ptr<FileNode>>&& files)
+{
+    s_reclaimer->Add(std::move(dirs), std::move(files));
+}
+
+ULONGLONG GetPendingReclaimBytes()
+{
+    return s_reclaimer->GetPendingBytes();
+}
+
+//----------------------------------------------------------------------------
+
 void DirNode::UpdateRecycleBinMetadata(ULONGLONG size)
 {
     assert(!IsFake());
@@ -421,6 +1150,8 @@ void DirNode::UpdateRecycleBinMetadata(ULONGLONG size)
     GetParent()->m_size -= m_size;
     m_size = size;
     GetParent()->m_size += m_size;
+
+    MarkChanged();
 }
 
 void RecycleBinNode::UpdateRecycleBin(std::recursive_mutex& ui_mutex)
@@ -491,5 +1222,33 @@ void DriveNode::AddFreeSpace(ULONGLONG free, ULONGLONG total)
 
         m_free = std::make_shared<FreeSpaceNode>(GetName(), free, total, parent);
     }
+
+    MarkChanged();
 }
 
+void MountPointNode::AddFreeSpace(std::recursive_mutex& ui_mutex)
+{
+    assert(!IsFake());
+
+    // Query the volume before taking the UI mutex, since that can be slow
+    // (e.g. a network volume, or a disk that has to spin up).
+    std::wstring path;
+    GetFullPath(path);
+
+    ULARGE_INTEGER free;
+    ULARGE_INTEGER total;
+    if (!GetDiskFreeSpaceEx(path.c_str(), nullptr, &total, &free))
+        return;
+
+    const std::shared_ptr<DirNode> parent = std::static_pointer_cast<DirNode>(shared_from_this());
+    const std::shared_ptr<FreeSpaceNode> node = std::make_shared<FreeSpaceNode>(path.c_str(), free.QuadPart, total.QuadPart, parent);
+
+    std::lock_guard<std::recursive_mutex> lock(ui_mutex);
+    {
+        std::lock_guard<std::recursive_mutex> lock2(m_node_mutex);
+
+        m_free = node;
+    }
+
+    MarkChanged();
+}
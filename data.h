@@ -6,10 +6,34 @@
 // DirNode contains other DirNode and FileNode instances.
 // Querying and adding children are threadsafe operations.
 //
+// A shadow DirNode is built off to the side for a rescan.  It has the same
+// parent as the DirNode it will replace, but its totals do not propagate to
+// the ancestors until Attach() swaps it into the parent.
+//
 // FileNode contains info about the file.
+//
+// MountPointNode is a DirNode where a different volume is mounted.
+//
+// AggregateNode is a FileNode that stands in for many small files in one
+// directory, when the scanner collapses them to save memory.  The totals
+// still include each of the files.  ExpandAggregate() in scan.h can bring
+// the individual files back.
+//
+// A stub DirNode carries only its subtree totals.  Its children are paged in
+// from its DirSource the first time they're queried, and a bounded number of
+// paged in stubs are kept; the least recently used ones are paged out again
+// once none of their children are referenced elsewhere.  Paging in reads the
+// children without holding any locks, and only adds them under the node's
+// lock, so a slow read doesn't stall other threads that use the node.
+//
+// Each DirNode has a change generation, which is updated whenever anything
+// in its subtree changes in a way that affects layout.  Generations come from
+// one increasing counter, so comparing a saved generation with the current
+// one tells whether the subtree has changed since.
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <vector>
@@ -21,6 +45,24 @@ class FileNode;
 class RecycleBinNode;
 class FreeSpaceNode;
 class DriveNode;
+class MountPointNode;
+class AggregateNode;
+
+ULONGLONG GetNodeBytes();
+
+class DirSource
+{
+public:
+    class Listing
+    {
+    public:
+        virtual             ~Listing() {}
+    };
+
+    virtual                 ~DirSource() {}
+    virtual std::unique_ptr<Listing> ReadChildren(ULONGLONG key) = 0;    // No locks held.
+    virtual void            AddChildren(const std::shared_ptr<DirNode>& dir, const Listing& listing) = 0;  // Under the node lock.
+};
 
 #ifdef DEBUG
 LONG CountNodes();
@@ -29,6 +71,7 @@ bool SetFake(bool fake);
 
 class Node : public std::enable_shared_from_this<Node>
 {
+    friend class DirNode;
 public:
                             Node(const WCHAR* name, const std::shared_ptr<DirNode>& parent);
     virtual                 ~Node();
@@ -45,12 +88,17 @@ public:
     virtual const FreeSpaceNode* AsFreeSpace() const { return nullptr; }
     virtual DriveNode*      AsDrive() { return nullptr; }
     virtual const DriveNode* AsDrive() const { return nullptr; }
+    virtual MountPointNode* AsMountPoint() { return nullptr; }
+    virtual const MountPointNode* AsMountPoint() const { return nullptr; }
+    virtual AggregateNode*  AsAggregate() { return nullptr; }
+    virtual const AggregateNode* AsAggregate() const { return nullptr; }
     void                    SetCompressed(bool compressed=true) { m_compressed = compressed; }
     bool                    IsCompressed() const { return m_compressed; }
     void                    SetSparse(bool sparse=true) { m_sparse = sparse; }
     bool                    IsSparse() const { return m_sparse; }
     virtual bool            IsRecycleBin() const { return false; }
     virtual bool            IsDrive() const { return false; }
+    virtual bool            IsMountPoint() const { return false; }
 #ifdef DEBUG
     bool                    IsFake() const { return m_fake; }
 #endif
@@ -59,6 +107,7 @@ protected:
     const std::wstring      m_name;
     bool                    m_compressed = false;
     bool                    m_sparse = false;
+    size_t                  m_slot = 0;     // Index in the parent's m_dirs or m_files.
 #ifdef DEBUG
     const bool              m_fake = false;
 #endif
@@ -79,25 +128,56 @@ public:
     virtual std::shared_ptr<FreeSpaceNode> GetFreeSpace() const { return nullptr; }
     ULONGLONG               GetSize() const { return m_size; }
     ULONGLONG               GetEffectiveSize() const;
-    void                    Hide(bool hide=true) { m_hide = hide; }
+    void                    Hide(bool hide=true);
     bool                    IsHidden() const { return m_hide; }
     std::shared_ptr<DirNode> AddDir(const WCHAR* name);
+    std::shared_ptr<MountPointNode> AddMountPoint(const WCHAR* name, const WCHAR* volume);
     std::shared_ptr<FileNode> AddFile(const WCHAR* name, ULONGLONG size);
+    std::shared_ptr<DirNode> AddStubDir(const WCHAR* name, ULONGLONG size, ULONGLONG count_dirs, ULONGLONG count_files, const std::shared_ptr<DirSource>& source, ULONGLONG key);
+    bool                    IsStub() const { return m_source && !m_paged_in; }
+    std::shared_ptr<AggregateNode> AddToAggregate(ULONGLONG size);
+    void                    CollapseFiles(ULONGLONG below);
     void                    DeleteChild(const std::shared_ptr<Node>& node);
     void                    Clear();
-    void                    Finish() { m_finished = true; }
+    void                    Finish();
     bool                    IsFinished() const { return m_finished; }
+    std::shared_ptr<DirNode> MakeShadow();
+    bool                    IsShadow() const { return !!m_original; }
+    std::shared_ptr<DirNode> GetOriginal() const { return m_original; }
+    std::shared_ptr<DirNode> Attach();
+    static void             Teardown(std::shared_ptr<DirNode>&& dir);
+    ULONGLONG               GetChangeGeneration() const { return m_change_gen; }
 protected:
     void                    UpdateRecycleBinMetadata(ULONGLONG size);
+    void                    MarkChanged();
     mutable std::recursive_mutex m_node_mutex;
 private:
+    std::shared_ptr<DirNode> GetLinkedParent() const { return m_original ? nullptr : m_parent.lock(); }
+    void                    LinkDir(const std::shared_ptr<DirNode>& dir);
+    void                    RaiseChangeGeneration(ULONGLONG gen);
+    bool                    ReplaceDir(const std::shared_ptr<DirNode>& original, const std::shared_ptr<DirNode>& shadow);
+    void                    PageIn();
+    bool                    PageOut();
+    void                    CompactIfSparse();
+    template <class T> static void Compact(std::vector<std::shared_ptr<T>>& children);
+
     std::vector<std::shared_ptr<DirNode>> m_dirs;
     std::vector<std::shared_ptr<FileNode>> m_files;
+    size_t                  m_dead_dirs = 0;    // Tombstones (nullptr) in m_dirs.
+    size_t                  m_dead_files = 0;   // Tombstones (nullptr) in m_files.
     ULONGLONG               m_count_dirs = 0;
     ULONGLONG               m_count_files = 0;
     ULONGLONG               m_size = 0;
+    std::atomic<ULONGLONG>  m_change_gen{ 0 };  // Last change anywhere in the subtree.
     bool                    m_finished = false;
     bool                    m_hide = false;
+    std::shared_ptr<DirNode> m_original;    // Set while this is a shadow.
+    std::shared_ptr<AggregateNode> m_aggregate; // Also in m_files.
+    std::shared_ptr<DirSource> m_source;    // Set while this is a stub.
+    ULONGLONG               m_source_key = 0;
+    bool                    m_paged_in = false;
+    bool                    m_paging = false;   // Children being added don't change the totals.
+    bool                    m_touched = false;  // Queried since the last eviction sweep.
 };
 
 class FileNode : public Node
@@ -107,8 +187,24 @@ public:
     FileNode*               AsFile() override { return this; }
     const FileNode*         AsFile() const override { return this; }
     ULONGLONG               GetSize() const { return m_size; }
+protected:
+    ULONGLONG               m_size;
+};
+
+class AggregateNode : public FileNode
+{
+    friend class DirNode;
+public:
+                            AggregateNode(const std::shared_ptr<DirNode>& parent) : FileNode(TEXT("Small Files"), 0, parent) {}
+    AggregateNode*          AsAggregate() override { return this; }
+    const AggregateNode*    AsAggregate() const override { return this; }
+    ULONGLONG               CountFiles() const { return m_count; }
+    ULONGLONG               GetMaxSize() const { return m_max; }
 private:
-    const ULONGLONG         m_size;
+    void                    Add(ULONGLONG size);
+
+    ULONGLONG               m_count = 0;
+    ULONGLONG               m_max = 0;
 };
 
 class RecycleBinNode : public DirNode
@@ -150,6 +246,21 @@ private:
     std::shared_ptr<FreeSpaceNode> m_free;
 };
 
+class MountPointNode : public DirNode
+{
+public:
+                            MountPointNode(const WCHAR* name, const WCHAR* volume, const std::shared_ptr<DirNode>& parent) : DirNode(name, parent), m_volume(volume) {}
+    MountPointNode*         AsMountPoint() override { return this; }
+    const MountPointNode*   AsMountPoint() const override { return this; }
+    const WCHAR*            GetVolumeName() const { return m_volume.c_str(); }
+    void                    AddFreeSpace(std::recursive_mutex& ui_mutex);
+    std::shared_ptr<FreeSpaceNode> GetFreeSpace() const override { return m_free; }
+    bool                    IsMountPoint() const override { return true; }
+private:
+    const std::wstring      m_volume;
+    std::shared_ptr<FreeSpaceNode> m_free;
+};
+
 inline bool is_separator(const WCHAR ch) { return ch == '/' || ch == '\\'; }
 void ensure_separator(std::wstring& path);
 void strip_separator(std::wstring& path);
@@ -157,6 +268,10 @@ void skip_separators(const WCHAR*& path);
 void skip_nonseparators(const WCHAR*& path);
 unsigned int has_io_prefix(const WCHAR* path);
 
+void ReclaimInBackground(const std::shared_ptr<DirNode>& dir);
+void ReclaimInBackground(std::vector<std::shared_ptr<DirNode>>&& dirs, std::vector<std::shared_ptr<FileNode>>&& files);
+ULONGLONG GetPendingReclaimBytes();
+
 bool is_root_finished(const std::shared_ptr<Node>& node);
 bool is_drive(const WCHAR* path);
 bool is_subst(const WCHAR* path);
@@ -0,0 +1,69 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "displaylist.h"
+#include <stdio.h>
+
+void DisplayList::Clear()
+{
+    m_commands.clear();
+    m_layers.clear();
+}
+
+void DisplayList::BeginLayer(const float opacity)
+{
+    Layer layer;
+    layer.m_opacity = opacity;
+    layer.m_first = m_commands.size();
+    m_layers.emplace_back(layer);
+}
+
+void DisplayList::Replay(DisplayListBackend& backend) const
+{
+    for (size_t ii = 0; ii < m_layers.size(); ++ii)
+    {
+        const size_t end = (ii + 1 < m_layers.size()) ? m_layers[ii + 1].m_first : m_commands.size();
+
+        backend.BeginLayer(m_layers[ii].m_opacity);
+        for (size_t index = m_layers[ii].m_first; index < end; ++index)
+            backend.Draw(index, m_commands[index]);
+        backend.EndLayer();
+    }
+}
+
+void DisplayListRecorder::BeginLayer(const float opacity)
+{
+    char sz[64];
+    snprintf(sz, sizeof(sz), "layer %.2f\n", opacity);
+    m_text.append(sz);
+}
+
+void DisplayListRecorder::EndLayer()
+{
+    m_text.append("end\n");
+}
+
+void DisplayListRecorder::Draw(const size_t index, const DisplayCommand& command)
+{
+    static const char* const c_ops[] = { "sector", "circle", "spoke", "label", "indicator" };
+    const char* const op = (command.m_op < sizeof(c_ops) / sizeof(c_ops[0])) ? c_ops[command.m_op] : "?";
+
+    char sz[256];
+    snprintf(sz, sizeof(sz), "  #%zu %s depth=%u index=%u start=%.2f end=%.2f inner=%.2f outer=%.2f fill=%08x line=%08x stroke=%.2f",
+             index, op, unsigned(command.m_depth), unsigned(command.m_index),
+             command.m_start, command.m_end, command.m_inner, command.m_outer,
+             unsigned(command.m_fill), unsigned(command.m_line), command.m_stroke);
+    m_text.append(sz);
+
+    if (command.m_flags & DCF_FILE)
+        m_text.append(" file");
+    if (command.m_flags & DCF_ROOT)
+        m_text.append(" root");
+    if (command.m_flags & DCF_FREE)
+        m_text.append(" free");
+    if (command.m_flags & DCF_MOUNT_POINT)
+        m_text.append(" mountpoint");
+    if (command.m_flags & DCF_NAMES)
+        m_text.append(" names");
+    m_text.append("\n");
+}
@@ -0,0 +1,101 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+// Retained display list for sunburst charts.
+//
+// Layout emits a flat array of plain draw commands (sectors, circles, spokes,
+// labels, "more" indicators), and backends replay it.  Commands refer back to
+// the layout's arcs by ring depth and index, so a backend can look up names
+// or patch the colors of highlighted arcs without the list having to change.
+// DisplayListRecorder turns a replay into text, for inspecting a list.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+enum DisplayOp : uint8_t
+{
+    DOP_SECTOR,                             // Filled and outlined ring sector or pie slice.
+    DOP_CIRCLE,                             // Circle of radius m_outer; fill and/or outline.
+    DOP_SPOKE,                              // Line from the center out to m_outer, at m_start.
+    DOP_LABEL,                              // Name of the arc, along radius m_outer.
+    DOP_INDICATOR,                          // "More" indicator beyond the last ring.
+};
+
+enum DisplayFlags : uint8_t
+{
+    DCF_NONE                = 0x00,
+    DCF_FILE                = 0x01,
+    DCF_ROOT                = 0x02,         // m_index is an index into the roots.
+    DCF_FREE                = 0x04,         // Free space slice of a root.
+    DCF_MOUNT_POINT         = 0x08,
+    DCF_NAMES               = 0x10,         // The ring shows names.
+};
+
+struct DisplayCommand
+{
+    uint8_t                 m_op;
+    uint8_t                 m_flags;
+    uint16_t                m_depth;        // Ring depth, for arcs.
+    uint32_t                m_index;        // Arc index in its ring (or root index, with DCF_ROOT).
+    float                   m_start;        // Degrees, clockwise from the chart's rotation.
+    float                   m_end;
+    float                   m_inner;
+    float                   m_outer;
+    uint32_t                m_fill;         // 0xAARRGGBB, straight alpha.
+    uint32_t                m_line;
+    float                   m_stroke;
+};
+
+static_assert(std::is_trivially_copyable<DisplayCommand>::value, "DisplayCommand must stay plain data");
+
+class DisplayListBackend
+{
+public:
+    virtual                 ~DisplayListBackend() {}
+    virtual void            BeginLayer(float opacity) = 0;
+    virtual void            EndLayer() = 0;
+    virtual void            Draw(size_t index, const DisplayCommand& command) = 0;
+};
+
+class DisplayList
+{
+public:
+    void                    Clear();
+    void                    BeginLayer(float opacity);
+    void                    Add(const DisplayCommand& command) { m_commands.emplace_back(command); }
+
+    size_t                  Count() const { return m_commands.size(); }
+    const DisplayCommand&   operator[](size_t index) const { return m_commands[index]; }
+
+    void                    Replay(DisplayListBackend& backend) const;
+
+private:
+    struct Layer
+    {
+        float               m_opacity;
+        size_t              m_first;        // Index of the layer's first command.
+    };
+
+    std::vector<DisplayCommand> m_commands;
+    std::vector<Layer>      m_layers;
+};
+
+// Records a readable transcript of a replay, one line per layer or command.
+class DisplayListRecorder : public DisplayListBackend
+{
+public:
+    void                    BeginLayer(float opacity) override;
+    void                    EndLayer() override;
+    void                    Draw(size_t index, const DisplayCommand& command) override;
+
+    const std::string&      Text() const { return m_text; }
+    void                    Clear() { m_text.clear(); }
+
+private:
+    std::string             m_text;
+};
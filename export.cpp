@@ -0,0 +1,167 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "main.h"
+#include "export.h"
+#include <wincodec.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <algorithm>
+
+//----------------------------------------------------------------------------
+// PNG.
+
+bool WritePngFile(const WCHAR* file, const uint32_t* pixels, const UINT width, const UINT height, HRESULT* phr)
+{
+    SPI<IWICImagingFactory> spFactory;
+    SPI<IWICStream> spStream;
+    SPI<IWICBitmapEncoder> spEncoder;
+    SPI<IWICBitmapFrameEncode> spFrame;
+    WICPixelFormatGUID format = GUID_WICPixelFormat32bppBGRA;
+
+    HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&spFactory));
+    if (SUCCEEDED(hr))
+        hr = spFactory->CreateStream(&spStream);
+    if (SUCCEEDED(hr))
+        hr = spStream->InitializeFromFilename(file, GENERIC_WRITE);
+    if (SUCCEEDED(hr))
+        hr = spFactory->CreateEncoder(GUID_ContainerFormatPng, nullptr, &spEncoder);
+    if (SUCCEEDED(hr))
+        hr = spEncoder->Initialize(spStream, WICBitmapEncoderNoCache);
+    if (SUCCEEDED(hr))
+        hr = spEncoder->CreateNewFrame(&spFrame, nullptr);
+    if (SUCCEEDED(hr))
+        hr = spFrame->Initialize(nullptr);
+    if (SUCCEEDED(hr))
+        hr = spFrame->SetSize(width, height);
+    if (SUCCEEDED(hr))
+        hr = spFrame->SetPixelFormat(&format);
+    if (SUCCEEDED(hr) && format != GUID_WICPixelFormat32bppBGRA)
+        hr = WINCODEC_ERR_UNSUPPORTEDPIXELFORMAT;
+    if (SUCCEEDED(hr))
+        hr = spFrame->WritePixels(height, width * sizeof(*pixels), width * height * sizeof(*pixels), reinterpret_cast<BYTE*>(const_cast<uint32_t*>(pixels)));
+    if (SUCCEEDED(hr))
+        hr = spFrame->Commit();
+    if (SUCCEEDED(hr))
+        hr = spEncoder->Commit();
+
+    if (phr)
+        *phr = hr;
+    return SUCCEEDED(hr);
+}
+
+//----------------------------------------------------------------------------
+// StreamWriter.
+
+bool StreamWriter::Open(const WCHAR* file)
+{
+    Close();
+
+    m_error = 0;
+    m_file = CreateFile(file, GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL|FILE_FLAG_SEQUENTIAL_SCAN, 0);
+    if (m_file.IsEmpty())
+    {
+        m_error = GetLastError();
+        return false;
+    }
+    return true;
+}
+
+bool StreamWriter::Close()
+{
+    if (!m_file.IsEmpty())
+    {
+        Flush();
+        m_file.Close();
+    }
+    return !m_error;
+}
+
+void StreamWriter::Flush()
+{
+    if (m_used && !m_error && !m_file.IsEmpty())
+    {
+        DWORD written;
+        if (!WriteFile(m_file, m_buffer, DWORD(m_used), &written, nullptr))
+            m_error = GetLastError();
+        else if (written != m_used)
+            m_error = ERROR_DISK_FULL;
+    }
+    m_used = 0;
+}
+
+void StreamWriter::Write(const char* text)
+{
+    Write(text, strlen(text));
+}
+
+void StreamWriter::Write(const char* text, size_t len)
+{
+    while (len)
+    {
+        if (m_used == sizeof(m_buffer))
+            Flush();
+        const size_t chunk = std::min<size_t>(len, sizeof(m_buffer) - m_used);
+        memcpy(m_buffer + m_used, text, chunk);
+        m_used += chunk;
+        text += chunk;
+        len -= chunk;
+    }
+}
+
+void StreamWriter::Format(const char* format, ...)
+{
+    char sz[1024];
+    va_list args;
+    va_start(args, format);
+    const int len = _vsnprintf_s(sz, _countof(sz), _TRUNCATE, format, args);
+    va_end(args);
+    Write(sz, (len < 0) ? strlen(sz) : size_t(len));
+}
+
+void StreamWriter::WriteXmlText(const WCHAR* text)
+{
+    while (*text)
+    {
+        uint32_t ch = *(text++);
+        if (ch >= 0xd800 && ch <= 0xdbff && *text >= 0xdc00 && *text <= 0xdfff)
+            ch = 0x10000 + ((ch - 0xd800) << 10) + (*(text++) - 0xdc00);
+        else if (ch >= 0xd800 && ch <= 0xdfff)
+            ch = 0xfffd;
+
+        switch (ch)
+        {
+        case '&':   Write("&amp;"); continue;
+        case '<':   Write("&lt;"); continue;
+        case '>':   Write("&gt;"); continue;
+        case '"':   Write("&quot;"); continue;
+        case '\n':  Write("&#10;"); continue;
+        }
+
+        if (ch < 0x20)
+            continue;
+
+        if (ch < 0x80)
+        {
+            Put(char(ch));
+        }
+        else if (ch < 0x800)
+        {
+            Put(char(0xc0 | (ch >> 6)));
+            Put(char(0x80 | (ch & 0x3f)));
+        }
+        else if (ch < 0x10000)
+        {
+            Put(char(0xe0 | (ch >> 12)));
+            Put(char(0x80 | ((ch >> 6) & 0x3f)));
+            Put(char(0x80 | (ch & 0x3f)));
+        }
+        else
+        {
+            Put(char(0xf0 | (ch >> 18)));
+            Put(char(0x80 | ((ch >> 12) & 0x3f)));
+            Put(char(0x80 | ((ch >> 6) & 0x3f)));
+            Put(char(0x80 | (ch & 0x3f)));
+        }
+    }
+}
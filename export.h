@@ -0,0 +1,41 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <cstdint>
+
+// Pixels are 32 bit BGRA, top-down, with no padding between rows.
+bool WritePngFile(const WCHAR* file, const uint32_t* pixels, UINT width, UINT height, HRESULT* phr=nullptr);
+
+// Streams text to a file through a fixed size buffer, so that large
+// documents never need to be held in memory.  Write errors are sticky; check
+// Close() (or GetError()) once at the end instead of after every write.
+class StreamWriter
+{
+public:
+                            StreamWriter() = default;
+                            ~StreamWriter() { Close(); }
+
+    bool                    Open(const WCHAR* file);
+    bool                    Close();
+    DWORD                   GetError() const { return m_error; }
+
+    void                    Write(const char* text);
+    void                    Write(const char* text, size_t len);
+    void                    Format(_Printf_format_string_ const char* format, ...);
+    void                    WriteXmlText(const WCHAR* text);  // UTF-8, with XML escaping.
+
+private:
+    void                    Flush();
+    void                    Put(char ch) { if (m_used == sizeof(m_buffer)) Flush(); m_buffer[m_used++] = ch; }
+
+private:
+    SFileHandle             m_file;
+    DWORD                   m_error = 0;
+    size_t                  m_used = 0;
+    char                    m_buffer[64 * 1024];
+
+    StreamWriter(const StreamWriter&) = delete;
+    const StreamWriter& operator=(const StreamWriter&) = delete;
+};
@@ -7,17 +7,25 @@
 #include "ui.h"
 #include "sunburst.h"
 #include "DarkMode.h"
+#include "trace.h"
 #include <stdlib.h>
 #include <shellapi.h>
 
 static const WCHAR c_reg_root[] = TEXT("Software\\Elucidisk");
 
 bool g_use_compressed_size = false;
+bool g_use_size_on_disk = false;
+bool g_count_links_once = false;
+bool g_cross_mount_points = false;
 bool g_show_free_space = true;
 bool g_show_names = true;
 bool g_show_comparison_bar = true;
 bool g_show_proportional_area = true;
 bool g_show_dontscan_anyway = false;
+bool g_resume_scans = false;
+bool g_scan_disk_order = false;
+bool g_scan_low_priority = false;
+bool g_group_small_files = false;
 long g_color_mode = CM_RAINBOW;
 long g_syscolor_mode = SCM_AUTO;
 #ifdef DEBUG
@@ -41,7 +49,20 @@ int PASCAL WinMain(
         argv++;
     }
 
-    // Options (there are no options yet).
+    // Options.
+
+    // --trace=FILE records scan and paint phases, and writes them to FILE
+    // as Chrome trace_event JSON on exit.
+    std::wstring trace_file;
+    while (argc && !wcsncmp(argv[0], TEXT("--trace="), 8))
+    {
+        trace_file = argv[0] + 8;
+        argc--;
+        argv++;
+    }
+
+    if (!trace_file.empty())
+        EnableTracing();
 
     // FUTURE: An option to generate the .ico file programmatically using D2D.
 
@@ -59,11 +80,18 @@ int PASCAL WinMain(
     AllowDarkMode();
 
     g_use_compressed_size = !!ReadRegLong(TEXT("UseCompressedSize"), false);
+    g_use_size_on_disk = !!ReadRegLong(TEXT("UseSizeOnDisk"), false);
+    g_count_links_once = !!ReadRegLong(TEXT("CountHardLinksOnce"), false);
+    g_cross_mount_points = !!ReadRegLong(TEXT("CrossMountPoints"), false);
     g_show_free_space = !!ReadRegLong(TEXT("ShowFreeSpace"), true);
     g_show_names = !!ReadRegLong(TEXT("ShowNames"), true);
     g_show_comparison_bar = !!ReadRegLong(TEXT("ShowComparisonBar"), true);
     g_show_proportional_area = !!ReadRegLong(TEXT("ShowProportionalArea"), true);
     g_show_dontscan_anyway = !!ReadRegLong(TEXT("ShowDontScanAnyway"), false);
+    g_resume_scans = !!ReadRegLong(TEXT("ResumeInterruptedScans"), false);
+    g_scan_disk_order = !!ReadRegLong(TEXT("ScanInDiskOrder"), false);
+    g_scan_low_priority = !!ReadRegLong(TEXT("ScanAtLowPriority"), false);
+    g_group_small_files = !!ReadRegLong(TEXT("GroupSmallFiles"), false);
     g_color_mode = ReadRegLong(TEXT("ColorMode"), CM_RAINBOW);
     g_syscolor_mode = ReadRegLong(TEXT("SysColorMode"), SCM_AUTO);
 #ifdef DEBUG
@@ -87,6 +115,9 @@ int PASCAL WinMain(
 
     // Cleanup.
 
+    if (!trace_file.empty())
+        WriteTrace(trace_file.c_str());
+
     {
         MSG tmp;
         do {} while(PeekMessage(&tmp, 0, WM_QUIT, WM_QUIT, PM_REMOVE));
@@ -293,3 +324,14 @@ void FormatCount(const ULONGLONG count, std::wstring& text)
     text = commas;
 }
 
+LONGLONG GetMicroseconds()
+{
+    static LARGE_INTEGER s_freq = {};
+    if (!s_freq.QuadPart)
+        QueryPerformanceFrequency(&s_freq);
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart * 1000000 / s_freq.QuadPart;
+}
+
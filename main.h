@@ -18,11 +18,18 @@ bool ReadRegStrings(const WCHAR* name, std::vector<std::wstring>& out);
 void WriteRegStrings(const WCHAR* name, const std::vector<std::wstring>& in);
 
 extern bool g_use_compressed_size;
+extern bool g_use_size_on_disk;
+extern bool g_count_links_once;
+extern bool g_cross_mount_points;
 extern bool g_show_free_space;
 extern bool g_show_names;
 extern bool g_show_comparison_bar;
 extern bool g_show_proportional_area;
 extern bool g_show_dontscan_anyway;
+extern bool g_resume_scans;
+extern bool g_scan_disk_order;
+extern bool g_scan_low_priority;
+extern bool g_group_small_files;
 extern long g_color_mode;
 extern long g_syscolor_mode;
 enum ColorMode { CM_PLAIN, CM_RAINBOW, CM_HEATMAP };
@@ -39,6 +46,8 @@ UnitScale AutoUnitScale(ULONGLONG size);
 void FormatSize(ULONGLONG size, std::wstring& text, std::wstring& units, UnitScale scale=UnitScale::Auto, int places=-1);
 void FormatCount(ULONGLONG count, std::wstring& text);
 
+LONGLONG GetMicroseconds();
+
 //----------------------------------------------------------------------------
 // Smart pointer for AddRef/Release refcounting.
 
@@ -67,6 +67,7 @@ define_exe("elucidisk", "windowedapp")
     links("comctl32")
     links("d2d1")
     links("dwrite")
+    links("windowscodecs")
 
     includedirs(".build/vs2022/bin") -- for the generated manifest.xml
     files("*.cpp")
@@ -77,6 +78,19 @@ define_exe("elucidisk", "windowedapp")
         defines("_CRT_SECURE_NO_WARNINGS")
         defines("_CRT_NONSTDC_NO_WARNINGS")
 
+--------------------------------------------------------------------------------
+define_exe("tests")
+    targetname("elucidisk_tests")
+    includedirs(".")
+    files("tests/*.cpp")
+    files("workers.cpp")
+    files("arctext.cpp")
+    files("colorbatch.cpp")
+    files("displaylist.cpp")
+
+    filter "not system:windows"
+        links("pthread")
+
 
 
 --------------------------------------------------------------------------------
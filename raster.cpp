@@ -0,0 +1,374 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "raster.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define USE_SSE_RASTER
+#include <emmintrin.h>
+#endif
+
+static const float c_pi = 3.14159265358979f;
+static const float c_degrees_per_radian = 180.0f / c_pi;
+static const int c_band_rows = 32;
+
+//----------------------------------------------------------------------------
+// Polar coordinates.
+//
+// The angle is the screen angle in degrees, 0..360, clockwise from the
+// positive x axis (y grows downward).
+
+static void polar_row_scalar(const float dx, const float dy, const int count, float* radius, float* angle)
+{
+    for (int ii = 0; ii < count; ++ii)
+    {
+        const float x = dx + float(ii);
+        radius[ii] = std::sqrt(x * x + dy * dy);
+        float a = std::atan2(dy, x) * c_degrees_per_radian;
+        if (a < 0)
+            a += 360.0f;
+        angle[ii] = a;
+    }
+}
+
+#ifdef USE_SSE_RASTER
+
+static inline __m128 select_ps(const __m128 mask, const __m128 a, const __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128 abs_ps(const __m128 x)
+{
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+}
+
+// Polynomial atan2; the error is under 2e-6 radians, which is well under a
+// hundredth of a pixel even at the edge of a 4K chart.
+static inline __m128 atan2_ps(const __m128 y, const __m128 x)
+{
+    const __m128 ax = abs_ps(x);
+    const __m128 ay = abs_ps(y);
+    const __m128 hi = _mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(1e-30f));
+    const __m128 lo = _mm_min_ps(ax, ay);
+    const __m128 z = _mm_div_ps(lo, hi);
+    const __m128 s = _mm_mul_ps(z, z);
+
+    __m128 p = _mm_set1_ps(-0.01172120f);
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(0.05265332f));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(-0.11643287f));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(0.19354346f));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(-0.33262347f));
+    p = _mm_add_ps(_mm_mul_ps(p, s), _mm_set1_ps(0.99997726f));
+    __m128 a = _mm_mul_ps(p, z);
+
+    a = select_ps(_mm_cmpgt_ps(ay, ax), _mm_sub_ps(_mm_set1_ps(c_pi / 2), a), a);
+    a = select_ps(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(c_pi), a), a);
+    a = select_ps(_mm_cmplt_ps(y, _mm_setzero_ps()), _mm_sub_ps(_mm_setzero_ps(), a), a);
+    return a;
+}
+
+static void polar_row(const float dx, const float dy, const int count, float* radius, float* angle)
+{
+    const __m128 vy = _mm_set1_ps(dy);
+    const __m128 yy = _mm_mul_ps(vy, vy);
+    const __m128 step = _mm_set_ps(3, 2, 1, 0);
+    const __m128 to_degrees = _mm_set1_ps(c_degrees_per_radian);
+    const __m128 full = _mm_set1_ps(360.0f);
+    const __m128 zero = _mm_setzero_ps();
+
+    int ii = 0;
+    for (; ii + 4 <= count; ii += 4)
+    {
+        const __m128 vx = _mm_add_ps(_mm_set1_ps(dx + float(ii)), step);
+        _mm_storeu_ps(radius + ii, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vx, vx), yy)));
+
+        __m128 a = _mm_mul_ps(atan2_ps(vy, vx), to_degrees);
+        a = _mm_add_ps(a, _mm_and_ps(_mm_cmplt_ps(a, zero), full));
+        _mm_storeu_ps(angle + ii, a);
+    }
+
+    polar_row_scalar(dx + float(ii), dy, count - ii, radius + ii, angle + ii);
+}
+
+#else
+
+static void polar_row(const float dx, const float dy, const int count, float* radius, float* angle)
+{
+    polar_row_scalar(dx, dy, count, radius, angle);
+}
+
+#endif
+
+//----------------------------------------------------------------------------
+// Shading.
+
+static inline uint32_t blend(const uint32_t dst, const uint32_t src, const float coverage)
+{
+    const float alpha = float(src >> 24) / 255 * coverage;
+    if (alpha <= 0.0f)
+        return dst;
+
+    uint32_t out = 0xff000000;
+    for (int shift = 0; shift < 24; shift += 8)
+    {
+        const float d = float((dst >> shift) & 0xff);
+        const float s = float((src >> shift) & 0xff);
+        out |= uint32_t(d + (s - d) * alpha + 0.5f) << shift;
+    }
+    return out;
+}
+
+static inline float line_coverage(const float distance, const float stroke)
+{
+    return std::min(1.0f, std::max(0.0f, stroke / 2 + 0.5f - distance));
+}
+
+class Rasterizer
+{
+public:
+                            Rasterizer(const RasterScene& scene, uint32_t* pixels, int width, int height);
+    void                    RenderRows(int top, int bottom) const;
+
+private:
+    struct Line
+    {
+        uint32_t            color = 0;
+        float               coverage = 0;
+        void                Consider(uint32_t line, float stroke, float distance);
+    };
+
+    size_t                  FindRing(float radius) const;
+    const RasterArc*        FindArc(size_t ring, float angle, float& matched, size_t& index) const;
+    void                    ConsiderEdge(size_t ring, float angle, float distance, Line& line) const;
+    uint32_t                Shade(float radius, float angle) const;
+
+private:
+    const RasterScene&      m_scene;
+    uint32_t* const         m_pixels;
+    const int               m_width;
+    const int               m_height;
+    std::vector<std::vector<float>> m_starts; // Per ring, for binary search.
+    std::vector<size_t>     m_lut;          // Whole pixel radius -> first ring whose outer edge is beyond it.
+    float                   m_max_stroke = 0;
+    float                   m_extent = 0;   // Nothing is drawn beyond this radius.
+};
+
+void Rasterizer::Line::Consider(const uint32_t line, const float stroke, const float distance)
+{
+    const float cov = line_coverage(distance, stroke);
+    if (cov > coverage)
+    {
+        coverage = cov;
+        color = line;
+    }
+}
+
+Rasterizer::Rasterizer(const RasterScene& scene, uint32_t* pixels, const int width, const int height)
+: m_scene(scene)
+, m_pixels(pixels)
+, m_width(width)
+, m_height(height)
+{
+    m_starts.resize(scene.m_rings.size());
+    for (size_t ii = 0; ii < scene.m_rings.size(); ++ii)
+    {
+        const RasterRing& ring = scene.m_rings[ii];
+        m_starts[ii].reserve(ring.m_arcs.size());
+        for (const auto& arc : ring.m_arcs)
+        {
+            m_starts[ii].emplace_back(arc.m_start);
+            m_max_stroke = std::max(m_max_stroke, arc.m_stroke);
+        }
+        m_max_stroke = std::max(m_max_stroke, ring.m_outline_stroke);
+        m_extent = std::max(m_extent, ring.m_outer);
+    }
+    for (const auto& spoke : scene.m_spokes)
+        m_max_stroke = std::max(m_max_stroke, spoke.m_stroke);
+
+    m_extent += m_max_stroke / 2 + 1;
+
+    m_lut.resize(size_t(m_extent) + 2);
+    size_t ring = 0;
+    for (size_t r = 0; r < m_lut.size(); ++r)
+    {
+        while (ring < scene.m_rings.size() && scene.m_rings[ring].m_outer <= float(r))
+            ++ring;
+        m_lut[r] = ring;
+    }
+}
+
+size_t Rasterizer::FindRing(const float radius) const
+{
+    size_t ring = m_lut[std::min(size_t(radius), m_lut.size() - 1)];
+    while (ring < m_scene.m_rings.size() && m_scene.m_rings[ring].m_outer <= radius)
+        ++ring;
+    return ring;
+}
+
+const RasterArc* Rasterizer::FindArc(const size_t ring, const float angle, float& matched, size_t& index) const
+{
+    const std::vector<float>& starts = m_starts[ring];
+    const std::vector<RasterArc>& arcs = m_scene.m_rings[ring].m_arcs;
+
+    // Arcs can extend past 360 degrees, so also try the angle plus 360.
+    for (float a = angle; a < 720.0f; a += 360.0f)
+    {
+        const size_t upper = size_t(std::upper_bound(starts.begin(), starts.end(), a) - starts.begin());
+        if (a == angle)
+            index = upper;
+        if (upper && a < arcs[upper - 1].m_end)
+        {
+            matched = a;
+            index = upper - 1;
+            return &arcs[upper - 1];
+        }
+    }
+    return nullptr;
+}
+
+void Rasterizer::ConsiderEdge(const size_t ring, const float angle, const float distance, Line& line) const
+{
+    if (distance >= m_max_stroke / 2 + 0.5f)
+        return;
+
+    float matched;
+    size_t index;
+    const RasterArc* arc = FindArc(ring, angle, matched, index);
+    if (arc && arc->m_stroke > 0)
+        line.Consider(arc->m_line, arc->m_stroke, distance);
+}
+
+uint32_t Rasterizer::Shade(const float radius, float angle) const
+{
+    const std::vector<RasterRing>& rings = m_scene.m_rings;
+
+    angle -= m_scene.m_rotation;
+    if (angle < 0.0f)
+        angle += 360.0f;
+    else if (angle >= 360.0f)
+        angle -= 360.0f;
+
+    uint32_t color = m_scene.m_background;
+    Line line;
+
+    // Pixels per degree at this radius.
+    const float span_scale = radius / c_degrees_per_radian;
+
+    const size_t ring = FindRing(radius);
+    if (ring < rings.size() && radius >= rings[ring].m_inner)
+    {
+        const RasterRing& here = rings[ring];
+
+        float matched;
+        size_t index;
+        const RasterArc* arc = FindArc(ring, angle, matched, index);
+        if (arc)
+        {
+            color = blend(color, arc->m_fill, 1.0f);
+            if (arc->m_stroke > 0)
+            {
+                const float distance = std::min(std::min(radius - here.m_inner, here.m_outer - radius),
+                                                std::min(matched - arc->m_start, arc->m_end - matched) * span_scale);
+                line.Consider(arc->m_line, arc->m_stroke, distance);
+            }
+        }
+        else
+        {
+            // In a gap; the neighboring arcs' outlines can spill into it.
+            if (index < here.m_arcs.size() && here.m_arcs[index].m_stroke > 0)
+                line.Consider(here.m_arcs[index].m_line, here.m_arcs[index].m_stroke, (here.m_arcs[index].m_start - angle) * span_scale);
+            if (index > 0 && here.m_arcs[index - 1].m_stroke > 0)
+                line.Consider(here.m_arcs[index - 1].m_line, here.m_arcs[index - 1].m_stroke, (angle - here.m_arcs[index - 1].m_end) * span_scale);
+        }
+    }
+
+    // Outlines along the outer edge of the ring inside, and the inner edge
+    // of the ring outside, can spill across the boundary.
+    if (ring > 0)
+        ConsiderEdge(ring - 1, angle, radius - rings[ring - 1].m_outer, line);
+    if (ring < rings.size() && radius < rings[ring].m_inner)
+        ConsiderEdge(ring, angle, rings[ring].m_inner - radius, line);
+
+    // Whole circle outlines.
+    if (ring > 0 && rings[ring - 1].m_outline_stroke > 0)
+        line.Consider(rings[ring - 1].m_outline, rings[ring - 1].m_outline_stroke, radius - rings[ring - 1].m_outer);
+    if (ring < rings.size() && rings[ring].m_outline_stroke > 0)
+        line.Consider(rings[ring].m_outline, rings[ring].m_outline_stroke, rings[ring].m_outer - radius);
+
+    for (const auto& spoke : m_scene.m_spokes)
+    {
+        if (radius > spoke.m_radius)
+            continue;
+        float delta = std::fabs(angle - spoke.m_angle);
+        if (delta > 180.0f)
+            delta = 360.0f - delta;
+        if (delta < 90.0f)
+            line.Consider(spoke.m_line, spoke.m_stroke, radius * std::sin(delta / c_degrees_per_radian));
+    }
+
+    return blend(color, line.color, line.coverage);
+}
+
+void Rasterizer::RenderRows(const int top, const int bottom) const
+{
+    std::vector<float> radius(size_t(m_width) + 4);
+    std::vector<float> angle(size_t(m_width) + 4);
+
+    for (int y = top; y < bottom; ++y)
+    {
+        uint32_t* row = m_pixels + size_t(y) * size_t(m_width);
+        std::fill(row, row + m_width, m_scene.m_background);
+
+        const float dy = float(y) + 0.5f - m_scene.m_cy;
+        if (std::fabs(dy) >= m_extent)
+            continue;
+
+        // Only the pixels within the chart's extent need shading.
+        const float half = std::sqrt(m_extent * m_extent - dy * dy);
+        const int left = std::max(0, int(std::floor(m_scene.m_cx - half)));
+        const int right = std::min(m_width, int(std::ceil(m_scene.m_cx + half)) + 1);
+        if (left >= right)
+            continue;
+
+        const int count = right - left;
+        polar_row(float(left) + 0.5f - m_scene.m_cx, dy, count, radius.data(), angle.data());
+
+        for (int ii = 0; ii < count; ++ii)
+        {
+            if (radius[ii] < m_extent)
+                row[left + ii] = Shade(radius[ii], angle[ii]);
+        }
+    }
+}
+
+void RasterizeSunburst(const RasterScene& scene, uint32_t* pixels, const int width, const int height, unsigned threads)
+{
+    if (width <= 0 || height <= 0)
+        return;
+
+    const Rasterizer rasterizer(scene, pixels, width, height);
+
+    const int bands = (height + c_band_rows - 1) / c_band_rows;
+    if (!threads)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned>(threads, unsigned(bands));
+
+    std::atomic<int> next(0);
+    auto worker = [&]()
+    {
+        for (int band = next++; band < bands; band = next++)
+            rasterizer.RenderRows(band * c_band_rows, std::min(height, (band + 1) * c_band_rows));
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned ii = 1; ii < threads; ++ii)
+        pool.emplace_back(worker);
+    worker();
+    for (auto& thread : pool)
+        thread.join();
+}
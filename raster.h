@@ -0,0 +1,61 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+// Software rasterizer for sunburst charts.
+//
+// Exporting an image shouldn't depend on a window or a Direct2D device, so
+// this draws the same layout that BuildRings produces, entirely on the CPU.
+// Rather than tessellating arcs into polygons, it works in polar coordinates:
+// each pixel's radius and angle are computed a row at a time (four pixels at
+// once with SSE), the radius selects the ring, and a binary search over the
+// ring's sorted start angles selects the arc.  Coverage for antialiasing
+// comes from the pixel's distance to the arc's edges, so the cost per pixel
+// is independent of how many arcs there are.
+//
+// Rows are rendered in bands, optionally spread across several threads.
+//
+// Colors are 0xAARRGGBB with straight alpha; the output is opaque 32 bit
+// BGRA (0xAARRGGBB in little endian memory order).
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct RasterArc
+{
+    float                   m_start;        // Degrees, clockwise from m_rotation.
+    float                   m_end;
+    uint32_t                m_fill;
+    uint32_t                m_line;
+    float                   m_stroke;       // Outline width; 0 for none.
+};
+
+struct RasterRing
+{
+    float                   m_inner = 0;
+    float                   m_outer = 0;
+    uint32_t                m_outline = 0;  // Circle at m_outer.
+    float                   m_outline_stroke = 0; // 0 for none.
+    std::vector<RasterArc>  m_arcs;         // Sorted by m_start, not overlapping.
+};
+
+struct RasterSpoke
+{
+    float                   m_angle;        // Degrees, clockwise from m_rotation.
+    float                   m_radius;       // Drawn from the center out to here.
+    uint32_t                m_line;
+    float                   m_stroke;
+};
+
+struct RasterScene
+{
+    float                   m_cx = 0;
+    float                   m_cy = 0;
+    float                   m_rotation = 0; // Screen angle of chart angle 0, in degrees.
+    uint32_t                m_background = 0xffffffff;
+    std::vector<RasterRing> m_rings;        // Innermost first; the center pie is a ring with m_inner == 0.
+    std::vector<RasterSpoke> m_spokes;
+};
+
+void RasterizeSunburst(const RasterScene& scene, uint32_t* pixels, int width, int height, unsigned threads=1);
@@ -29,6 +29,8 @@
 #define IDM_SHOW_DIRECTORY      2005
 #define IDM_EMPTY_RECYCLEBIN    2006
 #define IDM_RESCAN              2007
+#define IDM_EXPORT_PNG          2008
+#define IDM_EXPORT_SVG          2009
 
 #define IDM_OPTION_COMPRESSED   2100
 #define IDM_OPTION_FREESPACE    2101
@@ -37,6 +39,13 @@
 #define IDM_OPTION_PROPORTION   2104
 #define IDM_OPTION_DONTSCAN     2105
 #define IDM_OPTION_SCANDONTSCAN 2106
+#define IDM_OPTION_RESUMESCANS  2107
+#define IDM_OPTION_SIZEONDISK   2108
+#define IDM_OPTION_LINKSONCE    2109
+#define IDM_OPTION_CROSSMOUNTS  2110
+#define IDM_OPTION_DISKORDER    2111
+#define IDM_OPTION_LOWPRIORITY  2112
+#define IDM_OPTION_GROUPSMALL   2113
 
 #define IDM_OPTION_AUTOCOLOR    2160
 #define IDM_OPTION_LIGHTMODE    2161
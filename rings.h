@@ -0,0 +1,167 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+// Building the rings of arcs for the sunburst chart.
+//
+// Each ring is built from the ring inside it:  every directory arc is
+// divided among the directory's subdirectories and files, in proportion to
+// their sizes.  The builder is a template over the node type, so that it
+// can be checked against synthetic trees; NodeT::AsDir() must return a
+// pointer to a directory with IsHidden(), IsFinished(), GetSize(),
+// CopyDirs(), and CopyFiles().
+
+#pragma once
+
+#include "workers.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <thread>
+#include <vector>
+
+template <class NodeT>
+struct RingArc
+{
+    float               m_start;
+    float               m_end;
+    std::shared_ptr<NodeT> m_node;
+    size_t              m_root = 0;     // Index into the roots.
+    bool                m_finished = false; // The node and its ancestors are finished (see is_root_finished).
+};
+
+inline float RingArcLength(float angle, float radius)
+{
+    return float(angle * radius * 3.14159265358979323846 / 180.0f);
+}
+
+// Adds an arc for node, covering size out of total within the parent's
+// span, unless it's shorter than min_arc.  Advances sweep either way.
+template <class NodeT>
+void MakeRingArc(std::vector<RingArc<NodeT>>& arcs, float outer_radius, const float min_arc, const std::shared_ptr<NodeT>& node, uint64_t size, double& sweep, double total, float start, float span, double convert=1.0f)
+{
+    const bool zero = (total == 0.0f);
+    RingArc<NodeT> arc;
+    arc.m_start = start + float(zero ? 0.0f : convert * sweep * span / total);
+    sweep += double(size);
+    arc.m_end = start + float(zero ? 0.0f : convert * sweep * span / total);
+
+#ifdef DEBUG
+    assert(arc.m_start <= 360.0f && arc.m_end <= 360.0f);
+    assert(arc.m_end - arc.m_start <= span);
+#endif
+
+    if (RingArcLength(arc.m_end - arc.m_start, outer_radius) >= min_arc)
+    {
+        arc.m_node = node;
+        arcs.emplace_back(std::move(arc));
+    }
+}
+
+template <class NodeT>
+void SetRingArcAncestry(std::vector<RingArc<NodeT>>& arcs, size_t first, size_t root, bool parent_finished)
+{
+    for (size_t ii = first; ii < arcs.size(); ++ii)
+    {
+        const auto* dir = arcs[ii].m_node->AsDir();
+        arcs[ii].m_root = root;
+        arcs[ii].m_finished = parent_finished && (!dir || dir->IsFinished());
+    }
+}
+
+// Appends the children of parent_ring[begin..end) to arcs.
+template <class NodeT>
+void AddChildArcs(const std::vector<RingArc<NodeT>>& parent_ring, const size_t begin, const size_t end, const float outer_radius, const float min_arc, std::vector<RingArc<NodeT>>& arcs)
+{
+    for (size_t ii = begin; ii < end; ++ii)
+    {
+        const RingArc<NodeT>& _parent = parent_ring[ii];
+        const auto* parent = _parent.m_node->AsDir();
+        if (parent && !parent->IsHidden())
+        {
+            double sweep = 0;
+
+            const auto dirs = parent->CopyDirs();
+            const auto files = parent->CopyFiles();
+
+#ifdef DEBUG
+            const size_t index = arcs.size();
+#endif
+
+            const float start = _parent.m_start;
+            const float span = _parent.m_end - _parent.m_start;
+            const size_t first = arcs.size();
+
+            const double range = double(parent->GetSize());
+            for (const auto& dir : dirs)
+                MakeRingArc<NodeT>(arcs, outer_radius, min_arc, std::static_pointer_cast<NodeT>(dir), dir->GetSize(), sweep, range, start, span);
+            for (const auto& file : files)
+                MakeRingArc<NodeT>(arcs, outer_radius, min_arc, std::static_pointer_cast<NodeT>(file), file->GetSize(), sweep, range, start, span);
+
+            SetRingArcAncestry(arcs, first, _parent.m_root, _parent.m_finished);
+
+#ifdef DEBUG
+            if (arcs.size() > index)
+            {
+                assert(arcs[index].m_start >= _parent.m_start);
+                assert(arcs.back().m_end <= _parent.m_end + 0.001f);
+            }
+#endif
+        }
+    }
+}
+
+// Each parent's children depend only on the parent, so a wide ring is built
+// in chunks of parents on the WorkerPool.  Concatenating the chunks in order
+// produces exactly the same ring as building it sequentially, so the arcs
+// stay sorted by angle for hit testing.
+//
+// Threads 0 means one per processor; 1 builds sequentially.
+const size_t c_ring_chunk_parents = 1024;
+const size_t c_parallel_ring_parents = 4 * c_ring_chunk_parents;
+
+template <class NodeT>
+std::vector<RingArc<NodeT>> NextRing(const std::vector<RingArc<NodeT>>& parent_ring, const float outer_radius, const float min_arc, unsigned threads)
+{
+    std::vector<RingArc<NodeT>> arcs;
+
+    const size_t chunks = (parent_ring.size() + c_ring_chunk_parents - 1) / c_ring_chunk_parents;
+    if (parent_ring.size() < c_parallel_ring_parents)
+        threads = 1;
+    else if (!threads)
+        threads = std::max<unsigned>(1, std::thread::hardware_concurrency());
+    threads = std::min<unsigned>(threads, unsigned(chunks));
+
+    if (threads > 1)
+    {
+        std::vector<std::vector<RingArc<NodeT>>> outputs(chunks);
+        std::atomic<size_t> next(0);
+        const std::function<void()> worker = [&]()
+        {
+            for (size_t chunk = next++; chunk < chunks; chunk = next++)
+            {
+                const size_t begin = chunk * c_ring_chunk_parents;
+                const size_t end = std::min<size_t>(parent_ring.size(), begin + c_ring_chunk_parents);
+                AddChildArcs(parent_ring, begin, end, outer_radius, min_arc, outputs[chunk]);
+            }
+        };
+
+        // When another layout has the pool, this one builds sequentially.
+        if (WorkerPool::Get().TryRun(threads, worker))
+        {
+            size_t count = 0;
+            for (const auto& output : outputs)
+                count += output.size();
+
+            arcs.reserve(count);
+            for (auto& output : outputs)
+                arcs.insert(arcs.end(), std::make_move_iterator(output.begin()), std::make_move_iterator(output.end()));
+            return arcs;
+        }
+    }
+
+    AddChildArcs(parent_ring, 0, parent_ring.size(), outer_radius, min_arc, arcs);
+    return arcs;
+}
@@ -4,7 +4,15 @@
 #include "main.h"
 #include "data.h"
 #include "scan.h"
+#include "checkpoint.h"
+#include "trace.h"
 #include <shellapi.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <thread>
+#include <unordered_set>
 
 static void get_drive(const WCHAR* path, std::wstring& out)
 {
@@ -213,85 +221,1124 @@ static void FakeScan(const std::shared_ptr<DirNode> root, size_t index, bool inc
 }
 #endif
 
-void Scan(const std::shared_ptr<DirNode>& root, const LONG this_generation, volatile LONG* current_generation, ScanContext& context)
+static bool is_dontscan(const std::wstring& path, const ScanContext& context)
+{
+    for (const auto& ignore : context.dontscan)
+    {
+        if (!wcsicmp(ignore.c_str(), path.c_str()))
+            return true;
+    }
+    return false;
+}
+
+static bool has_dontscan_under(const std::wstring& path, const ScanContext& context)
+{
+    for (const auto& ignore : context.dontscan)
+    {
+        if (ignore.length() > path.length() && !wcsnicmp(ignore.c_str(), path.c_str(), path.length()))
+            return true;
+    }
+    return false;
+}
+
+//----------------------------------------------------------------------------
+// DirEnumerator.
+//
+// Enumerates with FileIdBothDirectoryInfo where the file system supports it,
+// which also returns the allocation size and file ID of each entry without
+// any extra calls per file.  Otherwise it falls back to FindFirstFile.
+//
+// A directory's change token for the checkpoint is its last write time, read
+// from the directory itself when it's opened, before any entries are read.
+// So a change made during the enumeration makes the token stale.
+
+struct ScanEntry
+{
+    std::wstring            name;
+    DWORD                   attributes = 0;
+    DWORD                   reparse_tag = 0;
+    ULONGLONG               size = 0;
+    ULONGLONG               allocated = 0;
+    ULONGLONG               file_id = 0;
+    bool                    has_allocated = false;
+    bool                    has_file_id = false;
+};
+
+class DirEnumerator
+{
+public:
+    bool                    Open(const std::wstring& dir);
+    bool                    Next(ScanEntry& entry);
+    bool                    NeedsRead() const { return !m_hDir.IsEmpty() && !m_have_buffer; }
+    ULONGLONG               GetToken() const { return m_token; }
+
+private:
+    SFileHandle             m_hDir;
+    ULONGLONG               m_token = 0;
+    std::vector<BYTE>       m_buffer;
+    size_t                  m_offset = 0;
+    bool                    m_have_buffer = false;
+
+    SFindHandle             m_hFind;
+    WIN32_FIND_DATA         m_fd;
+    bool                    m_have_fd = false;
+};
+
+constexpr size_t c_enum_buffer_size = 64 * 1024;
+
+static ULONGLONG get_dir_token(HANDLE h)
+{
+    FILE_BASIC_INFO info;
+    if (!GetFileInformationByHandleEx(h, FileBasicInfo, &info, sizeof(info)))
+        return 0;
+    return ULONGLONG(info.LastWriteTime.QuadPart);
+}
+
+static ULONGLONG get_dir_token(const std::wstring& dir)
+{
+    SFileHandle h = CreateFile(dir.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (h.IsEmpty())
+        return 0;
+    return get_dir_token(h);
+}
+
+bool DirEnumerator::Open(const std::wstring& dir)
+{
+    assert(dir.length() && is_separator(dir.c_str()[dir.length() - 1]));
+
+    m_hDir = CreateFile(dir.c_str(), FILE_LIST_DIRECTORY|FILE_READ_ATTRIBUTES, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (!m_hDir.IsEmpty())
+    {
+        m_token = get_dir_token(m_hDir);
+        m_buffer.resize(c_enum_buffer_size);
+        if (GetFileInformationByHandleEx(m_hDir, FileIdBothDirectoryRestartInfo, m_buffer.data(), DWORD(m_buffer.size())))
+        {
+            m_have_buffer = true;
+            return true;
+        }
+        if (GetLastError() == ERROR_NO_MORE_FILES)
+            return true;
+
+        // The file system doesn't support it; fall back to FindFirstFile.
+        m_hDir.Close();
+    }
+    else
+    {
+        m_token = get_dir_token(dir);
+    }
+
+    std::wstring find(dir);
+    find.append(TEXT("*"));
+    m_hFind = FindFirstFile(find.c_str(), &m_fd);
+    m_have_fd = !m_hFind.IsEmpty();
+    return m_have_fd;
+}
+
+bool DirEnumerator::Next(ScanEntry& entry)
+{
+    if (!m_hDir.IsEmpty())
+    {
+        if (!m_have_buffer)
+        {
+            if (!GetFileInformationByHandleEx(m_hDir, FileIdBothDirectoryInfo, m_buffer.data(), DWORD(m_buffer.size())))
+                return false;
+            m_offset = 0;
+            m_have_buffer = true;
+        }
+
+        const FILE_ID_BOTH_DIR_INFO* info = reinterpret_cast<const FILE_ID_BOTH_DIR_INFO*>(m_buffer.data() + m_offset);
+        if (info->NextEntryOffset)
+            m_offset += info->NextEntryOffset;
+        else
+            m_have_buffer = false;
+
+        entry.name.assign(info->FileName, info->FileNameLength / sizeof(*info->FileName));
+        entry.attributes = info->FileAttributes;
+        entry.reparse_tag = (info->FileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) ? info->EaSize : 0;
+        entry.size = info->EndOfFile.QuadPart;
+        entry.allocated = info->AllocationSize.QuadPart;
+        entry.file_id = info->FileId.QuadPart;
+        entry.has_allocated = true;
+        entry.has_file_id = true;
+        return true;
+    }
+
+    if (m_hFind.IsEmpty())
+        return false;
+    if (!m_have_fd && !FindNextFile(m_hFind, &m_fd))
+        return false;
+    m_have_fd = false;
+
+    ULARGE_INTEGER uli;
+    uli.HighPart = m_fd.nFileSizeHigh;
+    uli.LowPart = m_fd.nFileSizeLow;
+
+    entry.name = m_fd.cFileName;
+    entry.attributes = m_fd.dwFileAttributes;
+    entry.reparse_tag = (m_fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) ? m_fd.dwReserved0 : 0;
+    entry.size = uli.QuadPart;
+    entry.allocated = 0;
+    entry.file_id = 0;
+    entry.has_allocated = false;
+    entry.has_file_id = false;
+    return true;
+}
+
+//----------------------------------------------------------------------------
+
+static bool get_mount_volume(const WCHAR* path, std::wstring& volume)
+{
+    // Fails for junctions, so only true volume mount points succeed.
+    WCHAR sz[MAX_PATH];
+    if (!GetVolumeNameForVolumeMountPoint(path, sz, _countof(sz)))
+        return false;
+
+    volume = sz;
+    return true;
+}
+
+// The caller adds the free space after releasing the context mutex, since
+// querying the volume can be slow.
+static std::shared_ptr<MountPointNode> add_mount_point(const std::shared_ptr<DirNode>& root, const WCHAR* name, const std::wstring& path, ScanContext& context)
+{
+    // Each volume is only scanned once per root, which avoids double
+    // counting volumes mounted more than once (or inside themselves).
+    std::wstring volume;
+    if (!get_mount_volume(path.c_str(), volume) || !context.volumes.insert(volume).second)
+        return nullptr;
+
+    std::shared_ptr<MountPointNode> mount = root->AddMountPoint(name, volume.c_str());
+    context.mounts.emplace_back(mount);
+    return mount;
+}
+
+// On NTFS the low 48 bits of a file ID are the MFT record number, and the
+// high 16 bits are a sequence number.
+constexpr ULONGLONG c_file_record_mask = 0x0000ffffffffffff;
+
+static ULONGLONG get_file_size(const ScanEntry& fd, const bool compressed, const bool size_on_disk, std::wstring& path, const size_t base_path_len)
+{
+    // The allocation size in an NTFS directory entry isn't kept up to date
+    // for compressed and sparse files, so ask the file system for those.
+    ULARGE_INTEGER uli;
+    if (compressed || (fd.attributes & FILE_ATTRIBUTE_SPARSE_FILE))
+    {
+        path.resize(base_path_len);
+        path.append(fd.name.c_str());
+        uli.LowPart = GetCompressedFileSize(path.c_str(), &uli.HighPart);
+    }
+    else if (size_on_disk && fd.has_allocated)
+    {
+        uli.QuadPart = fd.allocated;
+    }
+    else
+    {
+        uli.QuadPart = fd.size;
+    }
+    return uli.QuadPart;
+}
+
+// Layout of FILE_STAT_INFORMATION, for GetFileInformationByName with
+// FileStatByNameInfo (0).  Older SDKs don't declare either.
+struct StatByName
+{
+    LARGE_INTEGER           file_id;
+    LARGE_INTEGER           creation_time;
+    LARGE_INTEGER           last_access_time;
+    LARGE_INTEGER           last_write_time;
+    LARGE_INTEGER           change_time;
+    LARGE_INTEGER           allocation_size;
+    LARGE_INTEGER           end_of_file;
+    ULONG                   attributes;
+    ULONG                   reparse_tag;
+    ULONG                   links;
+    ACCESS_MASK             effective_access;
+};
+
+typedef BOOL (WINAPI* GetFileInformationByName_t)(PCWSTR name, int info_class, PVOID buffer, ULONG size);
+
+static GetFileInformationByName_t get_file_info_by_name()
+{
+    // Windows 11 24H2 and newer can query a file by name without opening it.
+    static const GetFileInformationByName_t s_func = []()
+    {
+        FARPROC proc = GetProcAddress(GetModuleHandle(TEXT("kernel32.dll")), "GetFileInformationByName");
+        if (!proc)
+        {
+            HMODULE hKernelBase = GetModuleHandle(TEXT("kernelbase.dll"));
+            if (hKernelBase)
+                proc = GetProcAddress(hKernelBase, "GetFileInformationByName");
+        }
+        return reinterpret_cast<GetFileInformationByName_t>(proc);
+    }();
+    return s_func;
+}
+
+// Returns the number of hard links to a file, or 1 if it can't be queried.
+// Directory entries don't include the link count, so this asks for it by
+// name where the OS and file system can, and otherwise opens the file.
+// Call it without holding the context mutex.
+static DWORD get_link_count(const ScanEntry& fd, std::wstring& path, const size_t base_path_len)
+{
+    path.resize(base_path_len);
+    path.append(fd.name.c_str());
+
+    const GetFileInformationByName_t func = get_file_info_by_name();
+    if (func)
+    {
+        StatByName stat;
+        if (func(path.c_str(), 0/*FileStatByNameInfo*/, &stat, sizeof(stat)))
+            return stat.links;
+    }
+
+    SFileHandle h = CreateFile(path.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_OPEN_REPARSE_POINT, nullptr);
+    if (h.IsEmpty())
+        return 1;
+
+    FILE_STANDARD_INFO info;
+    if (!GetFileInformationByHandleEx(h, FileStandardInfo, &info, sizeof(info)))
+        return 1;
+    return info.NumberOfLinks;
+}
+
+// Directories with many files get their smallest files grouped, when that
+// is enabled.  The threshold is relative to the directory's own files, so
+// the grouped files are too small to get arcs even when zoomed into the
+// directory.
+constexpr ULONGLONG c_group_min_files = 1000;
+constexpr ULONGLONG c_group_divisor = 1000;
+
+static void group_small_files(const std::shared_ptr<DirNode>& dir, const ULONGLONG count, const ULONGLONG total)
+{
+    if (count >= c_group_min_files)
+        dir->CollapseFiles(total / c_group_divisor);
+}
+
+// Once a directory has enough files, later small files go straight into the
+// group instead of getting nodes that group_small_files() would collapse
+// anyway.  The threshold only rises as more files are seen, so the final
+// group_small_files() still catches the earlier files.
+static bool group_early(const bool group, const ULONGLONG count, const ULONGLONG total, const ULONGLONG size)
+{
+    return group && count >= c_group_min_files && size < total / c_group_divisor;
+}
+
+//----------------------------------------------------------------------------
+// CheckpointSource.
+//
+// A finished subtree restored from a checkpoint becomes a stub, unless it
+// contains mount points (which need to be registered as they're found).
+// Browsing into a stub reads its listing from the checkpoint's snapshot, and
+// its subdirectories become stubs in turn.  The source only holds the
+// snapshot, so stubs don't keep the checkpoint or its index alive.
+
+class CheckpointSource : public DirSource, public std::enable_shared_from_this<CheckpointSource>
+{
+public:
+                            CheckpointSource(const std::shared_ptr<CheckpointSnapshot>& snapshot, bool group_small_files);
+    std::unique_ptr<Listing> ReadChildren(ULONGLONG key) override;
+    void                    AddChildren(const std::shared_ptr<DirNode>& dir, const Listing& listing) override;
+    std::shared_ptr<DirNode> AddStub(const std::shared_ptr<DirNode>& parent, const WCHAR* name, BYTE flags, ULONGLONG snapshot, const CheckpointTotals& totals);
+
+private:
+    struct SnapshotListing : public Listing
+    {
+        std::vector<CheckpointEntry> entries;
+    };
+
+    const std::shared_ptr<CheckpointSnapshot> m_snapshot;
+    const bool              m_group_small_files;
+};
+
+CheckpointSource::CheckpointSource(const std::shared_ptr<CheckpointSnapshot>& snapshot, const bool group_small_files)
+: m_snapshot(snapshot)
+, m_group_small_files(group_small_files)
+{
+}
+
+std::unique_ptr<DirSource::Listing> CheckpointSource::ReadChildren(const ULONGLONG key)
+{
+    std::unique_ptr<SnapshotListing> listing = std::make_unique<SnapshotListing>();
+    if (!m_snapshot->ReadListing(key, listing->entries))
+        return nullptr;
+    return listing;
+}
+
+void CheckpointSource::AddChildren(const std::shared_ptr<DirNode>& dir, const Listing& listing)
+{
+    ULONGLONG files_count = 0;
+    ULONGLONG files_total = 0;
+    for (const auto& entry : static_cast<const SnapshotListing&>(listing).entries)
+    {
+        if (entry.m_dir)
+        {
+            AddStub(dir, entry.m_name.c_str(), entry.m_flags, entry.m_snapshot, entry.m_subtree);
+        }
+        else
+        {
+            if (group_early(m_group_small_files, files_count, files_total, entry.m_size))
+            {
+                dir->AddToAggregate(entry.m_size);
+            }
+            else
+            {
+                std::shared_ptr<FileNode> file = dir->AddFile(entry.m_name.c_str(), entry.m_size);
+                if (entry.m_flags & CPF_COMPRESSED)
+                    file->SetCompressed();
+                if (entry.m_flags & CPF_SPARSE)
+                    file->SetSparse();
+            }
+
+            files_count++;
+            files_total += entry.m_size;
+        }
+    }
+
+    if (m_group_small_files)
+        group_small_files(dir, files_count, files_total);
+}
+
+std::shared_ptr<DirNode> CheckpointSource::AddStub(const std::shared_ptr<DirNode>& parent, const WCHAR* name, const BYTE flags, const ULONGLONG snapshot, const CheckpointTotals& totals)
 {
+    std::shared_ptr<DirNode> dir = parent->AddStubDir(name, totals.m_size, totals.m_count_dirs, totals.m_count_files, shared_from_this(), snapshot);
+    if (flags & CPF_COMPRESSED)
+        dir->SetCompressed();
+    return dir;
+}
+
+//----------------------------------------------------------------------------
+// Concurrency controller.
+//
+// The best number of concurrent directory reads depends on the device.  An
+// SSD or a network share keeps getting faster with more reads in flight,
+// while a single spinning disk gets slower as its heads thrash.  So each
+// pool samples its throughput and read latency, and tunes its concurrency
+// with an AIMD controller:  it adds a thread while throughput rises, gives
+// one back when throughput falls, and halves when latency balloons.  The
+// concurrency each volume settles on is the starting point for its next
+// scan.
+
+constexpr unsigned c_min_scan_threads = 1;
+constexpr unsigned c_max_scan_threads = 16;
+constexpr unsigned c_initial_scan_threads = 4;
+constexpr DWORD c_sample_interval = 250;    // Milliseconds.
+
+static std::mutex s_telemetry_mutex;        // Never held while acquiring another lock.
+static std::map<std::wstring, ScanTelemetry> s_telemetry;
+
+void GetScanTelemetry(std::vector<ScanTelemetry>& out)
+{
+    std::lock_guard<std::mutex> lock(s_telemetry_mutex);
+
+    out.clear();
+    for (const auto& it : s_telemetry)
+        out.emplace_back(it.second);
+}
+
+//----------------------------------------------------------------------------
+// Resource governor.
+//
+// A token bucket caps directory reads per second across all scans, so that a
+// scan can't crowd out a busy server's own I/O.  Opening a directory costs a
+// token, and so does each further page of entries read from a large one.
+// The bucket holds up to one second of tokens.  Callers reserve a token even
+// when the bucket is empty, and wait out the deficit.
+//
+// Memory has only a soft limit.  Past it, small files are collapsed into
+// aggregate nodes, which slows the growth of the tree; directories and larger
+// files still get nodes, so the limit can be exceeded.
+
+static std::mutex s_bucket_mutex;
+static double s_bucket_tokens = 0;
+static LONGLONG s_bucket_stamp = 0;
+
+static LONGLONG take_token(const unsigned rate)
+{
+    std::lock_guard<std::mutex> lock(s_bucket_mutex);
+
+    const LONGLONG now = GetMicroseconds();
+    if (!s_bucket_stamp)
+        s_bucket_tokens = rate;
+    else
+        s_bucket_tokens = std::min<double>(rate, s_bucket_tokens + double(now - s_bucket_stamp) * rate / 1000000);
+    s_bucket_stamp = now;
+
+    s_bucket_tokens -= 1;
+    if (s_bucket_tokens >= 0)
+        return 0;
+
+    // Microseconds to wait.
+    return LONGLONG(-s_bucket_tokens * 1000000 / rate);
+}
+
+//----------------------------------------------------------------------------
+// ScanPool.
+//
+// Directories are enumerated by a pool of threads, so that several directory
+// reads are in flight at once.  Each directory is a job.  A job holds a count
+// of its unfinished children, and its directory is finished once the count
+// drops to zero.  The queue is LIFO so the scan stays mostly depth first,
+// which bounds the number of queued jobs the same way recursion did.
+
+struct ScanJob
+{
+    std::shared_ptr<DirNode> dir;
+    std::shared_ptr<ScanJob> parent;
+    volatile LONG           pending = 1;    // The job itself, plus its unfinished children.
+    std::wstring            path;           // Full path with trailing separator, carried down from the parent.
+    std::wstring            relative;       // For the checkpoint.
+    bool                    recorded = false;
+};
+
+// The outcome of revalidating a finished subtree from the checkpoint against
+// the disk.  Keys are paths relative to the checkpoint root.
+struct RestoreCheck
+{
+    void                    MarkChanged(const std::wstring& relative);
+
+    std::unordered_set<std::wstring> changed;   // Directories to rescan.
+    std::unordered_set<std::wstring> stale;     // Ancestors of changed directories; never stubs.
+};
+
+void RestoreCheck::MarkChanged(const std::wstring& relative)
+{
+    changed.insert(relative);
+
+    // Relative paths end with a separator, which isn't a prefix boundary.
+    for (size_t len = relative.length(); len-- > 1;)
+    {
+        if (is_separator(relative[len - 1]) && !stale.insert(relative.substr(0, len)).second)
+            break;
+    }
+}
+
+class ScanPool
+{
+public:
+                            ScanPool(const WCHAR* volume, LONG this_generation, volatile LONG* current_generation, ScanContext& context);
+    void                    Run(const std::shared_ptr<DirNode>& root);
+
+protected:
+    std::shared_ptr<ScanJob> MakeJob(const std::shared_ptr<DirNode>& dir, const std::wstring& path, const std::shared_ptr<ScanJob>& parent);
+    void                    Enqueue(const std::shared_ptr<DirNode>& dir, const std::wstring& path, const std::shared_ptr<ScanJob>& parent);
+    void                    Release(std::shared_ptr<ScanJob> job);
+    void                    Adjust();
+    void                    ScanDir(const std::shared_ptr<ScanJob>& job);
+    void                    RestoreListing(const std::shared_ptr<ScanJob>& job, const std::wstring& path, const CheckpointListing& listing, const RestoreCheck& check);
+    bool                    RestoreFromCheckpoint(const std::shared_ptr<DirNode>& dir, const std::wstring& path, const std::shared_ptr<ScanJob>& parent);
+    bool                    ValidateSubtree(const std::wstring& path, const std::wstring& relative, const CheckpointListing& listing, RestoreCheck& check);
+    bool                    IsCancelled() const { return m_this_generation != *m_current_generation; }
+    void                    Throttle() const;
+    bool                    ShouldCollapse(ULONGLONG size) const;
+    static void             WorkerProc(ScanPool* pThis);
+
+private:
+    const std::wstring      m_volume;
+    const LONG              m_this_generation;
+    volatile LONG* const    m_current_generation;
+    ScanContext&            m_context;
+    std::shared_ptr<CheckpointSource> m_source;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_work_cv;      // Jobs queued, or a thread freed up.
+    std::condition_variable m_done_cv;
+    std::vector<std::shared_ptr<ScanJob>> m_queue;
+    unsigned                m_limit = c_initial_scan_threads;
+    unsigned                m_active = 0;
+    bool                    m_done = false;
+
+    // Samples for the controller.
+    volatile LONGLONG       m_entries = 0;
+    volatile LONGLONG       m_reads = 0;
+    volatile LONGLONG       m_read_us = 0;
+    ULONGLONG               m_last_rate = 0;
+    ULONGLONG               m_base_latency = 0;
+    int                     m_last_step = 0;
+};
+
+ScanPool::ScanPool(const WCHAR* volume, const LONG this_generation, volatile LONG* current_generation, ScanContext& context)
+: m_volume(volume)
+, m_this_generation(this_generation)
+, m_current_generation(current_generation)
+, m_context(context)
+{
+    if (context.checkpoint && context.checkpoint->GetSnapshot())
+        m_source = std::make_shared<CheckpointSource>(context.checkpoint->GetSnapshot(), context.group_small_files);
+}
+
+void ScanPool::Run(const std::shared_ptr<DirNode>& root)
+{
+    {
+        std::lock_guard<std::mutex> lock(s_telemetry_mutex);
+
+        ScanTelemetry& telemetry = s_telemetry[m_volume];
+        if (telemetry.threads)
+            m_limit = telemetry.threads;
+        telemetry.volume = m_volume;
+        telemetry.threads = m_limit;
+        telemetry.reason = TEXT("starting");
+        telemetry.active = true;
+    }
+
+    Enqueue(root, std::wstring(), nullptr);
+
+    // The calling thread runs the controller.  Worker threads are added as
+    // the limit rises; surplus workers just wait while the limit is lower.
+    std::vector<std::thread> threads;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            while (threads.size() < m_limit)
+                threads.emplace_back(WorkerProc, this);
+
+            if (m_done_cv.wait_for(lock, std::chrono::milliseconds(c_sample_interval), [this](){ return m_done; }))
+                break;
+
+            Adjust();
+        }
+    }
+
+    for (auto& thread : threads)
+        thread.join();
+
+    std::lock_guard<std::mutex> lock(s_telemetry_mutex);
+    s_telemetry[m_volume].active = false;
+}
+
+void ScanPool::Adjust()
+{
+    // Called with m_mutex held.
+    const LONGLONG entries = InterlockedExchange64(&m_entries, 0);
+    const LONGLONG reads = InterlockedExchange64(&m_reads, 0);
+    const LONGLONG read_us = InterlockedExchange64(&m_read_us, 0);
+
+    const ULONGLONG rate = ULONGLONG(entries) * 1000 / c_sample_interval;
+    const ULONGLONG latency = reads ? ULONGLONG(read_us / reads) : 0;
+    const bool saturated = (m_active + m_queue.size() >= m_limit);
+    const unsigned old_limit = m_limit;
+
+    const WCHAR* reason;
+    if (!reads)
+    {
+        reason = TEXT("idle");
+    }
+    else if (!saturated)
+    {
+        // Too few directories are queued to tell whether more threads would
+        // help, so leave the limit alone.
+        reason = TEXT("waiting for work");
+    }
+    else if (m_base_latency && latency > m_base_latency * 4 && m_limit > c_min_scan_threads)
+    {
+        m_limit = std::max(c_min_scan_threads, m_limit / 2);
+        reason = TEXT("latency rising");
+    }
+    else if (rate > m_last_rate + m_last_rate / 20)
+    {
+        if (m_limit < c_max_scan_threads)
+            ++m_limit;
+        reason = TEXT("throughput rising");
+    }
+    else if (m_last_step > 0 && rate + rate / 20 < m_last_rate)
+    {
+        --m_limit;
+        reason = TEXT("throughput falling");
+    }
+    else
+    {
+        reason = TEXT("steady");
+    }
+
+    if (reads && (!m_base_latency || latency < m_base_latency))
+        m_base_latency = latency;
+    if (reads && saturated)
+        m_last_rate = rate;
+    m_last_step = int(m_limit) - int(old_limit);
+
+    if (m_limit > old_limit)
+        m_work_cv.notify_all();
+
+    std::lock_guard<std::mutex> lock(s_telemetry_mutex);
+
+    TRACE_COUNTER("scan threads", m_limit);
+    TRACE_COUNTER("scan entries/sec", rate);
+    TRACE_COUNTER("scan read latency us", latency);
+
+    ScanTelemetry& telemetry = s_telemetry[m_volume];
+    telemetry.threads = m_limit;
+    telemetry.entries_per_sec = rate;
+    telemetry.latency_us = latency;
+    telemetry.reason = reason;
+}
+
+std::shared_ptr<ScanJob> ScanPool::MakeJob(const std::shared_ptr<DirNode>& dir, const std::wstring& path, const std::shared_ptr<ScanJob>& parent)
+{
+    std::shared_ptr<ScanJob> job = std::make_shared<ScanJob>();
+    job->dir = dir;
+    job->path = path;
+    job->parent = parent;
+    if (parent)
+        InterlockedIncrement(&parent->pending);
+    return job;
+}
+
+void ScanPool::Enqueue(const std::shared_ptr<DirNode>& dir, const std::wstring& path, const std::shared_ptr<ScanJob>& parent)
+{
+    std::shared_ptr<ScanJob> job = MakeJob(dir, path, parent);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_queue.emplace_back(std::move(job));
+    m_work_cv.notify_one();
+}
+
+void ScanPool::Release(std::shared_ptr<ScanJob> job)
+{
+    // Finishing a directory can finish its ancestors in turn.
+    while (job && !InterlockedDecrement(&job->pending))
+    {
+        // Directories are finished even when cancelled, same as always.
+        if (job->recorded && !IsCancelled())
+            m_context.checkpoint->AppendFinished(job->relative);
+
+        // Finishing marks the ancestors changed, and other workers update
+        // the same ancestors under the context mutex.
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_context.mutex);
+            job->dir->Finish();
+        }
+
+        if (!job->parent)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_done = true;
+            m_work_cv.notify_all();
+            m_done_cv.notify_all();
+        }
+
+        std::shared_ptr<ScanJob> parent = std::move(job->parent);
+        job = std::move(parent);
+    }
+}
+
+void ScanPool::Throttle() const
+{
+    if (!m_context.ops_per_sec)
+        return;
+
+    LONGLONG wait = take_token(m_context.ops_per_sec);
+    while (wait > 0 && !IsCancelled())
+    {
+        const DWORD ms = DWORD(std::min<LONGLONG>((wait + 999) / 1000, 50));
+        Sleep(ms);
+        wait -= LONGLONG(ms) * 1000;
+    }
+}
+
+bool ScanPool::ShouldCollapse(const ULONGLONG size) const
+{
+    // Past the soft limit, small files stop getting their own nodes.
+    // Larger files still do, so the biggest ones stay visible.
+    return (m_context.memory_soft_limit &&
+            size < m_context.collapse_below &&
+            GetNodeBytes() > m_context.memory_soft_limit);
+}
+
+void ScanPool::WorkerProc(ScanPool* pThis)
+{
+    // Background mode lowers both CPU and I/O priority.
+    if (pThis->m_context.background)
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+
+    while (true)
+    {
+        std::shared_ptr<ScanJob> job;
+        {
+            std::unique_lock<std::mutex> lock(pThis->m_mutex);
+            pThis->m_work_cv.wait(lock, [pThis](){ return pThis->m_done || (!pThis->m_queue.empty() && pThis->m_active < pThis->m_limit); });
+            if (pThis->m_done)
+                break;
+
+            job = std::move(pThis->m_queue.back());
+            pThis->m_queue.pop_back();
+            ++pThis->m_active;
+        }
+
+        // Cancelled jobs are still released, so that the pool drains.
+        if (!pThis->IsCancelled())
+            pThis->ScanDir(job);
+
+        {
+            std::lock_guard<std::mutex> lock(pThis->m_mutex);
+            --pThis->m_active;
+            pThis->m_work_cv.notify_one();
+        }
+
+        pThis->Release(std::move(job));
+    }
+}
+
+void ScanPool::RestoreListing(const std::shared_ptr<ScanJob>& job, const std::wstring& path, const CheckpointListing& listing, const RestoreCheck& check)
+{
+    ScanContext& context = m_context;
+    const std::shared_ptr<DirNode>& root = job->dir;
+    std::vector<std::shared_ptr<DirNode>> dirs;
+    std::vector<std::shared_ptr<DirNode>> rescans;
+    std::vector<std::shared_ptr<MountPointNode>> mounts;
+
+    std::wstring relative;
+    if (!context.checkpoint->GetRelativePath(path, relative))
+        relative.clear();
+
+    {
+        std::lock_guard<std::recursive_mutex> lock(context.mutex);
+
+        context.current = root;
+
+        std::wstring test;
+        std::wstring key;
+        ULONGLONG files_count = 0;
+        ULONGLONG files_total = 0;
+        for (const auto& entry : listing.m_entries)
+        {
+            if (entry.m_dir)
+            {
+                if (context.dontscan.size() || (entry.m_flags & CPF_MOUNT_POINT))
+                {
+                    test = path;
+                    test.append(entry.m_name);
+                    ensure_separator(test);
+                    if (is_dontscan(test, context))
+                        continue;
+                }
+
+                key = relative;
+                key.append(entry.m_name);
+                ensure_separator(key);
+
+                const bool changed = (check.changed.find(key) != check.changed.end());
+                std::vector<std::shared_ptr<DirNode>>& list = changed ? rescans : dirs;
+
+                if (entry.m_flags & CPF_MOUNT_POINT)
+                {
+                    std::shared_ptr<MountPointNode> mount = add_mount_point(root, entry.m_name.c_str(), test, context);
+                    if (!mount)
+                        continue;
+                    list.emplace_back(mount);
+                    mounts.emplace_back(mount);
+                }
+                else
+                {
+                    // Self contained subtrees stay stubs until browsed, if
+                    // nothing under them changed.  (The test path is only
+                    // built when there's a dontscan list to check against.)
+                    ULONGLONG snapshot;
+                    CheckpointTotals totals;
+                    if (m_source &&
+                        !changed &&
+                        check.stale.find(key) == check.stale.end() &&
+                        (context.dontscan.empty() || !has_dontscan_under(test, context)) &&
+                        context.checkpoint->GetStub(key, snapshot, totals))
+                    {
+                        m_source->AddStub(root, entry.m_name.c_str(), entry.m_flags, snapshot, totals);
+                        continue;
+                    }
+
+                    list.emplace_back(root->AddDir(entry.m_name.c_str()));
+                }
+
+                if (entry.m_flags & CPF_COMPRESSED)
+                    list.back()->SetCompressed();
+            }
+            else
+            {
+                if (ShouldCollapse(entry.m_size) ||
+                    group_early(context.group_small_files, files_count, files_total, entry.m_size))
+                {
+                    root->AddToAggregate(entry.m_size);
+                }
+                else
+                {
+                    std::shared_ptr<FileNode> file = root->AddFile(entry.m_name.c_str(), entry.m_size);
+                    if (entry.m_flags & CPF_COMPRESSED)
+                        file->SetCompressed();
+                    if (entry.m_flags & CPF_SPARSE)
+                        file->SetSparse();
+                }
+
+                files_count++;
+                files_total += entry.m_size;
+            }
+        }
+
+        if (context.group_small_files)
+            group_small_files(root, files_count, files_total);
+    }
+
+    for (const auto& mount : mounts)
+        mount->AddFreeSpace(context.mutex);
+
+    // Descendants were already revalidated by ValidateSubtree, so the ones
+    // that changed get rescanned and the rest are restored.  If a record is
+    // missing for some reason, fall back to scanning that directory.
+
+    std::wstring subpath;
+    CheckpointListing sublisting;
+    for (const auto& dir : dirs)
+    {
+        if (IsCancelled())
+            break;
+
+        subpath = path;
+        subpath.append(dir->GetName());
+        ensure_separator(subpath);
+
+        if (context.checkpoint->GetRelativePath(subpath, relative) &&
+            context.checkpoint->ReadFinished(relative, sublisting))
+        {
+            std::shared_ptr<ScanJob> subjob = MakeJob(dir, subpath, job);
+            RestoreListing(subjob, subpath, sublisting, check);
+            Release(std::move(subjob));
+        }
+        else
+        {
+            Enqueue(dir, subpath, job);
+        }
+    }
+
+    for (const auto& dir : rescans)
+    {
+        if (IsCancelled())
+            break;
+
+        subpath = path;
+        subpath.append(dir->GetName());
+        ensure_separator(subpath);
+
+        Enqueue(dir, subpath, job);
+    }
+}
+
+bool ScanPool::ValidateSubtree(const std::wstring& path, const std::wstring& relative, const CheckpointListing& listing, RestoreCheck& check)
+{
+    // A directory's last write time only changes when entries are added,
+    // removed, or renamed in that directory itself; it doesn't propagate to
+    // the ancestors.  So the whole subtree has to be checked, one directory
+    // at a time.  That is one open per directory instead of a full read.
+
+    struct Pending
+    {
+        std::wstring        path;
+        std::wstring        relative;
+    };
+
+    std::vector<Pending> stack;
+    auto push_children = [&stack](const std::wstring& parent_path, const std::wstring& parent_relative, const CheckpointListing& parent_listing)
+    {
+        for (const auto& entry : parent_listing.m_entries)
+        {
+            if (!entry.m_dir)
+                continue;
+
+            Pending pending;
+            pending.path = parent_path;
+            pending.path.append(entry.m_name);
+            ensure_separator(pending.path);
+            pending.relative = parent_relative;
+            pending.relative.append(entry.m_name);
+            ensure_separator(pending.relative);
+            stack.emplace_back(std::move(pending));
+        }
+    };
+
+    push_children(path, relative, listing);
+
+    CheckpointListing sublisting;
+    while (!stack.empty())
+    {
+        if (IsCancelled())
+            return false;
+
+        const Pending pending = std::move(stack.back());
+        stack.pop_back();
+
+        if (m_context.dontscan.size() && is_dontscan(pending.path, m_context))
+            continue;
+
+        // Directories without a finished record get scanned anyway.
+        if (!m_context.checkpoint->ReadFinished(pending.relative, sublisting))
+            continue;
+
+        Throttle();
+
+        const ULONGLONG token = get_dir_token(pending.path);
+        if (!token || token != sublisting.m_token)
+        {
+            check.MarkChanged(pending.relative);
+            continue;
+        }
+
+        push_children(pending.path, pending.relative, sublisting);
+    }
+
+    return true;
+}
+
+bool ScanPool::RestoreFromCheckpoint(const std::shared_ptr<DirNode>& dir, const std::wstring& path, const std::shared_ptr<ScanJob>& parent)
+{
+    std::wstring relative;
+    if (!m_context.checkpoint->GetRelativePath(path, relative))
+        return false;
+
+    CheckpointListing listing;
+    if (!m_context.checkpoint->ReadFinished(relative, listing))
+        return false;
+
+    Throttle();
+
+    const ULONGLONG token = get_dir_token(path);
+    if (!token || token != listing.m_token)
+        return false;
+
+    RestoreCheck check;
+    if (!ValidateSubtree(path, relative, listing, check))
+        return false;
+
+    std::shared_ptr<ScanJob> job = MakeJob(dir, path, parent);
+    RestoreListing(job, path, listing, check);
+    Release(std::move(job));
+    return true;
+}
+
+void ScanPool::ScanDir(const std::shared_ptr<ScanJob>& job)
+{
+    TRACE_SCOPE("ScanDir");
+
+    ScanContext& context = m_context;
+    const std::shared_ptr<DirNode>& root = job->dir;
+
     if (root->AsRecycleBin())
     {
         std::lock_guard<std::recursive_mutex> lock(context.mutex);
 
         context.current = root;
         root->AsRecycleBin()->UpdateRecycleBin(context.mutex);
-        root->Finish();
         return;
     }
 
     DriveNode* drive = (root->AsDrive() && !is_subst(root->GetName())) ? root->AsDrive() : nullptr;
+    const bool volume_root = (drive || root->IsMountPoint());
 
-    std::wstring find;
-    root->GetFullPath(find);
-    ensure_separator(find);
-
-#ifdef DEBUG
-    if (g_fake_data)
+    // Each job carries its path down from its parent, so only the root job
+    // needs to reconstruct it from the tree.
+    std::wstring find(job->path);
+    if (find.empty())
     {
-        const bool was = SetFake(true);
-        FakeScan(root, 0, true, context);
-        SetFake(was);
-        return;
+        root->GetFullPath(find);
+        ensure_separator(find);
     }
-#endif
 
     const bool use_compressed_size = context.use_compressed_size;
     const size_t base_path_len = find.length();
-    find.append(TEXT("*"));
+
+    CheckpointRecord record;
+    std::wstring relative;
 
     std::vector<std::shared_ptr<DirNode>> dirs;
+    std::vector<ULONGLONG> records;
+    std::vector<std::shared_ptr<MountPointNode>> mounts;
+    ULONGLONG files_count = 0;
+    ULONGLONG files_total = 0;
     std::wstring test(find);
 
-    WIN32_FIND_DATA fd;
-    HANDLE hFind = FindFirstFile(find.c_str(), &fd);
-    if (hFind != INVALID_HANDLE_VALUE)
+    Throttle();
+
+    DirEnumerator e;
+    const LONGLONG started = GetMicroseconds();
+    const bool opened = e.Open(find);
+    InterlockedAdd64(&m_read_us, GetMicroseconds() - started);
+    InterlockedIncrement64(&m_reads);
+
+    // The token is read when the directory is opened, so it's available
+    // even for the root of the scan.
+    if (context.checkpoint && context.checkpoint->GetRelativePath(find, relative))
+        record.Begin(relative, e.GetToken(), BYTE(root->IsCompressed() ? CPF_COMPRESSED : CPF_NONE));
+
+    if (opened)
     {
         DWORD tick = GetTickCount();
         ULONGLONG num = 0;
 
-        do
+        ScanEntry fd;
+        while (!IsCancelled())
         {
-            std::lock_guard<std::recursive_mutex> lock(context.mutex);
+            // Each further page of entries is another read.
+            if (e.NeedsRead())
+                Throttle();
+            if (!e.Next(fd))
+                break;
+
+            InterlockedIncrement64(&m_entries);
 
-            const bool compressed = (use_compressed_size && (fd.dwFileAttributes & FILE_ATTRIBUTE_COMPRESSED));
+            const bool compressed = (use_compressed_size && (fd.attributes & FILE_ATTRIBUTE_COMPRESSED));
+            const bool mount = (fd.reparse_tag == IO_REPARSE_TAG_MOUNT_POINT && context.cross_mount_points);
+
+            // Querying a file's size or link count can mean opening it, so
+            // it's done before taking the context mutex (which is also the
+            // UI mutex).
+            ULONGLONG size = 0;
+            DWORD links = 1;
+            if (!(fd.attributes & FILE_ATTRIBUTE_DIRECTORY))
+            {
+                size = get_file_size(fd, compressed, context.use_size_on_disk, find, base_path_len);
+                if (context.count_links_once && fd.has_file_id && size)
+                    links = get_link_count(fd, find, base_path_len);
+            }
+
+            std::lock_guard<std::recursive_mutex> lock(context.mutex);
 
-            if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            if (fd.attributes & FILE_ATTRIBUTE_DIRECTORY)
             {
-                if (fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+                // Junctions and symlinks are never followed.  Volume mount
+                // points are only followed when crossing them is enabled.
+                if ((fd.attributes & FILE_ATTRIBUTE_REPARSE_POINT) && !mount)
                     continue;
-                if (!wcscmp(fd.cFileName, TEXT(".")) || !wcscmp(fd.cFileName, TEXT("..")))
+                if (!wcscmp(fd.name.c_str(), TEXT(".")) || !wcscmp(fd.name.c_str(), TEXT("..")))
                     continue;
-                if (drive && !wcsicmp(fd.cFileName, TEXT("$recycle.bin")))
+                if (volume_root && !wcsicmp(fd.name.c_str(), TEXT("$recycle.bin")))
                     continue;
 
-                if (context.dontscan.size())
+                if (context.dontscan.size() || mount)
                 {
-                    bool match = false;
                     test.resize(base_path_len);
-                    test.append(fd.cFileName);
+                    test.append(fd.name.c_str());
                     ensure_separator(test);
-                    for (const auto& ignore : context.dontscan)
-                    {
-                        match = !wcsicmp(ignore.c_str(), test.c_str());
-                        if (match)
-                            break;
-                    }
-                    if (match)
+                    if (is_dontscan(test, context))
                         continue;
                 }
 
-                dirs.emplace_back(root->AddDir(fd.cFileName));
+                if (mount)
+                {
+                    std::shared_ptr<MountPointNode> dir = add_mount_point(root, fd.name.c_str(), test, context);
+                    if (!dir)
+                        continue;
+                    dirs.emplace_back(dir);
+                    mounts.emplace_back(dir);
+                }
+                else
+                {
+                    dirs.emplace_back(root->AddDir(fd.name.c_str()));
+                }
+                records.emplace_back(fd.has_file_id ? (fd.file_id & c_file_record_mask) : 0);
                 assert(dirs.back());
 
                 if (compressed)
                     dirs.back()->SetCompressed();
 
+                if (!record.IsEmpty())
+                    record.AddDir(fd.name.c_str(), BYTE((compressed ? CPF_COMPRESSED : CPF_NONE) |
+                                                        (mount ? CPF_MOUNT_POINT : CPF_NONE)));
+
                 if (++num > 50 || GetTickCount() - tick > 50)
                 {
                     context.current = dirs.back();
@@ -303,25 +1350,38 @@ LResetFeedbackInterval:
             else
             {
                 ULARGE_INTEGER uli;
-                if (compressed || (fd.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE))
+                uli.QuadPart = size;
+
+                // Count the data of a file with multiple hard links only
+                // once; later links show up with zero size.  Only files
+                // with more than one link are remembered.
+                if (links > 1 && !context.file_ids.insert(fd.file_id).second)
+                    uli.QuadPart = 0;
+
+                const bool sparse = !!(fd.attributes & FILE_ATTRIBUTE_SPARSE_FILE);
+
+                std::shared_ptr<FileNode> file;
+                if (ShouldCollapse(uli.QuadPart) ||
+                    group_early(context.group_small_files, files_count, files_total, uli.QuadPart))
                 {
-                    find.resize(base_path_len);
-                    find.append(fd.cFileName);
-                    uli.LowPart = GetCompressedFileSize(find.c_str(), &uli.HighPart);
+                    file = root->AddToAggregate(uli.QuadPart);
                 }
                 else
                 {
-                    uli.HighPart = fd.nFileSizeHigh;
-                    uli.LowPart = fd.nFileSizeLow;
+                    file = root->AddFile(fd.name.c_str(), uli.QuadPart);
+                    if (compressed)
+                        file->SetCompressed();
+                    if (sparse)
+                        file->SetSparse();
                 }
-
-                std::shared_ptr<FileNode> file = root->AddFile(fd.cFileName, uli.QuadPart);
                 assert(file);
 
-                if (compressed)
-                    file->SetCompressed();
-                if (fd.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE)
-                    file->SetSparse();
+                if (!record.IsEmpty())
+                    record.AddFile(fd.name.c_str(), uli.QuadPart, BYTE((compressed ? CPF_COMPRESSED : CPF_NONE) |
+                                                                       (sparse ? CPF_SPARSE : CPF_NONE)));
+
+                files_count++;
+                files_total += uli.QuadPart;
 
                 if (++num > 50 || GetTickCount() - tick > 50)
                 {
@@ -330,32 +1390,197 @@ LResetFeedbackInterval:
                 }
             }
         }
-        while (this_generation == *current_generation && FindNextFile(hFind, &fd));
+    }
+
+    for (const auto& mount : mounts)
+        mount->AddFreeSpace(context.mutex);
+
+    if (context.group_small_files && !IsCancelled())
+    {
+        std::lock_guard<std::recursive_mutex> lock(context.mutex);
+        group_small_files(root, files_count, files_total);
+    }
 
-        FindClose(hFind);
-        hFind = INVALID_HANDLE_VALUE;
+    // Only a complete listing is worth recording.  The finished record is
+    // appended by Release once the whole subtree is done.
+    if (!record.IsEmpty() && !IsCancelled())
+    {
+        context.checkpoint->AppendListing(record);
+        job->relative = std::move(relative);
+        job->recorded = true;
     }
 
-    for (const auto dir : dirs)
+    // Descending in file record order makes the MFT reads mostly
+    // sequential, which saves seeks on spinning disks.  Without file IDs
+    // (FindFirstFile fallback) the order is left alone.
+    std::vector<size_t> order(dirs.size());
+    for (size_t ii = 0; ii < order.size(); ++ii)
+        order[ii] = ii;
+    if (context.file_id_order)
+        std::stable_sort(order.begin(), order.end(), [&records](size_t a, size_t b){ return records[a] < records[b]; });
+
+    // Queue the subdirectories in reverse, so they're dequeued in order.
+    for (size_t jj = order.size(); jj--;)
     {
-        if (this_generation != *current_generation)
+        if (IsCancelled())
             break;
-        Scan(dir, this_generation, current_generation, context);
+
+        const size_t ii = order[jj];
+
+        test.resize(base_path_len);
+        test.append(dirs[ii]->GetName());
+        ensure_separator(test);
+
+        if (context.checkpoint && RestoreFromCheckpoint(dirs[ii], test, job))
+            continue;
+
+        Enqueue(dirs[ii], test, job);
     }
 
-    if (this_generation == *current_generation && drive)
+    if (!IsCancelled() && drive)
     {
         drive->AddRecycleBin();
         const auto recycle = drive->GetRecycleBin();
 
         if (recycle)
         {
-            context.current = recycle;
+            {
+                std::lock_guard<std::recursive_mutex> lock(context.mutex);
+                context.current = recycle;
+            }
             recycle->UpdateRecycleBin(context.mutex);
             recycle->Finish();
         }
     }
+}
 
-    root->Finish();
+//----------------------------------------------------------------------------
+// Scan.
+
+void GetScanVolume(const std::shared_ptr<DirNode>& root, std::wstring& out)
+{
+    root->GetFullPath(out);
+
+    WCHAR sz[MAX_PATH];
+    if (GetVolumePathName(out.c_str(), sz, _countof(sz)))
+        out = sz;
+}
+
+void Scan(const std::shared_ptr<DirNode>& root, const LONG this_generation, volatile LONG* current_generation, ScanContext& context)
+{
+    TRACE_SCOPE("Scan");
+
+    // File IDs are only unique per volume, so hard links are only matched
+    // within a root.
+    context.file_ids.clear();
+
+    // Each volume gets its own tuned concurrency.
+    std::wstring volume_path;
+    GetScanVolume(root, volume_path);
+
+    context.volumes.clear();
+    if (context.cross_mount_points)
+    {
+        std::wstring volume;
+        if (get_mount_volume(volume_path.c_str(), volume))
+            context.volumes.insert(volume);
+    }
+
+#ifdef DEBUG
+    if (g_fake_data && !root->AsRecycleBin())
+    {
+        const bool was = SetFake(true);
+        FakeScan(root, 0, true, context);
+        SetFake(was);
+        return;
+    }
+#endif
+
+    ScanPool pool(volume_path.c_str(), this_generation, current_generation, context);
+    pool.Run(root);
 }
 
+
+bool ExpandAggregate(const std::shared_ptr<DirNode>& dir, std::recursive_mutex& mutex)
+{
+    // Files that already have their own nodes are left alone, and so are
+    // files larger than any in the group.  The rest must match the group
+    // exactly; otherwise the directory has changed since it was scanned (or
+    // hard links were counted once), and only a Rescan can sort that out.
+    std::shared_ptr<AggregateNode> aggregate;
+    std::unordered_set<std::wstring> known;
+    ULONGLONG count = 0;
+    ULONGLONG total = 0;
+    ULONGLONG max = 0;
+    {
+        std::lock_guard<std::recursive_mutex> lock(mutex);
+
+        for (const auto& file : dir->CopyFiles())
+        {
+            if (file->AsAggregate())
+                aggregate = std::static_pointer_cast<AggregateNode>(file);
+            else
+                known.insert(file->GetName());
+        }
+
+        if (!aggregate)
+            return false;
+
+        count = aggregate->CountFiles();
+        total = aggregate->GetSize();
+        max = aggregate->GetMaxSize();
+    }
+
+    std::wstring find;
+    dir->GetFullPath(find);
+    ensure_separator(find);
+    const size_t base_path_len = find.length();
+
+    DirEnumerator e;
+    if (!e.Open(find))
+        return false;
+
+    std::vector<CheckpointEntry> entries;
+    ULONGLONG found = 0;
+    ScanEntry fd;
+    while (e.Next(fd))
+    {
+        if ((fd.attributes & FILE_ATTRIBUTE_DIRECTORY) || known.count(fd.name))
+            continue;
+
+        const bool compressed = (g_use_compressed_size && (fd.attributes & FILE_ATTRIBUTE_COMPRESSED));
+
+        CheckpointEntry entry;
+        entry.m_size = get_file_size(fd, compressed, g_use_size_on_disk, find, base_path_len);
+        if (entry.m_size > max)
+            continue;
+
+        entry.m_name = std::move(fd.name);
+        entry.m_flags = BYTE((compressed ? CPF_COMPRESSED : CPF_NONE) |
+                             ((fd.attributes & FILE_ATTRIBUTE_SPARSE_FILE) ? CPF_SPARSE : CPF_NONE));
+        found += entry.m_size;
+        entries.emplace_back(std::move(entry));
+    }
+
+    if (entries.size() != count || found != total)
+        return false;
+
+    std::lock_guard<std::recursive_mutex> lock(mutex);
+
+    // The group may have changed while the directory was being read.
+    const auto files = dir->CopyFiles();
+    if (std::find(files.begin(), files.end(), aggregate) == files.end() ||
+        aggregate->CountFiles() != count || aggregate->GetSize() != total)
+        return false;
+
+    dir->DeleteChild(aggregate);
+    for (const auto& entry : entries)
+    {
+        std::shared_ptr<FileNode> file = dir->AddFile(entry.m_name.c_str(), entry.m_size);
+        if (entry.m_flags & CPF_COMPRESSED)
+            file->SetCompressed();
+        if (entry.m_flags & CPF_SPARSE)
+            file->SetSparse();
+    }
+    return true;
+}
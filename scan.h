@@ -4,8 +4,11 @@
 #pragma once
 
 #include <memory>
+#include <unordered_set>
 
 class DirNode;
+class MountPointNode;
+class ScanCheckpoint;
 
 struct ScanContext
 {
@@ -13,8 +16,34 @@ struct ScanContext
     std::shared_ptr<Node>& current;
     bool use_compressed_size = false;
     std::vector<std::wstring> dontscan;
+    std::shared_ptr<ScanCheckpoint> checkpoint;
+    bool use_size_on_disk = false;
+    bool count_links_once = false;
+    std::unordered_set<ULONGLONG> file_ids;     // Files with multiple links, for count_links_once.
+    bool cross_mount_points = false;
+    std::unordered_set<std::wstring> volumes;   // Volumes already reached.
+    std::vector<std::shared_ptr<MountPointNode>> mounts;
+    bool file_id_order = false;                 // Descend in file ID order.
+    bool background = false;                    // Lower CPU and I/O priority.
+    unsigned ops_per_sec = 0;                   // Directory opens and page reads per second; 0 is unlimited.
+    ULONGLONG memory_soft_limit = 0;            // Node bytes past which small files are collapsed; 0 is none.
+    ULONGLONG collapse_below = 0;               // Size of files to collapse past the soft limit.
+    bool group_small_files = false;
+};
+
+struct ScanTelemetry
+{
+    std::wstring volume;
+    unsigned threads = 0;                       // Current concurrency limit.
+    ULONGLONG entries_per_sec = 0;
+    ULONGLONG latency_us = 0;                   // Average per directory read.
+    const WCHAR* reason = TEXT("");             // Why the limit last changed (or didn't).
+    bool active = false;
 };
 
 std::shared_ptr<DirNode> MakeRoot(const WCHAR* path);
+void GetScanVolume(const std::shared_ptr<DirNode>& root, std::wstring& out);
+void GetScanTelemetry(std::vector<ScanTelemetry>& out);
 void Scan(const std::shared_ptr<DirNode>& root, LONG this_generation, volatile LONG* current_generation, ScanContext& context);
+bool ExpandAggregate(const std::shared_ptr<DirNode>& dir, std::recursive_mutex& mutex);   // Reads the directory, so not on the UI thread.
 
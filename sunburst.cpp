@@ -5,8 +5,12 @@
 #include "sunburst.h"
 #include "data.h"
 #include "DarkMode.h"
+#include "trace.h"
+#include "colorbatch.h"
+#include "export.h"
 #include "TextOnPath/PathTextRenderer.h"
 #include <cmath>
+#include <algorithm>
 
 static ID2D1Factory* s_pD2DFactory = nullptr;
 static IDWriteFactory2* s_pDWriteFactory = nullptr;
@@ -38,10 +42,8 @@ constexpr FLOAT c_fontsize = 10.0f;
 constexpr FLOAT c_headerfontsize = 12.0f;
 constexpr FLOAT c_arcfontsize = 8.0f;
 constexpr FLOAT c_minArc = 2.5f;
-constexpr UINT32 c_minArcTextLength = 1;
 
 constexpr WCHAR c_ellipsis[] = TEXT("...");
-constexpr size_t c_ellipsis_len = _countof(c_ellipsis) - 1;
 
 HRESULT InitializeD2D()
 {
@@ -748,9 +750,9 @@ bool DirectHwndRenderTarget::WriteText(IDWriteTextFormat* format, FLOAT x, FLOAT
 //----------------------------------------------------------------------------
 // SunburstMetrics.
 
-static FLOAT make_center_radius(const DpiScaler& dpi, const FLOAT boundary_radius, const FLOAT max_extent)
+static FLOAT make_center_radius(const DpiScaler& dpi, const FLOAT boundary_radius, const FLOAT max_extent, const bool proportional_area)
 {
-    if (g_show_proportional_area)
+    if (proportional_area)
     {
         // winR and maxR use different ratios to accelerate growth of radius
         // when resizing the window larger, but with a maximum beyond which it
@@ -765,21 +767,22 @@ static FLOAT make_center_radius(const DpiScaler& dpi, const FLOAT boundary_radiu
 }
 
 SunburstMetrics::SunburstMetrics(const Sunburst& sunburst)
-: SunburstMetrics(sunburst.m_dpi, sunburst.m_bounds, sunburst.m_max_extent)
+: SunburstMetrics(sunburst.m_dpi, sunburst.m_bounds, sunburst.m_max_extent, sunburst.m_proportional_area)
 {
 }
 
-SunburstMetrics::SunburstMetrics(const DpiScaler& dpi, const D2D1_RECT_F& bounds, FLOAT max_extent)
+SunburstMetrics::SunburstMetrics(const DpiScaler& dpi, const D2D1_RECT_F& bounds, FLOAT max_extent, const bool proportional_area)
 : stroke(std::max<FLOAT>(FLOAT(dpi.Scale(1)), FLOAT(1)))
 , margin(FLOAT(dpi.Scale(5)))
 , indicator_thickness(FLOAT(dpi.Scale(4)))
 , boundary_radius(FLOAT(std::min<LONG>(LONG(bounds.right - bounds.left), LONG(bounds.bottom - bounds.top)) / 2 - margin))
-, center_radius(make_center_radius(dpi, boundary_radius, max_extent))
+, center_radius(make_center_radius(dpi, boundary_radius, max_extent, proportional_area))
 , max_radius(boundary_radius - (margin + indicator_thickness + margin))
 , range_radius(max_radius - center_radius)
 , min_arc(dpi.ScaleF(c_minArc))
+, proportional_area(proportional_area)
 {
-    if (g_show_proportional_area)
+    if (proportional_area)
     {
         FLOAT radius = center_radius;
         // const FLOAT coefficient = 0.18f;
@@ -809,7 +812,7 @@ FLOAT SunburstMetrics::get_thickness(size_t depth) const
 {
     if (depth < _countof(thicknesses))
         return thicknesses[depth];
-    return g_show_proportional_area ? 0.0f : thicknesses[_countof(thicknesses) - 1];
+    return proportional_area ? 0.0f : thicknesses[_countof(thicknesses) - 1];
 }
 
 //----------------------------------------------------------------------------
@@ -823,6 +826,13 @@ Sunburst::~Sunburst()
 {
 }
 
+void Sunburst::SetChartOptions(const bool show_free_space, const bool proportional_area, const long color_mode)
+{
+    m_show_free_space = show_free_space;
+    m_proportional_area = proportional_area;
+    m_color_mode = color_mode;
+}
+
 bool Sunburst::SetBounds(const D2D1_RECT_F& rect, const FLOAT max_extent)
 {
     static_assert(sizeof(m_bounds) == sizeof(rect), "data size mismatch");
@@ -837,29 +847,16 @@ bool Sunburst::SetBounds(const D2D1_RECT_F& rect, const FLOAT max_extent)
     return changed;
 }
 
-void Sunburst::MakeArc(std::vector<Arc>& arcs, FLOAT outer_radius, const FLOAT min_arc, const std::shared_ptr<Node>& node, ULONGLONG size, double& sweep, double total, float start, float span, double convert)
+void Sunburst::BuildRings(const SunburstMetrics& mx, const std::vector<std::shared_ptr<DirNode>>& _roots)
 {
-    const bool zero = (total == 0.0f);
-    Arc arc;
-    arc.m_start = start + float(zero ? 0.0f : convert * sweep * span / total);
-    sweep += size;
-    arc.m_end = start + float(zero ? 0.0f : convert * sweep * span / total);
+    TRACE_SCOPE("BuildRings");
 
-#ifdef DEBUG
-    if (arc.m_start > 360.0f || arc.m_end > 360.0f)
-        DebugBreak();
-    assert(arc.m_end - arc.m_start <= span);
-#endif
+    const LONGLONG started = GetMicroseconds();
 
-    if (ArcLength(arc.m_end - arc.m_start, outer_radius) >= min_arc)
-    {
-        arc.m_node = node;
-        arcs.emplace_back(std::move(arc));
-    }
-}
+    std::unique_lock<std::recursive_mutex> lock;
+    if (m_layout_mutex)
+        lock = std::unique_lock<std::recursive_mutex>(*m_layout_mutex);
 
-void Sunburst::BuildRings(const SunburstMetrics& mx, const std::vector<std::shared_ptr<DirNode>>& _roots)
-{
     const std::vector<std::shared_ptr<DirNode>> roots = _roots;
 
     std::vector<double> totals; // Total space (used + free); when FreeSpaceNode is present it's total hardware space.
@@ -868,12 +865,16 @@ void Sunburst::BuildRings(const SunburstMetrics& mx, const std::vector<std::shar
     std::vector<float> spans;   // Angle span for used space.
 
     m_roots = roots;
+    m_layout_canceled = false;
     m_rings.clear();
+    m_display_list.reset();
+    m_colors.clear();
+    m_root_totals.clear();
     m_start_angles.clear();
     m_free_angles.clear();
 
     {
-        bool show_free_space = g_show_free_space;
+        bool show_free_space = m_show_free_space;
 #ifdef DEBUG
         if (g_fake_data == FDM_COLORWHEEL)
         {
@@ -958,12 +959,13 @@ void Sunburst::BuildRings(const SunburstMetrics& mx, const std::vector<std::shar
         const double convert = scale[ii];
         const float start = m_start_angles[ii];
         const float span = spans[ii];
+        const size_t first = arcs.size();
 
         double sweep = 0;
         for (const auto dir : dirs)
-            MakeArc(arcs, outer_radius, min_arc, std::static_pointer_cast<Node>(dir), dir->GetSize(), sweep, consumed, start, span, convert);
+            MakeRingArc<Node>(arcs, outer_radius, min_arc, std::static_pointer_cast<Node>(dir), dir->GetSize(), sweep, consumed, start, span, convert);
         for (const auto file : files)
-            MakeArc(arcs, outer_radius, min_arc, std::static_pointer_cast<Node>(file), file->GetSize(), sweep, consumed, start, span, convert);
+            MakeRingArc<Node>(arcs, outer_radius, min_arc, std::static_pointer_cast<Node>(file), file->GetSize(), sweep, consumed, start, span, convert);
 #ifdef USE_FREESPACE_RING
         if (free)
         {
@@ -976,18 +978,67 @@ void Sunburst::BuildRings(const SunburstMetrics& mx, const std::vector<std::shar
             arcs.emplace_back(std::move(arc));
         }
 #endif
+
+        // What colors need from the ancestors is gathered once per root and
+        // handed down the rings, instead of walking the ancestors per arc.
+        ULONGLONG root_total = 0;
+        for (std::shared_ptr<DirNode> up = root; up; up = up->GetParent())
+        {
+            if (up->AsDrive() && up->AsDrive()->GetFreeSpace())
+                root_total = up->AsDrive()->GetFreeSpace()->GetTotalSize();
+            else
+                root_total = up->GetSize();
+        }
+        m_root_totals.emplace_back(root_total);
+
+        SetRingArcAncestry(arcs, first, ii, is_root_finished(root));
     }
 
+    m_layout_arcs = m_rings.back().size();
+    m_layout_truncated = false;
+
     while (m_rings.size() <= c_max_depth)
     {
+        // A layout on a background thread lets others at the tree between
+        // rings, and gives up as soon as it's been superseded.
+        if (lock.owns_lock())
+        {
+            lock.unlock();
+            lock.lock();
+        }
+        if (m_cancel && *m_cancel != m_cancel_generation)
+        {
+            m_layout_canceled = true;
+            break;
+        }
+
+        // A progressive layout stops early, while a scan is still changing
+        // the tree; see SetLayoutBudget.
+        if (m_max_layout_depth && m_rings.size() >= m_max_layout_depth)
+        {
+            m_layout_truncated = true;
+            break;
+        }
+
         outer_radius += mx.get_thickness(m_rings.size() + 1);
 
-        std::vector<Arc> arcs = NextRing(m_rings.back(), outer_radius, min_arc);
+        std::vector<Arc> arcs = NextRing(m_rings.back(), outer_radius, min_arc, m_layout_parallel ? 0 : 1);
         if (arcs.empty())
             break;
+
+        if (m_max_layout_arcs && m_layout_arcs + arcs.size() > m_max_layout_arcs)
+        {
+            m_layout_truncated = true;
+            break;
+        }
+
+        m_layout_arcs += arcs.size();
         m_rings.emplace_back(std::move(arcs));
     }
 
+    if (m_layout_canceled)
+        return;
+
 #ifdef DEBUG
     for (const auto ring : m_rings)
     {
@@ -999,46 +1050,22 @@ void Sunburst::BuildRings(const SunburstMetrics& mx, const std::vector<std::shar
         }
     }
 #endif
-}
-
-std::vector<Sunburst::Arc> Sunburst::NextRing(const std::vector<Arc>& parent_ring, const FLOAT outer_radius, const FLOAT min_arc)
-{
-    std::vector<Arc> arcs;
-
-    for (const auto _parent : parent_ring)
-    {
-        const DirNode* parent = _parent.m_node->AsDir();
-        if (parent && !parent->IsHidden())
-        {
-            double sweep = 0;
-
-            const std::vector<std::shared_ptr<DirNode>> dirs = parent->CopyDirs();
-            const std::vector<std::shared_ptr<FileNode>> files = parent->CopyFiles();
-
-#ifdef DEBUG
-            const size_t index = arcs.size();
-#endif
 
-            const float start = _parent.m_start;
-            const float span = _parent.m_end - _parent.m_start;
+    BuildColors();
 
-            const double range = double(parent->GetSize());
-            for (const auto dir : dirs)
-                MakeArc(arcs, outer_radius, min_arc, std::static_pointer_cast<Node>(dir), dir->GetSize(), sweep, range, start, span);
-            for (const auto file : files)
-                MakeArc(arcs, outer_radius, min_arc, std::static_pointer_cast<Node>(file), file->GetSize(), sweep, range, start, span);
-
-#ifdef DEBUG
-            if (arcs.size() > index)
-            {
-                assert(arcs[index].m_start >= _parent.m_start);
-                assert(arcs.back().m_end <= _parent.m_end + 0.001f);
-            }
-#endif
-        }
-    }
+    m_layout_us = GetMicroseconds() - started;
+}
 
-    return arcs;
+size_t Sunburst::GetLayoutBytes() const
+{
+    // Approximate:  once painted, each arc also gets about one display list
+    // command.
+    size_t bytes = sizeof(*this);
+    for (const auto& ring : m_rings)
+        bytes += ring.capacity() * (sizeof(Arc) + sizeof(DisplayCommand));
+    for (const auto& colors : m_colors)
+        bytes += colors.capacity() * sizeof(colors[0]);
+    return bytes;
 }
 
 static FLOAT FindAngle(const D2D1_POINT_2F& center, FLOAT x, FLOAT y)
@@ -1084,42 +1111,49 @@ static D2D1_POINT_2F MakePoint(const D2D1_POINT_2F& center, FLOAT radius, FLOAT
 }
 
 
-static COLORREF color_from_angle_depth(FLOAT angle, size_t depth, bool highlight, bool file)
-{
 #ifdef DEBUG
-    if (s_fOklab)
-    {
-        colorspace::Oklab oklab(RGB(0, 255, 0));
+static colorspace::Oklab oklab_from_angle_depth(FLOAT angle, size_t depth, bool highlight, bool file)
+{
+    colorspace::Oklab oklab(RGB(0, 255, 0));
 
-        float C;
-        float h;
-        oklab.get_Ch(C, h);
+    float C;
+    float h;
+    oklab.get_Ch(C, h);
 
-        h = clamp<FLOAT>(angle, 0.0f, 360.0f);
-        C = C * (file ? 0.7f : 0.95f) - (FLOAT(depth) * C / 25);//20);
-        if (highlight)
-            C = C + 0.1f;
+    h = clamp<FLOAT>(angle, 0.0f, 360.0f);
+    C = C * (file ? 0.7f : 0.95f) - (FLOAT(depth) * C / 25);//20);
+    if (highlight)
+        C = C + 0.1f;
 
-        oklab.set_Ch(C, h);
+    oklab.set_Ch(C, h);
 
-        oklab.L = (file ? 0.9f : 0.5f) + (FLOAT(depth) * (oklab.L / 20));
-        //oklab.L = (file ? 0.8f : 0.7f) + (FLOAT(depth) * (1.0f / 30.0f));
+    oklab.L = (file ? 0.9f : 0.5f) + (FLOAT(depth) * (oklab.L / 20));
+    //oklab.L = (file ? 0.8f : 0.7f) + (FLOAT(depth) * (1.0f / 30.0f));
 
-        if (highlight)
-            oklab.L = 0.8f;//-= 0.05f;
+    if (highlight)
+        oklab.L = 0.8f;//-= 0.05f;
 
-        return oklab.to_rgb();
-    }
-    else
+    return oklab;
+}
 #endif
-    {
-        colorspace::HSLColorType hsl;
-        hsl.h = angle * colorspace::c_maxHue / 360;
-        hsl.s = highlight ? colorspace::c_maxSat : (colorspace::c_maxSat * (file ? 0.7f : 0.95f)) - (FLOAT(depth) * (colorspace::c_maxSat / 25));
-        hsl.l = highlight ? colorspace::c_maxLum*3/5 : (colorspace::c_maxLum * (file ? 0.6f : 0.4f)) + (FLOAT(depth) * (colorspace::c_maxLum / 30));
-        hsl.FixLuminance();
-        return hsl.ToRGB();
-    }
+
+static colorspace::HSLColorType hsl_from_angle_depth(FLOAT angle, size_t depth, bool highlight, bool file)
+{
+    colorspace::HSLColorType hsl;
+    hsl.h = angle * colorspace::c_maxHue / 360;
+    hsl.s = highlight ? colorspace::c_maxSat : (colorspace::c_maxSat * (file ? 0.7f : 0.95f)) - (FLOAT(depth) * (colorspace::c_maxSat / 25));
+    hsl.l = highlight ? colorspace::c_maxLum*3/5 : (colorspace::c_maxLum * (file ? 0.6f : 0.4f)) + (FLOAT(depth) * (colorspace::c_maxLum / 30));
+    hsl.FixLuminance();
+    return hsl;
+}
+
+static COLORREF color_from_angle_depth(FLOAT angle, size_t depth, bool highlight, bool file)
+{
+#ifdef DEBUG
+    if (s_fOklab)
+        return oklab_from_angle_depth(angle, depth, highlight, file).to_rgb();
+#endif
+    return hsl_from_angle_depth(angle, depth, highlight, file).ToRGB();
 }
 
 inline BYTE blend(BYTE a, BYTE b, FLOAT ratio)
@@ -1127,53 +1161,55 @@ inline BYTE blend(BYTE a, BYTE b, FLOAT ratio)
     return BYTE(FLOAT(a) * ratio) + BYTE(FLOAT(b) * (1.0f - ratio));
 }
 
-D2D1_COLOR_F Sunburst::MakeColor(const Arc& arc, size_t depth, bool highlight)
+static D2D1_COLOR_F color_from_rgb(COLORREF rgb)
+{
+    D2D1_COLOR_F color;
+    color.r = FLOAT(GetRValue(rgb)) / 255;
+    color.g = FLOAT(GetGValue(rgb)) / 255;
+    color.b = FLOAT(GetBValue(rgb)) / 255;
+    color.a = 1.0f;
+    return color;
+}
+
+// Returns true and sets hue when the arc's color comes from the color wheel,
+// otherwise returns false and sets color.
+bool Sunburst::GetArcHue(const Arc& arc, bool highlight, FLOAT& hue, D2D1_COLOR_F& color) const
 {
     if (arc.m_node->AsFreeSpace())
-        return D2D1::ColorF(highlight ? D2D1::ColorF::LightSteelBlue : (m_dark_mode ? 0xdddddd : D2D1::ColorF::WhiteSmoke));
+    {
+        color = D2D1::ColorF(highlight ? D2D1::ColorF::LightSteelBlue : (m_dark_mode ? 0xdddddd : D2D1::ColorF::WhiteSmoke));
+        return false;
+    }
 
-    DirNode* dir = arc.m_node->AsDir();
-    FileNode* file = arc.m_node->AsFile();
-    if (file)
-        depth = 0;
-    else if (dir && dir->IsHidden())
-        return D2D1::ColorF(0xB8B8B8);
+    const DirNode* dir = arc.m_node->AsDir();
+    const FileNode* file = arc.m_node->AsFile();
+    if (!file && dir && dir->IsHidden())
+    {
+        color = D2D1::ColorF(0xB8B8B8);
+        return false;
+    }
 
-    if (!is_root_finished(arc.m_node))
-        return D2D1::ColorF(highlight ? 0x3078F8 : 0xB8B8B8);
+    if (!arc.m_finished)
+    {
+        color = D2D1::ColorF(highlight ? 0x3078F8 : 0xB8B8B8);
+        return false;
+    }
 
-    switch (g_color_mode)
+    switch (m_color_mode)
     {
     default:
     case CM_PLAIN:
-        return D2D1::ColorF(highlight ? 0x3078F8 : 0x6495ED);
+        color = D2D1::ColorF(highlight ? 0x3078F8 : 0x6495ED);
+        return false;
 
     case CM_RAINBOW:
-        {
-            const FLOAT angle = (arc.m_start + arc.m_end) / 2.0f;
-            const COLORREF rgb = color_from_angle_depth(angle, depth, highlight, file);
-
-            D2D1_COLOR_F color;
-            color.r = FLOAT(GetRValue(rgb)) / 255;
-            color.g = FLOAT(GetGValue(rgb)) / 255;
-            color.b = FLOAT(GetBValue(rgb)) / 255;
-            color.a = 1.0f;
-
-            return color;
-        }
-        break;
+        hue = (arc.m_start + arc.m_end) / 2.0f;
+        return true;
 
     case CM_HEATMAP:
         {
-            ULONGLONG root_total = 0;
+            ULONGLONG root_total = m_root_totals[arc.m_root];
             ULONGLONG node_total = dir ? dir->GetSize() : file ? file->GetSize() : 0;
-            for (auto parent = arc.m_node->GetParent(); parent; parent = parent->GetParent())
-            {
-                if (parent->AsDrive() && parent->AsDrive()->GetFreeSpace())
-                    root_total = parent->AsDrive()->GetFreeSpace()->GetTotalSize();
-                else
-                    root_total = parent->GetSize();
-            }
 
             const ULONGLONG skew = ULONGLONG(root_total * 0.01f);
             root_total = (root_total > skew) ? root_total - skew : 0;
@@ -1184,29 +1220,95 @@ D2D1_COLOR_F Sunburst::MakeColor(const Arc& arc, size_t depth, bool highlight)
 
             const FLOAT hue1 = 0.0f;
             const FLOAT hue2 = 90.0f;
-            COLORREF rgb;
 
-            {
-                // const FLOAT log_max = sqrt(FLOAT(size_max));
-                // const FLOAT log_node = log_max - sqrt(FLOAT(size_max - size_node));
-                // const FLOAT ratio = (log_max > 0) ? log_node / log_max : 0.0f;
-                const FLOAT ratio = size_node / size_max;
+            // const FLOAT log_max = sqrt(FLOAT(size_max));
+            // const FLOAT log_node = log_max - sqrt(FLOAT(size_max - size_node));
+            // const FLOAT ratio = (log_max > 0) ? log_node / log_max : 0.0f;
+            const FLOAT ratio = size_node / size_max;
+
+            const FLOAT range = hue2 - hue1;
+            hue = range - ratio * range;
+            return true;
+        }
+    }
+}
 
-                const FLOAT range = hue2 - hue1;
-                const FLOAT hue = range - ratio * range;
+D2D1_COLOR_F Sunburst::MakeColor(const Arc& arc, size_t depth, bool highlight)
+{
+    FLOAT hue;
+    D2D1_COLOR_F color;
+    if (!GetArcHue(arc, highlight, hue, color))
+        return color;
 
-                rgb = color_from_angle_depth(hue, depth, highlight, !!file);
-            }
+    const bool file = !!arc.m_node->AsFile();
+    return color_from_rgb(color_from_angle_depth(hue, file ? 0 : depth, highlight, file));
+}
+
+void Sunburst::BuildColors()
+{
+    TRACE_SCOPE("BuildColors");
+
+    // Colors for arcs that aren't highlighted or selected are computed once
+    // per layout, a ring at a time, so the color space conversion can run as
+    // a batch over parallel arrays.
+
+    std::vector<size_t> which;
+    std::vector<float> in1, in2, in3;
+    std::vector<float> r, g, b;
+
+#ifdef DEBUG
+    const bool oklab = s_fOklab;
+#endif
 
-            D2D1_COLOR_F color;
-            color.r = FLOAT(GetRValue(rgb)) / 255;
-            color.g = FLOAT(GetGValue(rgb)) / 255;
-            color.b = FLOAT(GetBValue(rgb)) / 255;
-            color.a = 1.0f;
+    m_colors.resize(m_rings.size());
+    for (size_t depth = 0; depth < m_rings.size(); ++depth)
+    {
+        const std::vector<Arc>& ring = m_rings[depth];
+        std::vector<D2D1_COLOR_F>& colors = m_colors[depth];
+        colors.resize(ring.size());
+
+        which.clear();
+        in1.clear();
+        in2.clear();
+        in3.clear();
+
+        for (size_t ii = 0; ii < ring.size(); ++ii)
+        {
+            FLOAT hue;
+            if (!GetArcHue(ring[ii], false, hue, colors[ii]))
+                continue;
 
-            return color;
+            const bool file = !!ring[ii].m_node->AsFile();
+            which.emplace_back(ii);
+#ifdef DEBUG
+            if (oklab)
+            {
+                const colorspace::Oklab lab = oklab_from_angle_depth(hue, file ? 0 : depth, false, file);
+                in1.emplace_back(lab.L);
+                in2.emplace_back(lab.a);
+                in3.emplace_back(lab.b);
+                continue;
+            }
+#endif
+            const colorspace::HSLColorType hsl = hsl_from_angle_depth(hue, file ? 0 : depth, false, file);
+            in1.emplace_back(hsl.h);
+            in2.emplace_back(hsl.s);
+            in3.emplace_back(hsl.l);
         }
-        break;
+
+        r.resize(which.size());
+        g.resize(which.size());
+        b.resize(which.size());
+
+#ifdef DEBUG
+        if (oklab)
+            OklabToRgbBatch(in1.data(), in2.data(), in3.data(), which.size(), r.data(), g.data(), b.data());
+        else
+#endif
+            HslToRgbBatch(in1.data(), in2.data(), in3.data(), which.size(), r.data(), g.data(), b.data());
+
+        for (size_t jj = 0; jj < which.size(); ++jj)
+            colors[which[jj]] = D2D1::ColorF(r[jj], g[jj], b[jj]);
     }
 }
 
@@ -1337,23 +1439,18 @@ inline bool is_highlight(const std::shared_ptr<Node>& highlight, const std::shar
     return highlight && highlight == node && is_root_finished(node);
 }
 
-// 1 = success, 0 = failure, -1 = can be shortened.
-int Sunburst::DrawArcTextInternal(DirectHwndRenderTarget& target, IDWriteFactory* pFactory, const WCHAR* text, UINT32 length, FLOAT start, FLOAT end, FLOAT radius, bool only_test_fit)
+bool Sunburst::MakeArcTextPath(DirectHwndRenderTarget& target, FLOAT start, FLOAT end, FLOAT radius, ID2D1PathGeometry** ppGeometry)
 {
-    SPI<IDWriteTextLayout> spTextLayout;
-    if (FAILED(pFactory->CreateTextLayout(text, length, target.ArcTextFormat(), m_bounds.right - m_bounds.left, m_bounds.bottom - m_bounds.top, &spTextLayout)))
-        return 0;
-
     D2D1_POINT_2F outer_start_point = MakePoint(m_center, radius, start);
     D2D1_POINT_2F outer_end_point = MakePoint(m_center, radius, end);
 
     SPI<ID2D1PathGeometry> spGeometry;
     if (FAILED(target.Factory()->CreatePathGeometry(&spGeometry)))
-        return 0;
+        return false;
 
     SPI<ID2D1GeometrySink> spSink;
     if (FAILED(spGeometry->Open(&spSink)))
-        return 0;
+        return false;
 
     spSink->SetFillMode(D2D1_FILL_MODE_WINDING);
     spSink->BeginFigure(outer_start_point, D2D1_FIGURE_BEGIN_HOLLOW);
@@ -1363,24 +1460,73 @@ int Sunburst::DrawArcTextInternal(DirectHwndRenderTarget& target, IDWriteFactory
     spSink->EndFigure(D2D1_FIGURE_END_OPEN);
     spSink->Close();
 
+    *ppGeometry = spGeometry.Transfer();
+    return true;
+}
+
+class DWriteArcTextShape : public ArcTextShape
+{
+public:
+    SPI<IDWriteTextLayout>  m_spTextLayout;
+};
+
+class DWriteArcTextMeasurer : public ArcTextMeasurer
+{
+public:
+                            DWriteArcTextMeasurer(Sunburst& sunburst, DirectHwndRenderTarget& target, IDWriteFactory* pFactory);
+    int                     TestFit(const WCHAR* text, UINT32 length, FLOAT span, FLOAT radius, std::shared_ptr<ArcTextShape>* shape) override;
+
+private:
+    Sunburst&               m_sunburst;
+    DirectHwndRenderTarget& m_target;
+    IDWriteFactory* const   m_pFactory;
+};
+
+DWriteArcTextMeasurer::DWriteArcTextMeasurer(Sunburst& sunburst, DirectHwndRenderTarget& target, IDWriteFactory* pFactory)
+: m_sunburst(sunburst)
+, m_target(target)
+, m_pFactory(pFactory)
+{
+}
+
+int DWriteArcTextMeasurer::TestFit(const WCHAR* text, UINT32 length, FLOAT span, FLOAT radius, std::shared_ptr<ArcTextShape>* shape)
+{
+    const D2D1_RECT_F& bounds = m_sunburst.m_bounds;
+
+    SPI<IDWriteTextLayout> spTextLayout;
+    if (FAILED(m_pFactory->CreateTextLayout(text, length, m_target.ArcTextFormat(), bounds.right - bounds.left, bounds.bottom - bounds.top, &spTextLayout)))
+        return 0;
+
+    // Whether text fits only depends on the length of the arc, so measure
+    // along an arc starting at angle 0.
+    SPI<ID2D1PathGeometry> spGeometry;
+    if (!m_sunburst.MakeArcTextPath(m_target, 0.0f, span, radius, &spGeometry))
+        return 0;
+
     PathTextDrawingContext context;
-    context.brush.Set(target.TextBrush());
+    context.brush.Set(m_target.TextBrush());
     context.geometry.Set(spGeometry);
-    context.d2DContext.Set(target.Context());
+    context.d2DContext.Set(m_target.Context());
 
-    const HRESULT hr = target.ArcTextRenderer()->TestFit(&context, spTextLayout);
+    const HRESULT hr = m_target.ArcTextRenderer()->TestFit(&context, spTextLayout);
     if (FAILED(hr))
         return 0;
     if (hr == S_FALSE)
         return -1;
 
-    if (!only_test_fit)
-        spTextLayout->Draw(&context, target.ArcTextRenderer(), 0, 0);
+    if (shape)
+    {
+        std::shared_ptr<DWriteArcTextShape> layout = std::make_shared<DWriteArcTextShape>();
+        layout->m_spTextLayout = std::move(spTextLayout);
+        *shape = std::move(layout);
+    }
     return 1;
 }
 
 void Sunburst::DrawArcText(DirectHwndRenderTarget& target, const Arc& arc, FLOAT radius)
 {
+    TRACE_SCOPE("DrawArcText");
+
     if (ArcLength(arc.m_end - arc.m_start, radius) < m_min_arc_text_len)
         return;
 
@@ -1388,73 +1534,72 @@ void Sunburst::DrawArcText(DirectHwndRenderTarget& target, const Arc& arc, FLOAT
     if (!pFactory)
         return;
 
-    std::wstring text;
-    text.append(TEXT(" "));
 #ifdef SHOW_ARC_LENGTH
-    WCHAR xx[1024];
-    swprintf_s(xx, TEXT("%u"), UINT32(ArcLength(arc.m_end - arc.m_start, radius)));
-    text.append(xx);
+    WCHAR name[1024];
+    swprintf_s(name, TEXT("%u"), UINT32(ArcLength(arc.m_end - arc.m_start, radius)));
 #else
-    text.append(arc.m_node->GetName());
+    const WCHAR* name = arc.m_node->GetName();
 #endif
-    text.append(TEXT(" "));
+
+    DWriteArcTextMeasurer measurer(*this, target, pFactory);
+    ArcTextFit uncached;
+    if (!m_arc_text_fits)
+        FitArcText(measurer, name, arc.m_end - arc.m_start, radius, uncached);
+    const ArcTextFit& fit = (m_arc_text_fits ?
+                             m_arc_text_fits->Fit(measurer, name, target.ArcTextFormat()->GetFontSize(), arc.m_end - arc.m_start, radius) :
+                             uncached);
+    if (!fit.m_fits || !fit.m_shape)
+        return;
 
     const FLOAT start = arc.m_start + c_rotation;
     const FLOAT end = arc.m_end + c_rotation;
 
-    UINT32 length = UINT32(text.length());
-    if (DrawArcTextInternal(target, pFactory, text.c_str(), length, start, end, radius) < 0)
-    {
-        std::wstring truncated;
-        UINT32 lo = c_minArcTextLength;
-        UINT32 hi = length - 2 - 2; // -2 for the padding spaces, -2 to ensure truncation doesn't just replace a character with an ellipsis.
-        UINT32 fits = 0;
-        while (lo <= hi)
-        {
-            UINT32 mid = (lo + hi) / 2;
-            truncated.clear();
-            truncated.append(text.c_str(), mid + 1); // +1 for leading space.
-            truncated.append(c_ellipsis, c_ellipsis_len);
-            truncated.append(TEXT(" "));
-            const int result = DrawArcTextInternal(target, pFactory, truncated.c_str(), UINT32(truncated.length()), start, end, radius, true/*only_test_fit*/);
-            if (result == 0)
-                return;
-            else if (result < 0)
-                hi = mid - 1;
-            else
-            {
-                lo = mid + 1;
-                if (fits < mid)
-                    fits = mid;
-            }
-        }
+    SPI<ID2D1PathGeometry> spGeometry;
+    if (!MakeArcTextPath(target, start, end, radius, &spGeometry))
+        return;
 
-        if (fits >= c_minArcTextLength && fits < text.length())
-        {
-            ++fits; // Including the leading space.
-            fits -= IS_HIGH_SURROGATE(text[fits - 1]);
-            if (fits <= 1) // Must end up with more than just the leading space.
-                return;
-            truncated.clear();
-            truncated.append(text.c_str(), fits);
-            truncated.append(c_ellipsis, c_ellipsis_len);
-            truncated.append(TEXT(" "));
-            DrawArcTextInternal(target, pFactory, truncated.c_str(), UINT32(truncated.length()), start, end, radius);
-        }
-    }
+    PathTextDrawingContext context;
+    context.brush.Set(target.TextBrush());
+    context.geometry.Set(spGeometry);
+    context.d2DContext.Set(target.Context());
+
+    IDWriteTextLayout* pTextLayout = static_cast<const DWriteArcTextShape*>(fit.m_shape.get())->m_spTextLayout;
+    pTextLayout->Draw(&context, target.ArcTextRenderer(), 0, 0);
 }
 
 void Sunburst::RenderRings(DirectHwndRenderTarget& target, const SunburstMetrics& mx, const std::shared_ptr<Node>& highlight)
 {
+    TRACE_SCOPE("RenderRings");
+
     if (m_start_angles.empty())
         return;
 
+    if (!m_display_list)
+        BuildDisplayList(&target, mx);
+
     HighlightInfo highlightInfo;
 
-    // Two passes, so files are "beneath" everything else.
+    D2DDisplayListBackend backend(*this, *m_display_list, target, mx, highlight, highlightInfo);
+    m_display_list->m_list.Replay(backend);
+
+    if (highlight)
+    {
+        FLOAT end = m_start_angles[0];
+        for (size_t ii = m_roots.size(); ii--;)
+        {
+            const FLOAT start = m_start_angles[ii];
+
+            if (highlight == m_roots[ii])
+            {
+                highlightInfo.m_arc.m_node.reset();
+                highlightInfo.m_geometry.Release();
+                if (SUCCEEDED(MakeArcGeometry(target, start, end, 0.0f, mx.center_radius, &highlightInfo.m_geometry)))
+                    break;
+            }
 
-    RenderRingsInternal(target, mx, highlight, true/*files*/, highlightInfo);
-    RenderRingsInternal(target, mx, highlight, false/*files*/, highlightInfo);
+            end = start;
+        }
+    }
 
     // Hover highlight.
 
@@ -1489,136 +1634,293 @@ void Sunburst::RenderRings(DirectHwndRenderTarget& target, const SunburstMetrics
 
         target.Target()->DrawGeometry(highlightInfo.m_geometry, target.OutlineBrush(), mx.stroke * 2.5f, target.BevelStrokeStyle());
     }
+
+    if (m_arc_text_fits)
+    {
+        TRACE_COUNTER("arc text fit hits", m_arc_text_fits->Hits());
+        TRACE_COUNTER("arc text fit misses", m_arc_text_fits->Misses());
+    }
 }
 
-void Sunburst::RenderRingsInternal(DirectHwndRenderTarget& target, const SunburstMetrics& mx, const std::shared_ptr<Node>& highlight, bool files, HighlightInfo& highlightInfo)
+void Sunburst::SetSelection(const std::vector<std::shared_ptr<Node>>& selection)
 {
-    ID2D1RenderTarget* pTarget = target.Target();
-
-    assert(m_bounds.left < m_bounds.right);
-    assert(m_bounds.top < m_bounds.bottom);
-    assert(m_start_angles.size() == m_roots.size());
+    m_selection.clear();
+    for (const auto& node : selection)
+        m_selection.insert(node.get());
+}
 
-    // FUTURE: Direct2D documentation recommends caching a bitmap for performance,
-    // instead of caching geometries.  The highlight can be calculated on the fly
-    // as needed.
+static uint32_t argb_from_color(const D2D1_COLOR_F& color, FLOAT opacity=1.0f)
+{
+    return ((uint32_t(color.a * opacity * 255 + 0.5f) << 24) |
+            (uint32_t(color.r * 255 + 0.5f) << 16) |
+            (uint32_t(color.g * 255 + 0.5f) << 8) |
+            (uint32_t(color.b * 255 + 0.5f)));
+}
 
-    SPI<ID2D1Layer> spLayer;
-    D2D1_LAYER_PARAMETERS layerParams = D2D1::LayerParameters(
-        m_bounds, 0, D2D1_ANTIALIAS_MODE_ALIASED, D2D1::Matrix3x2F::Identity(), files ? 0.60f : 1.0f);
-    pTarget->CreateLayer(&spLayer);
-    pTarget->PushLayer(layerParams, spLayer);
+static D2D1_COLOR_F color_from_argb(uint32_t argb)
+{
+    return D2D1::ColorF(argb & 0x00ffffff, FLOAT(argb >> 24) / 255);
+}
 
-    ID2D1SolidColorBrush* pLineBrush = target.LineBrush();
-    ID2D1SolidColorBrush* pFileLineBrush = target.FileLineBrush();
-    ID2D1SolidColorBrush* pFillBrush = target.FillBrush();
+//----------------------------------------------------------------------------
+// Retained display list.
+//
+// The display list only depends on the layout and a few options, so while
+// those stay the same, a Sunburst keeps its list across paints, and a new
+// layout with the same result shares the previous one's list, along with the
+// Direct2D geometry that was created for it.
+
+struct Sunburst::DisplayListKey
+{
+    D2D1_RECT_F             m_bounds;
+    FLOAT                   m_stroke;
+    FLOAT                   m_margin;
+    FLOAT                   m_indicator_thickness;
+    FLOAT                   m_center_radius;
+    FLOAT                   m_max_radius;
+    FLOAT                   m_thicknesses[MAX_SUNBURST_DEPTH];
+    FLOAT                   m_font_size;
+    FLOAT                   m_min_arc_text_len;
+    size_t                  m_visible_files;
+    bool                    m_dark_mode;
+    bool                    m_show_names;
+    bool                    m_show_free_space;
+
+    bool                    operator==(const DisplayListKey& other) const;
+};
 
-    bool show_names = (g_show_names && target.DWriteFactory());
+bool Sunburst::DisplayListKey::operator==(const DisplayListKey& other) const
+{
+    return (!memcmp(&m_bounds, &other.m_bounds, sizeof(m_bounds)) &&
+            m_stroke == other.m_stroke &&
+            m_margin == other.m_margin &&
+            m_indicator_thickness == other.m_indicator_thickness &&
+            m_center_radius == other.m_center_radius &&
+            m_max_radius == other.m_max_radius &&
+            !memcmp(m_thicknesses, other.m_thicknesses, sizeof(m_thicknesses)) &&
+            m_font_size == other.m_font_size &&
+            m_min_arc_text_len == other.m_min_arc_text_len &&
+            m_visible_files == other.m_visible_files &&
+            m_dark_mode == other.m_dark_mode &&
+            m_show_names == other.m_show_names &&
+            m_show_free_space == other.m_show_free_space);
+}
 
-    // Outer boundary outline.
+struct Sunburst::RetainedDisplayList
+{
+    DisplayList             m_list;
+    DisplayListKey          m_key;
+    ID2D1Factory*           m_factory = nullptr; // The geometry belongs to this factory.
+    std::vector<SPI<ID2D1Geometry>> m_geometry; // Parallel to m_list; created on first use.
+};
 
-#ifdef USE_CHART_OUTLINE
-    if (!files)
+void Sunburst::MakeDisplayListKey(DirectHwndRenderTarget* target, const SunburstMetrics& mx, DisplayListKey& key) const
+{
+    key.m_bounds = m_bounds;
+    key.m_stroke = mx.stroke;
+    key.m_margin = mx.margin;
+    key.m_indicator_thickness = mx.indicator_thickness;
+    key.m_center_radius = mx.center_radius;
+    key.m_max_radius = mx.max_radius;
+    for (size_t depth = 0; depth < MAX_SUNBURST_DEPTH; ++depth)
+        key.m_thicknesses[depth] = mx.get_thickness(depth);
+    key.m_show_names = (g_show_names && target && target->DWriteFactory());
+    key.m_font_size = key.m_show_names ? target->ArcFontSize() : 0.0f;
+    key.m_min_arc_text_len = m_min_arc_text_len;
+    key.m_dark_mode = m_dark_mode;
+    key.m_show_free_space = m_show_free_space;
+
+    // Files are only drawn once their parent is finished, which the arcs
+    // themselves don't capture.  Parents only ever become finished, so the
+    // count is enough to notice a change.
+    key.m_visible_files = 0;
+    for (const auto& ring : m_rings)
     {
-        D2D1_ELLIPSE ellipse;
-        ellipse.point = m_center;
-        ellipse.radiusX = mx.boundary_radius;
-        ellipse.radiusY = mx.boundary_radius;
-
-        pFillBrush->SetColor(D2D1::ColorF(D2D1::ColorF::LightGray));
-        pTarget->DrawEllipse(ellipse, pFillBrush, mx.stroke);
+        for (const auto& arc : ring)
+        {
+            if (arc.m_node->AsFile() && arc.m_node->IsParentFinished())
+                ++key.m_visible_files;
+        }
     }
-#endif
+}
 
-    // Center circle or pie slices.
+bool Sunburst::SameLayout(const Sunburst& other) const
+{
+    if (memcmp(&m_bounds, &other.m_bounds, sizeof(m_bounds)) ||
+        m_max_extent != other.m_max_extent ||
+        !m_dpi.IsDpiEqual(other.m_dpi) ||
+        m_dark_mode != other.m_dark_mode ||
+        m_roots != other.m_roots ||
+        m_start_angles != other.m_start_angles ||
+        m_free_angles != other.m_free_angles ||
+        m_rings.size() != other.m_rings.size() ||
+        m_colors.size() != other.m_colors.size())
+        return false;
 
-    if (!files)
+    for (size_t depth = 0; depth < m_rings.size(); ++depth)
     {
-        D2D1_ELLIPSE ellipse;
-        ellipse.point = m_center;
-        ellipse.radiusX = mx.center_radius;
-        ellipse.radiusY = mx.center_radius;
-
-        SPI<ID2D1EllipseGeometry> spCircle;
-        if (SUCCEEDED(target.Factory()->CreateEllipseGeometry(ellipse, &spCircle)))
+        const std::vector<Arc>& a = m_rings[depth];
+        const std::vector<Arc>& b = other.m_rings[depth];
+        if (a.size() != b.size())
+            return false;
+        for (size_t ii = 0; ii < a.size(); ++ii)
         {
-            assert(m_free_angles.empty() || m_free_angles.size() == m_roots.size());
+            if (a[ii].m_start != b[ii].m_start ||
+                a[ii].m_end != b[ii].m_end ||
+                a[ii].m_node != b[ii].m_node ||
+                a[ii].m_finished != b[ii].m_finished)
+                return false;
+        }
 
-            if (m_roots.size() > 1 || (m_roots.size() == 1 && m_roots[0]->GetFreeSpace()))
-            {
-                FLOAT end = m_start_angles[0];
-                for (size_t ii = m_roots.size(); ii--;)
-                {
-                    const FLOAT start = m_start_angles[ii];
-                    const FLOAT free = m_free_angles.empty() ? end : m_free_angles[ii];
+        const std::vector<D2D1_COLOR_F>& ca = m_colors[depth];
+        const std::vector<D2D1_COLOR_F>& cb = other.m_colors[depth];
+        if (ca.size() != cb.size() || (ca.size() && memcmp(ca.data(), cb.data(), ca.size() * sizeof(ca[0]))))
+            return false;
+    }
 
-                    const bool isHighlight = is_highlight(highlight, m_roots[ii]);
+    return true;
+}
 
-                    SPI<ID2D1Geometry> spGeometry;
-                    if (SUCCEEDED(MakeArcGeometry(target, start, free, 0.0f, mx.center_radius, &spGeometry)))
-                    {
-                        pFillBrush->SetColor(MakeRootColor(isHighlight, false));
-                        pTarget->FillGeometry(spGeometry, pFillBrush);
-                        spGeometry.Release();
-                    }
-                    if (g_show_free_space &&
-                        (free != end) &&
-                        SUCCEEDED(MakeArcGeometry(target, free, end, 0.0f, mx.center_radius, &spGeometry)))
-                    {
-                        pFillBrush->SetColor(MakeRootColor(isHighlight, true));
-                        pTarget->FillGeometry(spGeometry, pFillBrush);
-                        spGeometry.Release();
-                    }
+void Sunburst::BuildDisplayList(DirectHwndRenderTarget* target, const SunburstMetrics& mx, const Sunburst* previous)
+{
+    TRACE_SCOPE("BuildDisplayList");
 
-                    end = start;
-                }
+    m_min_arc_text_len = FLOAT(m_dpiWithTextScaling.Scale(20));
 
-                if (m_roots.size() > 1)
-                {
-                    FLOAT prev = -1234.0f;
-                    pFillBrush->SetColor(MakeRootColor(false, true));
-                    for (size_t ii = m_roots.size(); ii--;)
-                    {
-                        const FLOAT angle = (m_free_angles.empty() ? m_start_angles[ii] : m_free_angles[ii]) + c_rotation;
-                        if (prev != angle)
-                            pTarget->DrawLine(m_center, MakePoint(m_center, mx.center_radius, angle), pFillBrush, mx.stroke);
-                        prev = angle;
-                    }
-                }
-            }
-            else
-            {
-                const bool isHighlight = (m_roots.size() && is_highlight(highlight, m_roots[0]));
-                pFillBrush->SetColor(MakeRootColor(isHighlight, false));
-                pTarget->FillGeometry(spCircle, pFillBrush);
-            }
+    DisplayListKey key;
+    MakeDisplayListKey(target, mx, key);
 
-            pTarget->DrawGeometry(spCircle, pLineBrush, mx.stroke);
-        }
+    if (m_display_list && m_display_list->m_key == key)
+        return;
 
-        if (highlight)
-        {
+    if (previous && previous != this && previous->m_display_list &&
+        previous->m_display_list->m_key == key && SameLayout(*previous))
+    {
+        m_display_list = previous->m_display_list;
+        return;
+    }
+
+    std::shared_ptr<RetainedDisplayList> retained = std::make_shared<RetainedDisplayList>();
+    retained->m_key = key;
+    if (!m_start_angles.empty())
+    {
+        // Two layers, so files are "beneath" everything else.
+        AddDisplayCommands(target, mx, true/*files*/, retained->m_list);
+        AddDisplayCommands(target, mx, false/*files*/, retained->m_list);
+    }
+    m_display_list = std::move(retained);
+
+    TRACE_COUNTER("display list commands", m_display_list->m_list.Count());
+}
+
+const DisplayList* Sunburst::GetDisplayList() const
+{
+    return m_display_list ? &m_display_list->m_list : nullptr;
+}
+
+void Sunburst::AddDisplayCommands(DirectHwndRenderTarget* target, const SunburstMetrics& mx, const bool files, DisplayList& list)
+{
+    assert(m_bounds.left < m_bounds.right);
+    assert(m_bounds.top < m_bounds.bottom);
+    assert(m_start_angles.size() == m_roots.size());
+
+    const uint32_t line = argb_from_color(D2D1::ColorF(m_dark_mode ? 0x444444 : 0x000000, 1.0f));
+    const uint32_t file_line = argb_from_color(D2D1::ColorF(0x444444, 0.5f));
+
+    DisplayCommand cmd = {};
+    list.BeginLayer(files ? 0.60f : 1.0f);
+
+    // Outer boundary outline.
+
+#ifdef USE_CHART_OUTLINE
+    if (!files)
+    {
+        cmd = DisplayCommand();
+        cmd.m_op = DOP_CIRCLE;
+        cmd.m_outer = mx.boundary_radius;
+        cmd.m_line = argb_from_color(D2D1::ColorF(D2D1::ColorF::LightGray));
+        cmd.m_stroke = mx.stroke;
+        list.Add(cmd);
+    }
+#endif
+
+    // Center circle or pie slices.
+
+    if (!files)
+    {
+        assert(m_free_angles.empty() || m_free_angles.size() == m_roots.size());
+
+        if (m_roots.size() > 1 || (m_roots.size() == 1 && m_roots[0]->GetFreeSpace()))
+        {
             FLOAT end = m_start_angles[0];
             for (size_t ii = m_roots.size(); ii--;)
             {
                 const FLOAT start = m_start_angles[ii];
-
-                if (highlight == m_roots[ii])
+                const FLOAT free = m_free_angles.empty() ? end : m_free_angles[ii];
+
+                cmd = DisplayCommand();
+                cmd.m_op = DOP_SECTOR;
+                cmd.m_flags = DCF_ROOT;
+                cmd.m_index = uint32_t(ii);
+                cmd.m_start = start;
+                cmd.m_end = free;
+                cmd.m_outer = mx.center_radius;
+                cmd.m_fill = argb_from_color(MakeRootColor(false, false));
+                list.Add(cmd);
+
+                if (m_show_free_space && free != end)
                 {
-                    highlightInfo.m_arc.m_node.reset();
-                    highlightInfo.m_geometry.Release();
-                    if (SUCCEEDED(MakeArcGeometry(target, start, end, 0.0f, mx.center_radius, &highlightInfo.m_geometry)))
-                        break;
+                    cmd.m_flags = DCF_ROOT|DCF_FREE;
+                    cmd.m_start = free;
+                    cmd.m_end = end;
+                    cmd.m_fill = argb_from_color(MakeRootColor(false, true));
+                    list.Add(cmd);
                 }
 
                 end = start;
             }
+
+            if (m_roots.size() > 1)
+            {
+                FLOAT prev = -1234.0f;
+                for (size_t ii = m_roots.size(); ii--;)
+                {
+                    const FLOAT angle = m_free_angles.empty() ? m_start_angles[ii] : m_free_angles[ii];
+                    if (prev != angle)
+                    {
+                        cmd = DisplayCommand();
+                        cmd.m_op = DOP_SPOKE;
+                        cmd.m_start = angle;
+                        cmd.m_end = angle;
+                        cmd.m_outer = mx.center_radius;
+                        cmd.m_line = argb_from_color(MakeRootColor(false, true));
+                        cmd.m_stroke = mx.stroke;
+                        list.Add(cmd);
+                    }
+                    prev = angle;
+                }
+            }
+
+            cmd = DisplayCommand();
+            cmd.m_op = DOP_CIRCLE;
+        }
+        else
+        {
+            cmd = DisplayCommand();
+            cmd.m_op = DOP_CIRCLE;
+            cmd.m_flags = DCF_ROOT;
+            cmd.m_fill = argb_from_color(MakeRootColor(false, false));
         }
+
+        cmd.m_outer = mx.center_radius;
+        cmd.m_line = line;
+        cmd.m_stroke = mx.stroke;
+        list.Add(cmd);
     }
 
     // Rings.
 
-    m_min_arc_text_len = FLOAT(m_dpiWithTextScaling.Scale(20));
+    bool show_names = (g_show_names && target && target->DWriteFactory());
 
     size_t depth;
     FLOAT inner_radius = mx.center_radius;
@@ -1628,43 +1930,53 @@ void Sunburst::RenderRingsInternal(DirectHwndRenderTarget& target, const Sunburs
         if (thickness <= 0.0f)
             break;
 
-        if (thickness < target.ArcFontSize() + m_dpiWithTextScaling.Scale(4))
+        if (show_names && thickness < target->ArcFontSize() + m_dpiWithTextScaling.Scale(4))
             show_names = false;
 
         const FLOAT outer_radius = inner_radius + thickness;
         if (outer_radius > mx.max_radius)
             break;
 
-        const FLOAT arctext_radius = outer_radius - target.ArcFontSize();
+        const FLOAT arctext_radius = show_names ? outer_radius - target->ArcFontSize() : 0.0f;
 
-        for (const auto arc : m_rings[depth])
+        const std::vector<Arc>& ring = m_rings[depth];
+        for (size_t index = 0; index < ring.size(); ++index)
         {
+            const Arc& arc = ring[index];
             const bool isFile = !!arc.m_node->AsFile();
             if (isFile != files)
                 continue;
             if (isFile && !arc.m_node->IsParentFinished())
                 continue;
 
-            SPI<ID2D1Geometry> spGeometry;
-            const bool isHighlight = is_highlight(highlight, arc.m_node);
-            if (SUCCEEDED(MakeArcGeometry(target, arc.m_start, arc.m_end, inner_radius, outer_radius, &spGeometry)))
+            cmd = DisplayCommand();
+            cmd.m_op = DOP_SECTOR;
+            cmd.m_flags = (isFile ? DCF_FILE : DCF_NONE) | (show_names ? DCF_NAMES : DCF_NONE);
+            cmd.m_depth = uint16_t(depth);
+            cmd.m_index = uint32_t(index);
+            cmd.m_start = arc.m_start;
+            cmd.m_end = arc.m_end;
+            cmd.m_inner = inner_radius;
+            cmd.m_outer = outer_radius;
+            cmd.m_fill = argb_from_color(m_colors[depth][index]);
+            cmd.m_line = isFile ? file_line : line;
+            cmd.m_stroke = mx.stroke;
+
+            // A heavier outline sets mounted volumes apart.
+            if (arc.m_node->IsMountPoint())
             {
-                pFillBrush->SetColor(MakeColor(arc, depth, isHighlight));
-
-                pTarget->FillGeometry(spGeometry, pFillBrush);
-                pTarget->DrawGeometry(spGeometry, isFile ? pFileLineBrush : pLineBrush, mx.stroke);
+                cmd.m_flags |= DCF_MOUNT_POINT;
+                cmd.m_stroke = mx.stroke * 3;
+            }
 
-                if (show_names)
-                    DrawArcText(target, arc, arctext_radius);
+            list.Add(cmd);
 
-                if (isHighlight)
-                {
-                    highlightInfo.m_arc = arc;
-                    highlightInfo.m_geometry.Set(spGeometry);
-                    highlightInfo.m_depth = depth;
-                    highlightInfo.m_arctext_radius = arctext_radius;
-                    highlightInfo.m_show_names = show_names;
-                }
+            if (show_names && ArcLength(arc.m_end - arc.m_start, arctext_radius) >= m_min_arc_text_len)
+            {
+                cmd.m_op = DOP_LABEL;
+                cmd.m_inner = arctext_radius;
+                cmd.m_outer = arctext_radius;
+                list.Add(cmd);
             }
         }
 
@@ -1678,28 +1990,202 @@ void Sunburst::RenderRingsInternal(DirectHwndRenderTarget& target, const Sunburs
         inner_radius += mx.margin;
         const FLOAT outer_radius = inner_radius + mx.indicator_thickness;
 
-        for (const auto arc : m_rings[depth])
+        const uint32_t back = argb_from_color(D2D1::ColorF(GetBackColor(m_dark_mode)));
+        const std::vector<Arc>& ring = m_rings[depth];
+        for (size_t index = 0; index < ring.size(); ++index)
         {
+            const Arc& arc = ring[index];
             const bool isFile = !!arc.m_node->AsFile();
             if (isFile != files)
                 continue;
             if (isFile && !arc.m_node->IsParentFinished())
                 continue;
 
-            SPI<ID2D1Geometry> spGeometry;
-            if (SUCCEEDED(MakeArcGeometry(target, arc.m_start, arc.m_end, inner_radius, outer_radius, &spGeometry)))
+            cmd = DisplayCommand();
+            cmd.m_op = DOP_INDICATOR;
+            cmd.m_flags = isFile ? DCF_FILE : DCF_NONE;
+            cmd.m_depth = uint16_t(depth);
+            cmd.m_index = uint32_t(index);
+            cmd.m_start = arc.m_start;
+            cmd.m_end = arc.m_end;
+            cmd.m_inner = inner_radius;
+            cmd.m_outer = outer_radius;
+            cmd.m_fill = argb_from_color(D2D1::ColorF(isFile ? 0x999999 : 0x555555));
+            cmd.m_line = back;
+            cmd.m_stroke = mx.stroke / 2;
+            list.Add(cmd);
+        }
+    }
+}
+
+//----------------------------------------------------------------------------
+// D2DDisplayListBackend.
+//
+// Replays a display list with Direct2D, reusing the list's cached geometry.
+// Highlighted and selected arcs are patched on the fly, so hovering never
+// changes the list itself.
+
+class D2DDisplayListBackend : public DisplayListBackend
+{
+public:
+                            D2DDisplayListBackend(Sunburst& sunburst, Sunburst::RetainedDisplayList& retained, DirectHwndRenderTarget& target, const SunburstMetrics& mx, const std::shared_ptr<Node>& highlight, Sunburst::HighlightInfo& highlightInfo);
+
+    void                    BeginLayer(float opacity) override;
+    void                    EndLayer() override;
+    void                    Draw(size_t index, const DisplayCommand& cmd) override;
+
+private:
+    ID2D1Geometry*          GetGeometry(size_t index, const DisplayCommand& cmd);
+
+private:
+    Sunburst&               m_sunburst;
+    Sunburst::RetainedDisplayList& m_retained;
+    DirectHwndRenderTarget& m_target;
+    const SunburstMetrics&  m_mx;
+    const std::shared_ptr<Node>& m_highlight;
+    Sunburst::HighlightInfo& m_highlightInfo;
+    SPI<ID2D1Layer>         m_spLayer;
+};
+
+D2DDisplayListBackend::D2DDisplayListBackend(Sunburst& sunburst, Sunburst::RetainedDisplayList& retained, DirectHwndRenderTarget& target, const SunburstMetrics& mx, const std::shared_ptr<Node>& highlight, Sunburst::HighlightInfo& highlightInfo)
+: m_sunburst(sunburst)
+, m_retained(retained)
+, m_target(target)
+, m_mx(mx)
+, m_highlight(highlight)
+, m_highlightInfo(highlightInfo)
+{
+    if (m_retained.m_factory != target.Factory())
+    {
+        m_retained.m_geometry.clear();
+        m_retained.m_factory = target.Factory();
+    }
+    if (m_retained.m_geometry.size() != m_retained.m_list.Count())
+        m_retained.m_geometry.resize(m_retained.m_list.Count());
+}
+
+void D2DDisplayListBackend::BeginLayer(const float opacity)
+{
+    // FUTURE: Direct2D documentation recommends caching a bitmap for performance,
+    // instead of caching geometries.  The highlight can be calculated on the fly
+    // as needed.
+
+    ID2D1RenderTarget* pTarget = m_target.Target();
+    D2D1_LAYER_PARAMETERS layerParams = D2D1::LayerParameters(
+        m_sunburst.m_bounds, 0, D2D1_ANTIALIAS_MODE_ALIASED, D2D1::Matrix3x2F::Identity(), opacity);
+    m_spLayer.Release();
+    pTarget->CreateLayer(&m_spLayer);
+    pTarget->PushLayer(layerParams, m_spLayer);
+}
+
+void D2DDisplayListBackend::EndLayer()
+{
+    m_target.Target()->PopLayer();
+    m_spLayer.Release();
+}
+
+ID2D1Geometry* D2DDisplayListBackend::GetGeometry(const size_t index, const DisplayCommand& cmd)
+{
+    SPI<ID2D1Geometry>& spGeometry = m_retained.m_geometry[index];
+    if (!spGeometry)
+        m_sunburst.MakeArcGeometry(m_target, cmd.m_start, cmd.m_end, cmd.m_inner, cmd.m_outer, &spGeometry);
+    return spGeometry;
+}
+
+void D2DDisplayListBackend::Draw(const size_t index, const DisplayCommand& cmd)
+{
+    ID2D1RenderTarget* pTarget = m_target.Target();
+    ID2D1SolidColorBrush* pFillBrush = m_target.FillBrush();
+
+    switch (cmd.m_op)
+    {
+    case DOP_SECTOR:
+        {
+            ID2D1Geometry* pGeometry = GetGeometry(index, cmd);
+            if (!pGeometry)
+                break;
+
+            if (cmd.m_flags & DCF_ROOT)
             {
-                pFillBrush->SetColor(D2D1::ColorF(isFile ? 0x999999 : 0x555555));
-                pTarget->FillGeometry(spGeometry, pFillBrush);
+                const bool isHighlight = is_highlight(m_highlight, m_sunburst.m_roots[cmd.m_index]);
+                pFillBrush->SetColor(isHighlight ? m_sunburst.MakeRootColor(true, !!(cmd.m_flags & DCF_FREE)) : color_from_argb(cmd.m_fill));
+                pTarget->FillGeometry(pGeometry, pFillBrush);
+                break;
+            }
 
-                pFillBrush->SetColor(D2D1::ColorF(GetBackColor(m_dark_mode)));
-                pTarget->DrawGeometry(spGeometry, pFillBrush, mx.stroke / 2);
+            const Sunburst::Arc& arc = m_sunburst.m_rings[cmd.m_depth][cmd.m_index];
+            const bool isHighlight = is_highlight(m_highlight, arc.m_node);
+            const bool isSelected = (!m_sunburst.m_selection.empty() && m_sunburst.m_selection.count(arc.m_node.get()));
+
+            pFillBrush->SetColor((isHighlight || isSelected) ? m_sunburst.MakeColor(arc, cmd.m_depth, true) : color_from_argb(cmd.m_fill));
+            pTarget->FillGeometry(pGeometry, pFillBrush);
+
+            // A heavier outline sets selected arcs apart.
+            if (isSelected)
+            {
+                pTarget->DrawGeometry(pGeometry, m_target.OutlineBrush(), m_mx.stroke * 3);
+            }
+            else
+            {
+                pFillBrush->SetColor(color_from_argb(cmd.m_line));
+                pTarget->DrawGeometry(pGeometry, pFillBrush, cmd.m_stroke);
+            }
+
+            if (isHighlight)
+            {
+                m_highlightInfo.m_arc = arc;
+                m_highlightInfo.m_geometry.Set(pGeometry);
+                m_highlightInfo.m_depth = cmd.m_depth;
+                m_highlightInfo.m_show_names = !!(cmd.m_flags & DCF_NAMES);
+                m_highlightInfo.m_arctext_radius = m_highlightInfo.m_show_names ? cmd.m_outer - m_target.ArcFontSize() : 0.0f;
             }
         }
+        break;
 
-    }
+    case DOP_CIRCLE:
+        {
+            D2D1_ELLIPSE ellipse;
+            ellipse.point = m_sunburst.m_center;
+            ellipse.radiusX = cmd.m_outer;
+            ellipse.radiusY = cmd.m_outer;
+
+            if (cmd.m_fill >> 24)
+            {
+                const bool isHighlight = ((cmd.m_flags & DCF_ROOT) && is_highlight(m_highlight, m_sunburst.m_roots[cmd.m_index]));
+                pFillBrush->SetColor(isHighlight ? m_sunburst.MakeRootColor(true, false) : color_from_argb(cmd.m_fill));
+                pTarget->FillEllipse(ellipse, pFillBrush);
+            }
+            if (cmd.m_stroke > 0.0f)
+            {
+                pFillBrush->SetColor(color_from_argb(cmd.m_line));
+                pTarget->DrawEllipse(ellipse, pFillBrush, cmd.m_stroke);
+            }
+        }
+        break;
+
+    case DOP_SPOKE:
+        pFillBrush->SetColor(color_from_argb(cmd.m_line));
+        pTarget->DrawLine(m_sunburst.m_center, MakePoint(m_sunburst.m_center, cmd.m_outer, cmd.m_start + c_rotation), pFillBrush, cmd.m_stroke);
+        break;
+
+    case DOP_LABEL:
+        m_sunburst.DrawArcText(m_target, m_sunburst.m_rings[cmd.m_depth][cmd.m_index], cmd.m_outer);
+        break;
+
+    case DOP_INDICATOR:
+        {
+            ID2D1Geometry* pGeometry = GetGeometry(index, cmd);
+            if (!pGeometry)
+                break;
 
-    pTarget->PopLayer();
+            pFillBrush->SetColor(color_from_argb(cmd.m_fill));
+            pTarget->FillGeometry(pGeometry, pFillBrush);
+
+            pFillBrush->SetColor(color_from_argb(cmd.m_line));
+            pTarget->DrawGeometry(pGeometry, pFillBrush, cmd.m_stroke);
+        }
+        break;
+    }
 }
 
 void Sunburst::FormatSize(const ULONGLONG size, std::wstring& text, std::wstring& units, int places)
@@ -1707,8 +2193,514 @@ void Sunburst::FormatSize(const ULONGLONG size, std::wstring& text, std::wstring
     ::FormatSize(size, text, units, m_units, places);
 }
 
+static void add_raster_arc(RasterRing& ring, FLOAT start, FLOAT end, uint32_t fill, uint32_t line, FLOAT stroke)
+{
+    RasterArc arc;
+    arc.m_start = start;
+    arc.m_end = (end <= start) ? end + 360.0f : end;
+    arc.m_fill = fill;
+    arc.m_line = line;
+    arc.m_stroke = stroke;
+    ring.m_arcs.emplace_back(arc);
+}
+
+void Sunburst::MakeRasterScene(const SunburstMetrics& mx, RasterScene& scene)
+{
+    // This mirrors AddDisplayCommands, without highlights, selection, or
+    // names, for drawing with the software rasterizer.
+
+    scene = RasterScene();
+    scene.m_cx = m_center.x - m_bounds.left;
+    scene.m_cy = m_center.y - m_bounds.top;
+    scene.m_rotation = c_rotation;
+    scene.m_background = argb_from_color(D2D1::ColorF(GetBackColor(m_dark_mode)));
+
+    if (m_start_angles.empty())
+        return;
+
+    const uint32_t line = argb_from_color(D2D1::ColorF(m_dark_mode ? 0x444444 : 0x000000, 1.0f));
+    const FLOAT file_opacity = 0.60f;
+    const uint32_t file_line = argb_from_color(D2D1::ColorF(0x444444, 0.5f), file_opacity);
+
+    // Center circle or pie slices.
+
+    RasterRing center;
+    center.m_outer = mx.center_radius;
+    center.m_outline = line;
+    center.m_outline_stroke = mx.stroke;
+
+    if (m_roots.size() > 1 || (m_roots.size() == 1 && m_roots[0]->GetFreeSpace()))
+    {
+        FLOAT end = m_start_angles[0];
+        for (size_t ii = m_roots.size(); ii--;)
+        {
+            const FLOAT start = m_start_angles[ii];
+            const FLOAT free = m_free_angles.empty() ? end : m_free_angles[ii];
+
+            add_raster_arc(center, start, free, argb_from_color(MakeRootColor(false, false)), 0, 0.0f);
+            if (m_show_free_space && free != end)
+                add_raster_arc(center, free, end, argb_from_color(MakeRootColor(false, true)), 0, 0.0f);
+
+            if (m_roots.size() > 1)
+            {
+                RasterSpoke spoke;
+                spoke.m_angle = m_free_angles.empty() ? start : m_free_angles[ii];
+                spoke.m_radius = mx.center_radius;
+                spoke.m_line = argb_from_color(MakeRootColor(false, true));
+                spoke.m_stroke = mx.stroke;
+                scene.m_spokes.emplace_back(spoke);
+            }
+
+            end = start;
+        }
+
+        std::sort(center.m_arcs.begin(), center.m_arcs.end(), [](const RasterArc& a, const RasterArc& b) {
+            return a.m_start < b.m_start;
+        });
+    }
+    else
+    {
+        add_raster_arc(center, 0.0f, 360.0f, argb_from_color(MakeRootColor(false, false)), 0, 0.0f);
+    }
+
+    scene.m_rings.emplace_back(std::move(center));
+
+    // Rings.
+
+    size_t depth;
+    FLOAT inner_radius = mx.center_radius;
+    for (depth = 0; depth < m_rings.size(); ++depth)
+    {
+        const FLOAT thickness = mx.get_thickness(depth);
+        if (thickness <= 0.0f)
+            break;
+
+        const FLOAT outer_radius = inner_radius + thickness;
+        if (outer_radius > mx.max_radius)
+            break;
+
+        RasterRing ring;
+        ring.m_inner = inner_radius;
+        ring.m_outer = outer_radius;
+
+        const std::vector<Arc>& arcs = m_rings[depth];
+        for (size_t index = 0; index < arcs.size(); ++index)
+        {
+            const Arc& arc = arcs[index];
+            const bool isFile = !!arc.m_node->AsFile();
+            if (isFile && !arc.m_node->IsParentFinished())
+                continue;
+
+            const FLOAT stroke = arc.m_node->IsMountPoint() ? mx.stroke * 3 : mx.stroke;
+            add_raster_arc(ring, arc.m_start, arc.m_end,
+                           argb_from_color(m_colors[depth][index], isFile ? file_opacity : 1.0f),
+                           isFile ? file_line : line, stroke);
+        }
+
+        scene.m_rings.emplace_back(std::move(ring));
+        inner_radius = outer_radius;
+    }
+
+    // "More" indicators.
+
+    if (depth < m_rings.size())
+    {
+        RasterRing ring;
+        ring.m_inner = inner_radius + mx.margin;
+        ring.m_outer = ring.m_inner + mx.indicator_thickness;
+
+        const D2D1_COLOR_F back = D2D1::ColorF(GetBackColor(m_dark_mode));
+        for (const auto& arc : m_rings[depth])
+        {
+            const bool isFile = !!arc.m_node->AsFile();
+            if (isFile && !arc.m_node->IsParentFinished())
+                continue;
+
+            add_raster_arc(ring, arc.m_start, arc.m_end,
+                           argb_from_color(D2D1::ColorF(isFile ? 0x999999 : 0x555555), isFile ? file_opacity : 1.0f),
+                           argb_from_color(back, isFile ? file_opacity : 1.0f), mx.stroke / 2);
+        }
+
+        scene.m_rings.emplace_back(std::move(ring));
+    }
+}
+
+static ULONGLONG svg_node_size(const Node* node)
+{
+    if (const DirNode* dir = node->AsDir())
+        return dir->GetSize();
+    if (const FileNode* file = node->AsFile())
+        return file->GetSize();
+    if (const FreeSpaceNode* free = node->AsFreeSpace())
+        return free->GetFreeSize();
+    return 0;
+}
+
+static void write_svg_fill(StreamWriter& out, const D2D1_COLOR_F& color)
+{
+    out.Format(" fill=\"#%02x%02x%02x\"", UINT(color.r * 255 + 0.5f), UINT(color.g * 255 + 0.5f), UINT(color.b * 255 + 0.5f));
+    if (color.a < 1.0f)
+        out.Format(" fill-opacity=\"%.2f\"", color.a);
+}
+
+static void write_svg_arc_segments(StreamWriter& out, const D2D1_POINT_2F& center, FLOAT radius, FLOAT start, FLOAT end, bool counter_clockwise)
+{
+    // SVG arcs are ambiguous at 180 degrees and degenerate at 360 degrees, so
+    // long arcs are split into pieces.
+    const FLOAT span = end - start;
+    const int pieces = std::max<int>(1, int(ceilf(span / 120.0f)));
+    for (int ii = 1; ii <= pieces; ++ii)
+    {
+        const FLOAT angle = counter_clockwise ? end - span * ii / pieces : start + span * ii / pieces;
+        const D2D1_POINT_2F point = MakePoint(center, radius, angle + c_rotation);
+        out.Format("A%.2f %.2f 0 0 %d %.2f %.2f", radius, radius, counter_clockwise ? 0 : 1, point.x, point.y);
+    }
+}
+
+void Sunburst::WriteSvgArc(StreamWriter& out, FLOAT start, FLOAT end, FLOAT inner_radius, FLOAT outer_radius)
+{
+    if (end < start)
+        end += 360.0f;
+
+    const D2D1_POINT_2F center = D2D1::Point2F(m_center.x - m_bounds.left, m_center.y - m_bounds.top);
+    const D2D1_POINT_2F outer_start_point = MakePoint(center, outer_radius, start + c_rotation);
+
+    if (inner_radius <= 0.0f)
+    {
+        out.Format("M%.2f %.2fL%.2f %.2f", center.x, center.y, outer_start_point.x, outer_start_point.y);
+        write_svg_arc_segments(out, center, outer_radius, start, end, false);
+    }
+    else
+    {
+        const D2D1_POINT_2F inner_end_point = MakePoint(center, inner_radius, end + c_rotation);
+        out.Format("M%.2f %.2f", outer_start_point.x, outer_start_point.y);
+        write_svg_arc_segments(out, center, outer_radius, start, end, false);
+        out.Format("L%.2f %.2f", inner_end_point.x, inner_end_point.y);
+        write_svg_arc_segments(out, center, inner_radius, start, end, true);
+    }
+    out.Write("Z");
+}
+
+static void write_svg_title(StreamWriter& out, const UnitScale scale, const Node* node, const ULONGLONG size, const ULONGLONG merged, const ULONGLONG files, const ULONGLONG dirs)
+{
+    std::wstring text;
+    std::wstring units;
+
+    out.Write("<title>");
+    if (merged)
+    {
+        out.Format("%llu small items", merged);
+    }
+    else
+    {
+        node->GetFullPath(text);
+        out.WriteXmlText(text.c_str());
+    }
+
+    // Same units as the window (see Sunburst::FormatSize).
+    ::FormatSize(size, text, units, scale);
+    out.Write("&#10;");
+    out.WriteXmlText(text.c_str());
+    out.Write(" ");
+    out.WriteXmlText(units.c_str());
+
+    if (node && node->AsDir())
+    {
+        FormatCount(files, text);
+        out.Write("&#10;");
+        out.WriteXmlText(text.c_str());
+        out.Write(" files, ");
+        FormatCount(dirs, text);
+        out.WriteXmlText(text.c_str());
+        out.Write(" dirs");
+    }
+    out.Write("</title>");
+}
+
+void Sunburst::WriteSvgRings(DirectHwndRenderTarget* target, const SunburstMetrics& mx, bool files, StreamWriter& out, size_t& labels)
+{
+    // This follows AddDisplayCommands, but streams each arc as it goes.
+
+    out.Write(files ? "<g opacity=\"0.6\">\n" : "<g>\n");
+
+    const D2D1_POINT_2F center = D2D1::Point2F(m_center.x - m_bounds.left, m_center.y - m_bounds.top);
+
+    // Center circle or pie slices.
+
+    if (!files)
+    {
+        if (m_roots.size() > 1 || (m_roots.size() == 1 && m_svg_roots[0].m_free))
+        {
+            FLOAT end = m_start_angles[0];
+            for (size_t ii = m_roots.size(); ii--;)
+            {
+                const FLOAT start = m_start_angles[ii];
+                const FLOAT free = m_free_angles.empty() ? end : m_free_angles[ii];
+                const SvgRootData& root = m_svg_roots[ii];
+
+                out.Write("<path");
+                write_svg_fill(out, MakeRootColor(false, false));
+                out.Write(" d=\"");
+                WriteSvgArc(out, start, free, 0.0f, mx.center_radius);
+                out.Format("\" data-size=\"%llu\">", root.m_size);
+                write_svg_title(out, m_units, m_roots[ii].get(), root.m_size, 0, root.m_files, root.m_dirs);
+                out.Write("</path>\n");
+
+                if (m_show_free_space && root.m_free && free != end)
+                {
+                    out.Write("<path");
+                    write_svg_fill(out, MakeRootColor(false, true));
+                    out.Write(" d=\"");
+                    WriteSvgArc(out, free, end, 0.0f, mx.center_radius);
+                    out.Format("\" data-size=\"%llu\">", root.m_free_size);
+                    write_svg_title(out, m_units, root.m_free.get(), root.m_free_size, 0, 0, 0);
+                    out.Write("</path>\n");
+                }
+
+                end = start;
+            }
+
+            if (m_roots.size() > 1)
+            {
+                const D2D1_COLOR_F color = MakeRootColor(false, true);
+                out.Format("<path stroke=\"#%02x%02x%02x\" stroke-width=\"%.2f\" d=\"", UINT(color.r * 255 + 0.5f), UINT(color.g * 255 + 0.5f), UINT(color.b * 255 + 0.5f), mx.stroke);
+                for (size_t ii = m_roots.size(); ii--;)
+                {
+                    const FLOAT angle = (m_free_angles.empty() ? m_start_angles[ii] : m_free_angles[ii]) + c_rotation;
+                    const D2D1_POINT_2F point = MakePoint(center, mx.center_radius, angle);
+                    out.Format("M%.2f %.2fL%.2f %.2f", center.x, center.y, point.x, point.y);
+                }
+                out.Write("\"/>\n");
+            }
+        }
+        else
+        {
+            out.Format("<circle cx=\"%.2f\" cy=\"%.2f\" r=\"%.2f\"", center.x, center.y, mx.center_radius);
+            write_svg_fill(out, MakeRootColor(false, false));
+            out.Write(">");
+            if (m_roots.size())
+                write_svg_title(out, m_units, m_roots[0].get(), m_svg_roots[0].m_size, 0, m_svg_roots[0].m_files, m_svg_roots[0].m_dirs);
+            out.Write("</circle>\n");
+        }
+
+        out.Format("<circle class=\"d\" fill=\"none\" cx=\"%.2f\" cy=\"%.2f\" r=\"%.2f\"/>\n", center.x, center.y, mx.center_radius);
+    }
+
+    // Rings.
+
+    bool show_names = (g_show_names && target && target->DWriteFactory());
+    ArcTextFit uncached;
+
+    size_t depth;
+    FLOAT inner_radius = mx.center_radius;
+    for (depth = 0; depth < m_rings.size(); ++depth)
+    {
+        const FLOAT thickness = mx.get_thickness(depth);
+        if (thickness <= 0.0f)
+            break;
+
+        if (show_names && thickness < target->ArcFontSize() + m_dpiWithTextScaling.Scale(4))
+            show_names = false;
+
+        const FLOAT outer_radius = inner_radius + thickness;
+        if (outer_radius > mx.max_radius)
+            break;
+
+        const FLOAT arctext_radius = show_names ? outer_radius - target->ArcFontSize() : 0.0f;
+
+        const std::vector<Arc>& ring = m_rings[depth];
+        const std::vector<SvgNodeData>& data = m_svg_rings[depth];
+        for (size_t index = 0; index < ring.size(); ++index)
+        {
+            const Arc& arc = ring[index];
+            const bool isFile = !!arc.m_node->AsFile();
+            if (isFile != files)
+                continue;
+            if (!data[index].m_visible)
+                continue;
+
+            // Merge runs of adjacent sub-pixel arcs into one path.  In very
+            // large layouts most arcs are slivers, and each one would
+            // otherwise cost a whole element plus its metadata.
+            const size_t first = index;
+            FLOAT end = arc.m_end;
+            ULONGLONG size = data[index].m_size;
+            ULONGLONG merged = 0;
+            if (ArcLength(arc.m_end - arc.m_start, outer_radius) < 1.0f)
+            {
+                while (index + 1 < ring.size() && ArcLength(end - arc.m_start, outer_radius) < 1.0f)
+                {
+                    const Arc& next = ring[index + 1];
+                    if (!!next.m_node->AsFile() != files || !data[index + 1].m_visible)
+                        break;
+                    if (next.m_start - end > 0.001f || ArcLength(next.m_end - next.m_start, outer_radius) >= 1.0f)
+                        break;
+
+                    merged = merged ? merged + 1 : 2;
+                    size += data[index + 1].m_size;
+                    end = next.m_end;
+                    ++index;
+                }
+            }
+
+            out.Write(isFile ? "<path class=\"f" : "<path class=\"d");
+            if (!merged && arc.m_node->IsMountPoint())
+                out.Write(" m");
+            out.Write("\"");
+            write_svg_fill(out, m_colors[depth][first]);
+            out.Write(" d=\"");
+            WriteSvgArc(out, arc.m_start, end, inner_radius, outer_radius);
+            out.Format("\" data-size=\"%llu\"", size);
+            if (merged)
+                out.Format(" data-count=\"%llu\"", merged);
+            else if (arc.m_node->AsDir())
+                out.Format(" data-files=\"%llu\" data-dirs=\"%llu\"", data[first].m_files, data[first].m_dirs);
+            out.Write(">");
+            write_svg_title(out, m_units, merged ? nullptr : arc.m_node.get(), size, merged, data[first].m_files, data[first].m_dirs);
+            out.Write("</path>\n");
+
+            // Names use the same fit rules as DrawArcText, so the export
+            // shows the same labels as the window.
+            if (show_names && !merged && ArcLength(arc.m_end - arc.m_start, arctext_radius) >= m_min_arc_text_len)
+            {
+                DWriteArcTextMeasurer measurer(*this, *target, target->DWriteFactory());
+                const WCHAR* name = arc.m_node->GetName();
+                if (!m_arc_text_fits)
+                    FitArcText(measurer, name, arc.m_end - arc.m_start, arctext_radius, uncached);
+                const ArcTextFit& fit = (m_arc_text_fits ?
+                                         m_arc_text_fits->Fit(measurer, name, target->ArcFontSize(), arc.m_end - arc.m_start, arctext_radius) :
+                                         uncached);
+                if (fit.m_fits)
+                {
+                    const D2D1_POINT_2F start_point = MakePoint(center, arctext_radius, arc.m_start + c_rotation);
+                    out.Format("<path id=\"t%zu\" fill=\"none\" d=\"M%.2f %.2f", labels, start_point.x, start_point.y);
+                    write_svg_arc_segments(out, center, arctext_radius, arc.m_start, arc.m_end, false);
+                    out.Format("\"/><text class=\"t\"><textPath xlink:href=\"#t%zu\">", labels);
+                    out.WriteXmlText(fit.m_text.c_str());
+                    out.Write("</textPath></text>\n");
+                    ++labels;
+                }
+            }
+        }
+
+        inner_radius = outer_radius;
+    }
+
+    // "More" indicators.  They all look alike, so adjacent ones are merged
+    // regardless of size.
+
+    if (depth < m_rings.size())
+    {
+        inner_radius += mx.margin;
+        const FLOAT outer_radius = inner_radius + mx.indicator_thickness;
+
+        const std::vector<Arc>& ring = m_rings[depth];
+        const std::vector<SvgNodeData>& data = m_svg_rings[depth];
+        for (size_t index = 0; index < ring.size(); ++index)
+        {
+            const Arc& arc = ring[index];
+            const bool isFile = !!arc.m_node->AsFile();
+            if (isFile != files)
+                continue;
+            if (!data[index].m_visible)
+                continue;
+
+            FLOAT end = arc.m_end;
+            while (index + 1 < ring.size())
+            {
+                const Arc& next = ring[index + 1];
+                if (!!next.m_node->AsFile() != files || !data[index + 1].m_visible)
+                    break;
+                if (next.m_start - end > 0.001f)
+                    break;
+                end = next.m_end;
+                ++index;
+            }
+
+            out.Write(isFile ? "<path class=\"i\" fill=\"#999999\" d=\"" : "<path class=\"i\" fill=\"#555555\" d=\"");
+            WriteSvgArc(out, arc.m_start, end, inner_radius, outer_radius);
+            out.Write("\"/>\n");
+        }
+    }
+
+    out.Write("</g>\n");
+}
+
+void Sunburst::SnapshotSvgData()
+{
+    // Called with the tree locked, so that WriteSvg can stream the document
+    // without it.  Names, parents, and node types never change, but sizes,
+    // counts, and whether scanning finished do.
+    m_svg_roots.clear();
+    for (const auto& root : m_roots)
+    {
+        SvgRootData data;
+        data.m_size = root->GetSize();
+        data.m_files = root->CountFiles();
+        data.m_dirs = root->CountDirs();
+        data.m_free = root->GetFreeSpace();
+        data.m_free_size = data.m_free ? data.m_free->GetFreeSize() : 0;
+        m_svg_roots.emplace_back(std::move(data));
+    }
+
+    m_svg_rings.clear();
+    for (const auto& ring : m_rings)
+    {
+        m_svg_rings.emplace_back();
+        std::vector<SvgNodeData>& datas = m_svg_rings.back();
+        datas.reserve(ring.size());
+        for (const auto& arc : ring)
+        {
+            SvgNodeData data;
+            const DirNode* dir = arc.m_node->AsDir();
+            data.m_size = svg_node_size(arc.m_node.get());
+            data.m_files = dir ? dir->CountFiles() : 0;
+            data.m_dirs = dir ? dir->CountDirs() : 0;
+            data.m_visible = (!arc.m_node->AsFile() || arc.m_node->IsParentFinished());
+            datas.emplace_back(data);
+        }
+    }
+}
+
+void Sunburst::WriteSvg(DirectHwndRenderTarget* target, const SunburstMetrics& mx, StreamWriter& out)
+{
+    TRACE_SCOPE("WriteSvg");
+
+    assert(m_svg_rings.size() == m_rings.size() && m_svg_roots.size() == m_roots.size());
+
+    const FLOAT width = m_bounds.right - m_bounds.left;
+    const FLOAT height = m_bounds.bottom - m_bounds.top;
+
+    out.Write("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    out.Format("<svg xmlns=\"http://www.w3.org/2000/svg\" xmlns:xlink=\"http://www.w3.org/1999/xlink\" width=\"%.0f\" height=\"%.0f\" viewBox=\"0 0 %.0f %.0f\">\n",
+               width, height, width, height);
+    out.Write("<style>\n");
+    out.Format(".d{stroke:#%06x;stroke-width:%.2f}\n", m_dark_mode ? 0x444444 : 0x000000, mx.stroke);
+    out.Format(".f{stroke:#444444;stroke-opacity:0.5;stroke-width:%.2f}\n", mx.stroke);
+    out.Format(".m{stroke-width:%.2f}\n", mx.stroke * 3);
+    out.Format(".i{stroke:#%06x;stroke-width:%.2f}\n", GetBackColor(m_dark_mode), mx.stroke / 2);
+    if (target)
+        out.Format(".t{font-family:'Segoe UI',sans-serif;font-size:%.2fpx;white-space:pre;fill:#000000}\n", target->ArcFontSize());
+    out.Write("</style>\n");
+    out.Format("<rect width=\"100%%\" height=\"100%%\" fill=\"#%06x\"/>\n", GetBackColor(m_dark_mode));
+
+    if (!m_start_angles.empty())
+    {
+        m_min_arc_text_len = FLOAT(m_dpiWithTextScaling.Scale(20));
+
+        // Two passes, so files are "beneath" everything else.
+        size_t labels = 0;
+        WriteSvgRings(target, mx, true/*files*/, out, labels);
+        WriteSvgRings(target, mx, false/*files*/, out, labels);
+    }
+
+    out.Write("</svg>\n");
+}
+
 std::shared_ptr<Node> Sunburst::HitTest(const SunburstMetrics& mx, POINT pt, bool* is_free)
 {
+    TRACE_SCOPE("HitTest");
+
     const FLOAT angle = FindAngle(m_center, FLOAT(pt.x), FLOAT(pt.y));
     const FLOAT xdelta = (pt.x - m_center.x);
     const FLOAT ydelta = (pt.y - m_center.y);
@@ -1774,6 +2766,8 @@ bool Sunburst::OnDpiChanged(const DpiScaler& dpi)
     m_dpiWithTextScaling.OnDpiChanged(dpi, true);
 
     m_rings.clear();
+    m_colors.clear();
+    m_root_totals.clear();
     m_start_angles.clear();
     m_free_angles.clear();
 
@@ -4,6 +4,10 @@
 #pragma once
 
 #include "data.h"
+#include "arctext.h"
+#include "raster.h"
+#include "displaylist.h"
+#include "rings.h"
 #include <d3d11.h>
 #include <d2d1.h>
 #include <d2d1_1.h>
@@ -12,6 +16,7 @@
 #include <dwrite_2.h>
 #include "TextOnPath/PathTextRenderer.h"
 #include <string>
+#include <unordered_set>
 
 //#define USE_CHART_OUTLINE               // Experimenting with this off.
 
@@ -20,6 +25,7 @@
 class DirNode;
 struct SunburstMetrics;
 class Sunburst;
+class StreamWriter;
 
 HRESULT InitializeD2D();
 HRESULT InitializeDWrite();
@@ -143,7 +149,7 @@ private:
 struct SunburstMetrics
 {
     SunburstMetrics(const Sunburst& sunburst);
-    SunburstMetrics(const DpiScaler& dpi, const D2D1_RECT_F& bounds, FLOAT max_extent);
+    SunburstMetrics(const DpiScaler& dpi, const D2D1_RECT_F& bounds, FLOAT max_extent, bool proportional_area);
     FLOAT get_thickness(size_t depth) const;
 
     const FLOAT stroke;
@@ -156,19 +162,17 @@ struct SunburstMetrics
     const FLOAT min_arc;
 
 private:
+    const bool proportional_area;
     FLOAT thicknesses[MAX_SUNBURST_DEPTH];
 };
 
 class Sunburst
 {
     friend struct SunburstMetrics;
+    friend class DWriteArcTextMeasurer;
+    friend class D2DDisplayListBackend;
 
-    struct Arc
-    {
-        float               m_start;
-        float               m_end;
-        std::shared_ptr<Node> m_node;
-    };
+    typedef RingArc<Node> Arc;
 
     struct HighlightInfo
     {
@@ -185,24 +189,65 @@ public:
 
     bool                    OnDpiChanged(const DpiScaler& dpi);
     void                    UseDarkMode(bool dark) { m_dark_mode = dark; }
+    void                    SetChartOptions(bool show_free_space, bool proportional_area, long color_mode);
     bool                    SetBounds(const D2D1_RECT_F& rect, FLOAT max_extent);
+    const D2D1_RECT_F&      GetBounds() const { return m_bounds; }
     void                    BuildRings(const SunburstMetrics& mx, const std::vector<std::shared_ptr<DirNode>>& roots);
+    void                    BuildDisplayList(DirectHwndRenderTarget* target, const SunburstMetrics& mx, const Sunburst* previous=nullptr);
+    const DisplayList*      GetDisplayList() const;
     void                    RenderRings(DirectHwndRenderTarget& target, const SunburstMetrics& mx, const std::shared_ptr<Node>& highlight);
+    void                    SetSelection(const std::vector<std::shared_ptr<Node>>& selection);
+    void                    SetArcTextFitCache(ArcTextFitCache* cache) { m_arc_text_fits = cache; }
+    void                    SetLayoutBudget(size_t max_depth, size_t max_arcs) { m_max_layout_depth = max_depth; m_max_layout_arcs = max_arcs; }
+    size_t                  GetLayoutDepth() const { return m_rings.size(); }
+    size_t                  GetLayoutArcs() const { return m_layout_arcs; }
+    bool                    IsLayoutTruncated() const { return m_layout_truncated; }
+    LONGLONG                GetLayoutTime() const { return m_layout_us; }
+    size_t                  GetLayoutBytes() const;
+    void                    SetLayoutMutex(std::recursive_mutex* mutex) { m_layout_mutex = mutex; }
+    void                    SetLayoutParallel(bool parallel) { m_layout_parallel = parallel; }
+    void                    SetLayoutCancel(const volatile LONG* current, LONG generation) { m_cancel = current; m_cancel_generation = generation; }
+    bool                    IsLayoutCanceled() const { return m_layout_canceled; }
+    bool                    SameLayout(const Sunburst& other) const;
     void                    FormatSize(ULONGLONG size, std::wstring& text, std::wstring& units, int places=-1);
     std::shared_ptr<Node>   HitTest(const SunburstMetrics& mx, POINT pt, bool* is_free=nullptr);
+    void                    MakeRasterScene(const SunburstMetrics& mx, RasterScene& scene);
+    void                    SnapshotSvgData();
+    void                    WriteSvg(DirectHwndRenderTarget* target, const SunburstMetrics& mx, StreamWriter& out);
 
 protected:
+    bool                    GetArcHue(const Arc& arc, bool highlight, FLOAT& hue, D2D1_COLOR_F& color) const;
     D2D1_COLOR_F            MakeColor(const Arc& arc, size_t depth, bool highlight);
+    void                    BuildColors();
     D2D1_COLOR_F            MakeRootColor(bool highlight, bool free);
-    static void             MakeArc(std::vector<Arc>& arcs, FLOAT outer_radius, FLOAT min_arc, const std::shared_ptr<Node>& node, ULONGLONG size, double& sweep, double total, float start, float span, double convert=1.0f);
-    std::vector<Arc>        NextRing(const std::vector<Arc>& parent_ring, FLOAT outer_radius, FLOAT min_arc);
     void                    AddArcToSink(ID2D1GeometrySink* pSink, bool counter_clockwise, FLOAT start, FLOAT end, const D2D1_POINT_2F& end_point, FLOAT radius);
     bool                    MakeArcGeometry(DirectHwndRenderTarget& target, FLOAT start, FLOAT end, FLOAT inner_radius, FLOAT outer_radius, ID2D1Geometry** ppGeometry);
     void                    DrawArcText(DirectHwndRenderTarget& target, const Arc& arc, FLOAT radius);
 
 private:
-    void                    RenderRingsInternal(DirectHwndRenderTarget& target, const SunburstMetrics& mx, const std::shared_ptr<Node>& highlight, bool files, HighlightInfo& highlightInfo);
-    int                     DrawArcTextInternal(DirectHwndRenderTarget& target, IDWriteFactory* pFactory, const WCHAR* text, UINT32 length, FLOAT start, FLOAT end, FLOAT radius, bool only_test_fit=false);
+    struct DisplayListKey;
+    struct RetainedDisplayList;
+
+    // What WriteSvg needs from the nodes that can change while scanning.
+    struct SvgNodeData
+    {
+        ULONGLONG           m_size = 0;
+        ULONGLONG           m_files = 0;
+        ULONGLONG           m_dirs = 0;
+        bool                m_visible = true;   // False for files whose parent isn't finished.
+    };
+
+    struct SvgRootData : public SvgNodeData
+    {
+        std::shared_ptr<FreeSpaceNode> m_free;
+        ULONGLONG           m_free_size = 0;
+    };
+
+    void                    MakeDisplayListKey(DirectHwndRenderTarget* target, const SunburstMetrics& mx, DisplayListKey& key) const;
+    void                    AddDisplayCommands(DirectHwndRenderTarget* target, const SunburstMetrics& mx, bool files, DisplayList& list);
+    void                    WriteSvgRings(DirectHwndRenderTarget* target, const SunburstMetrics& mx, bool files, StreamWriter& out, size_t& labels);
+    void                    WriteSvgArc(StreamWriter& out, FLOAT start, FLOAT end, FLOAT inner_radius, FLOAT outer_radius);
+    bool                    MakeArcTextPath(DirectHwndRenderTarget& target, FLOAT start, FLOAT end, FLOAT radius, ID2D1PathGeometry** ppGeometry);
 
 private:
     DpiScaler               m_dpi;
@@ -213,10 +258,30 @@ private:
     D2D1_POINT_2F           m_center = D2D1::Point2F();
     UnitScale               m_units = UnitScale::MB;
     bool                    m_dark_mode = false;
+    bool                    m_show_free_space = false; // Chart options are captured, since layout can run on another thread.
+    bool                    m_proportional_area = false;
+    long                    m_color_mode = CM_PLAIN;
 
     std::vector<std::shared_ptr<DirNode>> m_roots;
     std::vector<std::vector<Arc>> m_rings;
+    std::vector<std::vector<D2D1_COLOR_F>> m_colors; // Parallel to m_rings; unhighlighted colors.
+    std::vector<ULONGLONG>  m_root_totals;  // Per root; the total of its outermost ancestor, for heatmap colors.
     std::vector<FLOAT>      m_start_angles;
     std::vector<FLOAT>      m_free_angles;
+    size_t                  m_max_layout_depth = 0; // 0 means no limit.
+    size_t                  m_max_layout_arcs = 0;  // 0 means no limit.
+    size_t                  m_layout_arcs = 0;
+    bool                    m_layout_truncated = false;
+    LONGLONG                m_layout_us = 0;
+    std::recursive_mutex*   m_layout_mutex = nullptr; // Held while reading the tree, but released between rings.
+    const volatile LONG*    m_cancel = nullptr;     // Layout stops when *m_cancel != m_cancel_generation.
+    LONG                    m_cancel_generation = 0;
+    bool                    m_layout_canceled = false;
+    bool                    m_layout_parallel = true; // Wide rings are built on several threads.
+    std::unordered_set<const Node*> m_selection;
+    ArcTextFitCache*        m_arc_text_fits = nullptr; // Owned by the window, so it outlives each paint's Sunburst.
+    std::shared_ptr<RetainedDisplayList> m_display_list; // Shared with later paints while the layout is unchanged.
+    std::vector<SvgRootData> m_svg_roots;   // See SnapshotSvgData.
+    std::vector<std::vector<SvgNodeData>> m_svg_rings; // Parallel to m_rings.
 };
 
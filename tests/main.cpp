@@ -0,0 +1,31 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "tests.h"
+
+struct Test
+{
+    const char*             name;
+    int                     (*func)();
+};
+
+static const Test c_tests[] =
+{
+    { "rings", TestRings },
+    { "arctext", TestArcText },
+    { "colorbatch", TestColorBatch },
+    { "displaylist", TestDisplayList },
+};
+
+int main(int, char**)
+{
+    int failed = 0;
+    for (const auto& test : c_tests)
+    {
+        const int failures = test.func();
+        printf("%-16s %s\n", test.name, failures ? "FAILED" : "ok");
+        if (failures)
+            ++failed;
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,136 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "tests.h"
+#include "arctext.h"
+#include <cmath>
+
+// Every character is the same width, and a text fits when it's no longer
+// than the arc.
+class FakeMeasurer : public ArcTextMeasurer
+{
+public:
+    int                     TestFit(const wchar_t* text, uint32_t length, float span, float radius, std::shared_ptr<ArcTextShape>* shape) override
+    {
+        ++m_calls;
+        if (m_fail)
+            return 0;
+        const float arc = float(span * radius * 3.14159265358979323846 / 180.0f);
+        if (float(length) * m_char_width > arc)
+            return -1;
+        if (shape)
+        {
+            ++m_shapes;
+            m_last_text.assign(text, length);
+            *shape = std::make_shared<ArcTextShape>();
+        }
+        return 1;
+    }
+
+    float                   m_char_width = 10.0f;
+    bool                    m_fail = false;
+    size_t                  m_calls = 0;
+    size_t                  m_shapes = 0;
+    std::wstring            m_last_text;
+};
+
+// Span in degrees of an arc at radius that holds exactly chars characters.
+static float SpanFor(size_t chars, float char_width, float radius)
+{
+    return float(float(chars) * char_width * 180.0f / (radius * 3.14159265358979323846)) + 0.001f;
+}
+
+int TestArcText()
+{
+    int failures = 0;
+    const float radius = 100.0f;
+
+    // Fits as is, padded with spaces.
+    {
+        FakeMeasurer measurer;
+        ArcTextFit fit;
+        FitArcText(measurer, L"abc", SpanFor(5, measurer.m_char_width, radius), radius, fit);
+        CHECK(fit.m_fits);
+        CHECK(fit.m_text == L" abc ");
+        CHECK(fit.m_shape != nullptr);
+        CHECK(measurer.m_calls == 1);
+    }
+
+    // Truncated to the longest prefix that fits with an ellipsis.
+    {
+        FakeMeasurer measurer;
+        ArcTextFit fit;
+        FitArcText(measurer, L"abcdefghijklmnop", SpanFor(10, measurer.m_char_width, radius), radius, fit);
+        CHECK(fit.m_fits);
+        CHECK(fit.m_text == L" abcde... ");
+        CHECK(fit.m_shape != nullptr);
+        CHECK(measurer.m_last_text == fit.m_text);
+    }
+
+    // Too small for even one character and an ellipsis.
+    {
+        FakeMeasurer measurer;
+        ArcTextFit fit;
+        FitArcText(measurer, L"abcdefghijklmnop", SpanFor(5, measurer.m_char_width, radius), radius, fit);
+        CHECK(!fit.m_fits);
+        CHECK(fit.m_shape == nullptr);
+    }
+
+    // Truncation doesn't split a surrogate pair.
+    {
+        FakeMeasurer measurer;
+        ArcTextFit fit;
+        FitArcText(measurer, L"abcd\xd83d\xde00xyzxyzxyz", SpanFor(10, measurer.m_char_width, radius), radius, fit);
+        CHECK(fit.m_fits);
+        CHECK(fit.m_text == L" abcd... ");
+    }
+
+    // A failed measurement draws nothing.
+    {
+        FakeMeasurer measurer;
+        measurer.m_fail = true;
+        ArcTextFit fit;
+        FitArcText(measurer, L"abc", SpanFor(5, measurer.m_char_width, radius), radius, fit);
+        CHECK(!fit.m_fits);
+        CHECK(fit.m_shape == nullptr);
+    }
+
+    // The cache measures each distinct fit once.
+    {
+        FakeMeasurer measurer;
+        ArcTextFitCache cache;
+        const float span = SpanFor(10, measurer.m_char_width, radius);
+
+        const ArcTextFit& first = cache.Fit(measurer, L"abcdefghijklmnop", 12.0f, span, radius);
+        const std::shared_ptr<ArcTextShape> shape = first.m_shape;
+        const size_t calls = measurer.m_calls;
+        CHECK(first.m_fits);
+        CHECK(first.m_text == L" abcde... ");
+        CHECK(cache.Hits() == 0);
+        CHECK(cache.Misses() == 1);
+
+        // Same key; the radius is rounded to whole pixels.
+        const ArcTextFit& again = cache.Fit(measurer, L"abcdefghijklmnop", 12.0f, span, radius + 0.3f);
+        CHECK(again.m_shape == shape);
+        CHECK(again.m_text == L" abcde... ");
+        CHECK(measurer.m_calls == calls);
+        CHECK(cache.Hits() == 1);
+
+        // Any other part of the key measures again.
+        cache.Fit(measurer, L"abcdefghijklmnoq", 12.0f, span, radius);
+        cache.Fit(measurer, L"abcdefghijklmnop", 13.0f, span, radius);
+        cache.Fit(measurer, L"abcdefghijklmnop", 12.0f, span * 2, radius);
+        cache.Fit(measurer, L"abcdefghijklmnop", 12.0f, span, radius + 1.0f);
+        CHECK(cache.Hits() == 1);
+        CHECK(cache.Misses() == 5);
+
+        cache.Clear();
+        const size_t before = measurer.m_calls;
+        const ArcTextFit& cleared = cache.Fit(measurer, L"abcdefghijklmnop", 12.0f, span, radius);
+        CHECK(measurer.m_calls > before);
+        CHECK(cleared.m_shape != shape);
+        CHECK(cache.Misses() == 6);
+    }
+
+    return failures;
+}
@@ -0,0 +1,50 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "tests.h"
+#include "colorbatch.h"
+#include <cstring>
+#include <random>
+#include <vector>
+
+int TestColorBatch()
+{
+    int failures = 0;
+
+    // Not a multiple of four, so the scalar tail is covered too.
+    const size_t count = 1000003;
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> hue(-20.0f, 380.0f);
+    std::uniform_real_distribution<float> sat_lum(-10.0f, 250.0f);
+
+    std::vector<float> h(count);
+    std::vector<float> s(count);
+    std::vector<float> l(count);
+    for (size_t ii = 0; ii < count; ++ii)
+    {
+        h[ii] = hue(rng);
+        s[ii] = sat_lum(rng);
+        l[ii] = sat_lum(rng);
+
+        // Exact boundaries and grays show up often in practice.
+        switch (rng() % 16)
+        {
+        case 0:     s[ii] = 0; break;
+        case 1:     h[ii] = float(rng() % 7) * 60; break;
+        case 2:     l[ii] = float(rng() % 3) * 120; break;
+        case 3:     s[ii] = 240; break;
+        }
+    }
+
+    std::vector<float> r(count), g(count), b(count);
+    std::vector<float> r2(count), g2(count), b2(count);
+    HslToRgbBatch(h.data(), s.data(), l.data(), count, r.data(), g.data(), b.data());
+    HslToRgbBatchScalar(h.data(), s.data(), l.data(), count, r2.data(), g2.data(), b2.data());
+
+    CHECK(!memcmp(r.data(), r2.data(), count * sizeof(float)));
+    CHECK(!memcmp(g.data(), g2.data(), count * sizeof(float)));
+    CHECK(!memcmp(b.data(), b2.data(), count * sizeof(float)));
+
+    return failures;
+}
@@ -0,0 +1,76 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "tests.h"
+#include "displaylist.h"
+
+static DisplayCommand MakeCommand(uint8_t op, uint8_t flags, uint16_t depth, uint32_t index, float start, float end, float inner, float outer)
+{
+    DisplayCommand command = {};
+    command.m_op = op;
+    command.m_flags = flags;
+    command.m_depth = depth;
+    command.m_index = index;
+    command.m_start = start;
+    command.m_end = end;
+    command.m_inner = inner;
+    command.m_outer = outer;
+    command.m_fill = 0xff336699;
+    command.m_line = 0x80000000;
+    command.m_stroke = 1.5f;
+    return command;
+}
+
+int TestDisplayList()
+{
+    int failures = 0;
+
+    DisplayList list;
+    list.BeginLayer(1.0f);
+    list.Add(MakeCommand(DOP_SECTOR, DCF_ROOT, 0, 0, 0.0f, 270.0f, 0.0f, 40.0f));
+    list.Add(MakeCommand(DOP_SECTOR, DCF_ROOT|DCF_FREE, 0, 0, 270.0f, 360.0f, 0.0f, 40.0f));
+    list.Add(MakeCommand(DOP_SPOKE, DCF_NONE, 0, 0, 270.0f, 270.0f, 0.0f, 40.0f));
+    list.BeginLayer(0.5f);
+    list.BeginLayer(0.25f);
+    list.Add(MakeCommand(DOP_SECTOR, DCF_FILE|DCF_NAMES, 1, 7, 12.5f, 90.0f, 40.0f, 60.0f));
+    list.Add(MakeCommand(DOP_LABEL, DCF_MOUNT_POINT|DCF_NAMES, 1, 8, 90.0f, 180.0f, 40.0f, 50.0f));
+    list.Add(MakeCommand(DOP_CIRCLE, DCF_NONE, 0, 0, 0.0f, 0.0f, 0.0f, 60.0f));
+    list.Add(MakeCommand(DOP_INDICATOR, DCF_NONE, 2, 3, 100.0f, 110.0f, 60.0f, 64.0f));
+    list.Add(MakeCommand(99, DCF_NONE, 0, 0, 0.0f, 0.0f, 0.0f, 0.0f));
+    CHECK(list.Count() == 8);
+
+    static const char c_expected[] =
+        "layer 1.00\n"
+        "  #0 sector depth=0 index=0 start=0.00 end=270.00 inner=0.00 outer=40.00 fill=ff336699 line=80000000 stroke=1.50 root\n"
+        "  #1 sector depth=0 index=0 start=270.00 end=360.00 inner=0.00 outer=40.00 fill=ff336699 line=80000000 stroke=1.50 root free\n"
+        "  #2 spoke depth=0 index=0 start=270.00 end=270.00 inner=0.00 outer=40.00 fill=ff336699 line=80000000 stroke=1.50\n"
+        "end\n"
+        "layer 0.50\n"
+        "end\n"
+        "layer 0.25\n"
+        "  #3 sector depth=1 index=7 start=12.50 end=90.00 inner=40.00 outer=60.00 fill=ff336699 line=80000000 stroke=1.50 file names\n"
+        "  #4 label depth=1 index=8 start=90.00 end=180.00 inner=40.00 outer=50.00 fill=ff336699 line=80000000 stroke=1.50 mountpoint names\n"
+        "  #5 circle depth=0 index=0 start=0.00 end=0.00 inner=0.00 outer=60.00 fill=ff336699 line=80000000 stroke=1.50\n"
+        "  #6 indicator depth=2 index=3 start=100.00 end=110.00 inner=60.00 outer=64.00 fill=ff336699 line=80000000 stroke=1.50\n"
+        "  #7 ? depth=0 index=0 start=0.00 end=0.00 inner=0.00 outer=0.00 fill=ff336699 line=80000000 stroke=1.50\n"
+        "end\n";
+
+    DisplayListRecorder recorder;
+    list.Replay(recorder);
+    CHECK(recorder.Text() == c_expected);
+    if (recorder.Text() != c_expected)
+        fprintf(stderr, "%s", recorder.Text().c_str());
+
+    // Replaying again produces the same transcript.
+    recorder.Clear();
+    list.Replay(recorder);
+    CHECK(recorder.Text() == c_expected);
+
+    recorder.Clear();
+    list.Clear();
+    list.Replay(recorder);
+    CHECK(list.Count() == 0);
+    CHECK(recorder.Text().empty());
+
+    return failures;
+}
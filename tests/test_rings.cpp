@@ -0,0 +1,179 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "tests.h"
+#include "rings.h"
+#include <cstring>
+#include <random>
+#include <thread>
+
+// Synthetic nodes with just the interface the ring builder needs.
+
+class TestDir;
+class TestFile;
+
+class TestNode
+{
+public:
+    virtual                 ~TestNode() {}
+    virtual const TestDir*  AsDir() const { return nullptr; }
+};
+
+class TestFile : public TestNode
+{
+public:
+                            TestFile(uint64_t size) : m_size(size) {}
+    uint64_t                GetSize() const { return m_size; }
+
+private:
+    const uint64_t          m_size;
+};
+
+class TestDir : public TestNode
+{
+public:
+    const TestDir*          AsDir() const override { return this; }
+    bool                    IsHidden() const { return m_hidden; }
+    bool                    IsFinished() const { return m_finished; }
+    uint64_t                GetSize() const { return m_size; }
+    std::vector<std::shared_ptr<TestDir>> CopyDirs() const { return m_dirs; }
+    std::vector<std::shared_ptr<TestFile>> CopyFiles() const { return m_files; }
+
+    std::vector<std::shared_ptr<TestDir>> m_dirs;
+    std::vector<std::shared_ptr<TestFile>> m_files;
+    uint64_t                m_size = 0;
+    bool                    m_hidden = false;
+    bool                    m_finished = true;
+};
+
+typedef RingArc<TestNode> TestArc;
+
+// Explicit, so the pool is used even on a single processor.
+static const unsigned c_threads = 4;
+
+static std::shared_ptr<TestDir> MakeTree(std::mt19937& rng, unsigned depth, size_t fanout)
+{
+    auto dir = std::make_shared<TestDir>();
+    dir->m_hidden = (rng() % 64 == 0);
+    dir->m_finished = (rng() % 16 != 0);
+
+    const size_t files = rng() % (fanout + 1);
+    for (size_t ii = 0; ii < files; ++ii)
+    {
+        // Mostly small files, some empty, a few huge ones.
+        const uint64_t size = (rng() % 8 == 0) ? 0 : (rng() % 32 == 0) ? (uint64_t(rng()) << 12) : rng() % 100000;
+        dir->m_files.emplace_back(std::make_shared<TestFile>(size));
+        dir->m_size += size;
+    }
+
+    if (depth)
+    {
+        const size_t dirs = rng() % (fanout + 1);
+        for (size_t ii = 0; ii < dirs; ++ii)
+        {
+            dir->m_dirs.emplace_back(MakeTree(rng, depth - 1, fanout));
+            dir->m_size += dir->m_dirs.back()->GetSize();
+        }
+    }
+
+    return dir;
+}
+
+// Flattens a ring into bytes, so rings can be compared exactly without
+// depending on struct padding.
+static std::vector<uint8_t> RingBytes(const std::vector<TestArc>& ring)
+{
+    std::vector<uint8_t> bytes;
+    auto append = [&bytes](const void* p, size_t len)
+    {
+        bytes.insert(bytes.end(), static_cast<const uint8_t*>(p), static_cast<const uint8_t*>(p) + len);
+    };
+
+    for (const auto& arc : ring)
+    {
+        const TestNode* node = arc.m_node.get();
+        const uint8_t finished = arc.m_finished;
+        append(&arc.m_start, sizeof(arc.m_start));
+        append(&arc.m_end, sizeof(arc.m_end));
+        append(&node, sizeof(node));
+        append(&arc.m_root, sizeof(arc.m_root));
+        append(&finished, sizeof(finished));
+    }
+    return bytes;
+}
+
+static bool SameRing(const std::vector<TestArc>& a, const std::vector<TestArc>& b)
+{
+    const std::vector<uint8_t> bytes_a = RingBytes(a);
+    const std::vector<uint8_t> bytes_b = RingBytes(b);
+    return bytes_a.size() == bytes_b.size() && (bytes_a.empty() || !memcmp(bytes_a.data(), bytes_b.data(), bytes_a.size()));
+}
+
+int TestRings()
+{
+    int failures = 0;
+    size_t wide_rings = 0;
+
+    for (unsigned seed = 1; seed <= 8; ++seed)
+    {
+        std::mt19937 rng(seed);
+
+        // A few roots, like several drives in one chart.
+        std::vector<std::shared_ptr<TestDir>> roots;
+        for (unsigned ii = 1 + unsigned(rng() % 3); ii--;)
+            roots.emplace_back(MakeTree(rng, 5 + rng() % 2, 4 + seed));
+
+        const float min_arc = (seed % 2) ? 0.0f : 0.05f;
+        float outer_radius = 50.0f;
+
+        double total = 0;
+        for (const auto& root : roots)
+            total += double(root->GetSize());
+
+        std::vector<TestArc> ring;
+        double sweep = 0;
+        for (size_t ii = 0; ii < roots.size(); ++ii)
+        {
+            const float start = float(sweep * 360 / total);
+            sweep += double(roots[ii]->GetSize());
+            const float span = float(sweep * 360 / total) - start;
+            const size_t first = ring.size();
+            double child_sweep = 0;
+            for (const auto& dir : roots[ii]->CopyDirs())
+                MakeRingArc<TestNode>(ring, outer_radius, min_arc, dir, dir->GetSize(), child_sweep, double(roots[ii]->GetSize()), start, span);
+            for (const auto& file : roots[ii]->CopyFiles())
+                MakeRingArc<TestNode>(ring, outer_radius, min_arc, file, file->GetSize(), child_sweep, double(roots[ii]->GetSize()), start, span);
+            SetRingArcAncestry(ring, first, ii, roots[ii]->IsFinished());
+        }
+
+        while (!ring.empty())
+        {
+            outer_radius += 20.0f;
+
+            const std::vector<TestArc> sequential = NextRing(ring, outer_radius, min_arc, 1);
+            const std::vector<TestArc> parallel = NextRing(ring, outer_radius, min_arc, c_threads);
+            CHECK(SameRing(sequential, parallel));
+
+            if (ring.size() >= c_parallel_ring_parents)
+            {
+                ++wide_rings;
+
+                // Two layouts at once:  one gets the pool and the other
+                // builds by itself, and both still match.
+                std::vector<TestArc> concurrent;
+                std::thread other([&]() { concurrent = NextRing(ring, outer_radius, min_arc, c_threads); });
+                const std::vector<TestArc> mine = NextRing(ring, outer_radius, min_arc, c_threads);
+                other.join();
+                CHECK(SameRing(sequential, mine));
+                CHECK(SameRing(sequential, concurrent));
+            }
+
+            ring = sequential;
+        }
+    }
+
+    // Otherwise the parallel path was never compared.
+    CHECK(wide_rings > 0);
+
+    return failures;
+}
@@ -0,0 +1,22 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+// Tests for the parts of Elucidisk that have no Windows dependencies:  the
+// ring builder and worker pool, arc label fitting, batched color conversion,
+// and the display list.  They build and run anywhere, e.g.:
+//
+//      g++ -std=c++17 -O2 -pthread -DDEBUG -I. tests/*.cpp workers.cpp arctext.cpp colorbatch.cpp displaylist.cpp -o elucidisk_tests
+//
+// Each test returns the number of failed checks.
+
+#pragma once
+
+#include <stdio.h>
+
+#define CHECK(x) \
+    do { if (!(x)) { fprintf(stderr, "%s(%d): CHECK failed: %s\n", __FILE__, __LINE__, #x); ++failures; } } while (false)
+
+int TestRings();
+int TestArcText();
+int TestColorBatch();
+int TestDisplayList();
@@ -0,0 +1,212 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "main.h"
+#include "trace.h"
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+volatile bool g_trace_enabled = false;
+
+static const size_t c_trace_capacity = 32 * 1024;   // Events per thread.
+static const size_t c_trace_max_buffers = 64;       // About 1 MB each.
+
+struct TraceEvent
+{
+    const char*             name;
+    LONGLONG                ticks;
+    LONGLONG                value;
+    char                    phase;          // 'B' begin, 'E' end, 'C' counter.
+};
+
+struct TraceBuffer
+{
+    DWORD                   thread_id = 0;
+    volatile LONG64         head = 0;       // Total events recorded; only the owning thread advances it.
+    LONG64                  written = 0;    // Events already written by WriteTrace.
+    bool                    exited = false; // The owning thread has exited.
+    TraceEvent              events[c_trace_capacity];
+};
+
+// Releases the thread's buffer for reuse when the thread exits.
+struct TraceBufferOwner
+{
+                            ~TraceBufferOwner();
+    TraceBuffer*            buffer = nullptr;
+};
+
+static std::mutex s_trace_mutex;
+static std::vector<std::unique_ptr<TraceBuffer>> s_trace_buffers;
+static LARGE_INTEGER s_trace_freq = {};
+static LARGE_INTEGER s_trace_start = {};
+static thread_local TraceBufferOwner s_trace_owner;
+
+TraceBufferOwner::~TraceBufferOwner()
+{
+    if (buffer)
+    {
+        std::lock_guard<std::mutex> lock(s_trace_mutex);
+        buffer->exited = true;
+    }
+}
+
+static TraceBuffer* get_trace_buffer()
+{
+    if (!s_trace_owner.buffer)
+    {
+        // Buffers outlive their threads, so that events from threads which
+        // have already exited (e.g. scan workers) still make it into the
+        // trace.  A new thread reuses the buffer of an exited thread once
+        // its events have been written.  At the cap it reuses the one with
+        // the oldest events, even if unwritten; if every buffer belongs to
+        // a live thread, the new thread's events are dropped.
+        std::lock_guard<std::mutex> lock(s_trace_mutex);
+
+        TraceBuffer* reuse = nullptr;
+        LONGLONG oldest = 0;
+        for (const auto& buffer : s_trace_buffers)
+        {
+            if (!buffer->exited)
+                continue;
+            if (buffer->written == buffer->head)
+            {
+                reuse = buffer.get();
+                break;
+            }
+            if (s_trace_buffers.size() >= c_trace_max_buffers)
+            {
+                const LONG64 head = buffer->head;
+                const LONGLONG last = buffer->events[size_t((head - 1) % c_trace_capacity)].ticks;
+                if (!reuse || last < oldest)
+                {
+                    reuse = buffer.get();
+                    oldest = last;
+                }
+            }
+        }
+
+        if (reuse)
+        {
+            reuse->head = 0;
+            reuse->written = 0;
+            reuse->exited = false;
+        }
+        else if (s_trace_buffers.size() < c_trace_max_buffers)
+        {
+            s_trace_buffers.emplace_back(std::make_unique<TraceBuffer>());
+            reuse = s_trace_buffers.back().get();
+        }
+        else
+        {
+            return nullptr;
+        }
+
+        reuse->thread_id = GetCurrentThreadId();
+        s_trace_owner.buffer = reuse;
+    }
+    return s_trace_owner.buffer;
+}
+
+static void record_event(const char phase, const char* name, const LONGLONG value)
+{
+    if (!g_trace_enabled)
+        return;
+
+    TraceBuffer* const buffer = get_trace_buffer();
+    if (!buffer)
+        return;
+
+    const LONG64 head = buffer->head;
+
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+
+    TraceEvent& event = buffer->events[size_t(head % c_trace_capacity)];
+    event.name = name;
+    event.ticks = now.QuadPart;
+    event.value = value;
+    event.phase = phase;
+
+    // Publish the event.
+    InterlockedExchange64(&buffer->head, head + 1);
+}
+
+void EnableTracing()
+{
+    QueryPerformanceFrequency(&s_trace_freq);
+    QueryPerformanceCounter(&s_trace_start);
+    g_trace_enabled = true;
+}
+
+void TraceBegin(const char* name)
+{
+    record_event('B', name, 0);
+}
+
+void TraceEnd(const char* name)
+{
+    record_event('E', name, 0);
+}
+
+void TraceCounter(const char* name, const LONGLONG value)
+{
+    record_event('C', name, value);
+}
+
+bool WriteTrace(const WCHAR* file)
+{
+    if (!s_trace_freq.QuadPart)
+        return false;
+
+    // Stop recording, so the buffers hold still while they're written.
+    g_trace_enabled = false;
+
+    const DWORD pid = GetCurrentProcessId();
+
+    std::string json;
+    json.append("{\"traceEvents\":[");
+
+    char sz[256];
+    bool first = true;
+    {
+        std::lock_guard<std::mutex> lock(s_trace_mutex);
+
+        for (const auto& buffer : s_trace_buffers)
+        {
+            const LONG64 head = InterlockedCompareExchange64(&buffer->head, 0, 0);
+            const LONG64 tail = (head > LONG64(c_trace_capacity)) ? head - LONG64(c_trace_capacity) : 0;
+            for (LONG64 ii = tail; ii < head; ++ii)
+            {
+                const TraceEvent& event = buffer->events[size_t(ii % c_trace_capacity)];
+                const double ts = double(event.ticks - s_trace_start.QuadPart) * 1000000 / double(s_trace_freq.QuadPart);
+
+                if (event.phase == 'C')
+                {
+                    sprintf_s(sz, _countof(sz), "%s\n{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu,\"args\":{\"value\":%lld}}",
+                              first ? "" : ",", event.name, ts, pid, buffer->thread_id, event.value);
+                }
+                else
+                {
+                    sprintf_s(sz, _countof(sz), "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%lu,\"tid\":%lu}",
+                              first ? "" : ",", event.name, event.phase, ts, pid, buffer->thread_id);
+                }
+
+                json.append(sz);
+                first = false;
+            }
+
+            buffer->written = head;
+        }
+    }
+
+    json.append("\n],\"displayTimeUnit\":\"ms\"}\n");
+
+    SFileHandle hFile = CreateFile(file, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (hFile.IsEmpty())
+        return false;
+
+    DWORD written;
+    return WriteFile(hFile, json.c_str(), DWORD(json.length()), &written, nullptr) && written == json.length();
+}
@@ -0,0 +1,45 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+// Lightweight tracing of scan and paint phases, for attributing slow scans
+// and dropped frames on machines without a profiler.
+//
+// Tracing is compiled into all builds, but does nothing until EnableTracing()
+// is called; until then each trace point costs one load of a global flag.
+// Each thread records begin/end and counter events into its own fixed size
+// ring buffer, so recording never takes a lock.  When a buffer wraps, the
+// oldest events are overwritten.  The number of buffers is capped, and the
+// buffers of exited threads are reused once WriteTrace() has written them.
+// WriteTrace() writes the recorded events as Chrome trace_event JSON, which
+// chrome://tracing and Perfetto can open.
+//
+// Event names must be string literals (or otherwise outlive the process),
+// since only the pointers are recorded.
+
+#pragma once
+
+#include <windows.h>
+
+extern volatile bool g_trace_enabled;
+
+void EnableTracing();
+bool WriteTrace(const WCHAR* file);
+
+void TraceBegin(const char* name);
+void TraceEnd(const char* name);
+void TraceCounter(const char* name, LONGLONG value);
+
+class TraceScope
+{
+public:
+                            TraceScope(const char* name) : m_name(g_trace_enabled ? name : nullptr) { if (m_name) TraceBegin(m_name); }
+                            ~TraceScope() { if (m_name) TraceEnd(m_name); }
+
+private:
+    const char* const       m_name;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#define TRACE_COUNTER(name, value) do { if (g_trace_enabled) TraceCounter(name, LONGLONG(value)); } while (false)
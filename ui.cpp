@@ -4,16 +4,23 @@
 #include "main.h"
 #include "data.h"
 #include "scan.h"
+#include "checkpoint.h"
 #include "sunburst.h"
 #include "actions.h"
 #include "ui.h"
 #include "sunburst.h"
 #include "dontscan.h"
 #include "DarkMode.h"
+#include "trace.h"
+#include "raster.h"
+#include "export.h"
 #include "res.h"
 #include "version.h"
 #include <windowsx.h>
 #include <iosfwd>
+#include <algorithm>
+#include <condition_variable>
+#include <list>
 
 extern const WCHAR c_fontface[];
 
@@ -344,6 +351,22 @@ void Hourglass::End()
 //----------------------------------------------------------------------------
 // ScannerThread.
 
+struct VolumeUsage
+{
+    std::shared_ptr<DirNode> m_dir;     // The root, or a mount point.
+    ULONGLONG               m_size;     // Not including nested mount points.
+};
+
+static bool is_under(const std::shared_ptr<DirNode>& node, const DirNode* ancestor)
+{
+    for (std::shared_ptr<DirNode> dir = node; dir; dir = dir->GetParent())
+    {
+        if (dir.get() == ancestor)
+            return true;
+    }
+    return false;
+}
+
 class ScannerThread
 {
 public:
@@ -351,14 +374,20 @@ public:
                             ~ScannerThread() { Stop(); }
 
     std::vector<std::shared_ptr<DirNode>> Start(int argc, const WCHAR** argv);
-    void                    Start(const std::shared_ptr<DirNode>& dir);
+    void                    Start(const std::vector<std::shared_ptr<DirNode>>& dirs);
     void                    Stop();
 
     bool                    IsComplete();
     void                    GetScanningPath(std::wstring& out);
 
+    typedef std::pair<std::shared_ptr<DirNode>, std::shared_ptr<DirNode>> Replaced;
+    void                    TakeReplaced(std::vector<Replaced>& out);
+    void                    GetVolumeBreakdown(const std::shared_ptr<DirNode>& root, std::vector<VolumeUsage>& out);
+
 protected:
     void                    StartInternal(const std::vector<std::shared_ptr<DirNode>>& roots, bool fullscan);
+    bool                    ScanRoot(const std::shared_ptr<DirNode>& root, bool fullscan, LONG generation, ScanContext& context);
+    static std::shared_ptr<DirNode> RestartRoot(const std::shared_ptr<DirNode>& root);
     static void             ThreadProc(ScannerThread* pThis);
 
 private:
@@ -367,11 +396,16 @@ private:
     HANDLE                  m_hStop;
     volatile LONG           m_generation = 0;
     size_t                  m_cursor = 0;
+    size_t                  m_epoch = 0;    // Changes whenever m_roots is replaced.
     std::vector<std::shared_ptr<DirNode>> m_roots;
     bool                    m_fullscan = false;
     bool                    m_new_roots = false;
+    std::vector<Replaced>   m_replaced;     // (original, shadow) pairs.
     std::unique_ptr<std::thread> m_thread;
 
+    std::mutex              m_mounts_mutex; // Never held while acquiring another lock.
+    std::vector<std::shared_ptr<MountPointNode>> m_mounts;
+
     std::recursive_mutex&   m_ui_mutex;
     std::shared_ptr<Node>   m_current;
 };
@@ -406,10 +440,8 @@ std::vector<std::shared_ptr<DirNode>> ScannerThread::Start(int argc, const WCHAR
     return roots;
 }
 
-void ScannerThread::Start(const std::shared_ptr<DirNode>& dir)
+void ScannerThread::Start(const std::vector<std::shared_ptr<DirNode>>& dirs)
 {
-    std::vector<std::shared_ptr<DirNode>> dirs;
-    dirs.emplace_back(dir);
     StartInternal(dirs, false);
 }
 
@@ -429,6 +461,10 @@ void ScannerThread::StartInternal(const std::vector<std::shared_ptr<DirNode>>& r
             m_current.reset();
             m_roots = roots;
             m_cursor = 0;
+            ++m_epoch;
+
+            std::lock_guard<std::mutex> lock3(m_mounts_mutex);
+            m_mounts.clear();
         }
         else
         {
@@ -448,6 +484,10 @@ void ScannerThread::Stop()
     if (m_thread)
     {
         SetEvent(m_hStop);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_epoch;
+        }
         InterlockedIncrement(&m_generation);
         m_thread->join();
 
@@ -459,6 +499,9 @@ void ScannerThread::Stop()
         m_cursor = 0;
         m_fullscan = false;
         m_new_roots = false;
+        // Keep m_replaced; those shadows are already attached, and the UI
+        // still needs TakeReplaced() to remap its roots away from the
+        // originals.
         ResetEvent(m_hStop);
     }
 }
@@ -469,6 +512,43 @@ bool ScannerThread::IsComplete()
     return m_roots.empty();
 }
 
+void ScannerThread::TakeReplaced(std::vector<Replaced>& out)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    out.swap(m_replaced);
+    m_replaced.clear();
+}
+
+void ScannerThread::GetVolumeBreakdown(const std::shared_ptr<DirNode>& root, std::vector<VolumeUsage>& out)
+{
+    std::lock_guard<std::mutex> lock(m_mounts_mutex);
+
+    out.clear();
+    out.push_back({ root, root->GetSize() });
+    for (const auto& mount : m_mounts)
+    {
+        if (is_under(mount, root.get()))
+            out.push_back({ mount, mount->GetSize() });
+    }
+
+    // Each volume's usage excludes volumes mounted within it.
+    for (size_t ii = 1; ii < out.size(); ++ii)
+    {
+        for (std::shared_ptr<DirNode> parent = out[ii].m_dir->GetParent(); parent; parent = parent->GetParent())
+        {
+            const auto enclosing = std::find_if(out.begin(), out.end(), [&parent](const VolumeUsage& v){ return v.m_dir == parent; });
+            if (enclosing != out.end())
+            {
+                enclosing->m_size -= std::min(enclosing->m_size, out[ii].m_size);
+                break;
+            }
+        }
+    }
+
+    if (out.size() < 2)
+        out.clear();
+}
+
 void ScannerThread::GetScanningPath(std::wstring& out)
 {
     std::lock_guard<std::recursive_mutex> lock(m_ui_mutex);
@@ -493,6 +573,17 @@ void ScannerThread::ThreadProc(ScannerThread* pThis)
 
         const LONG generation = pThis->m_generation;
         ScanContext context = { pThis->m_ui_mutex, pThis->m_current, g_use_compressed_size };
+        context.use_size_on_disk = g_use_size_on_disk;
+        context.count_links_once = g_count_links_once;
+        context.cross_mount_points = g_cross_mount_points;
+        context.file_id_order = g_scan_disk_order;
+        context.background = g_scan_low_priority;
+        context.group_small_files = g_group_small_files;
+
+        // The resource limits are only configurable in the registry.
+        context.ops_per_sec = unsigned(std::max<LONG>(0, ReadRegLong(TEXT("ScanMaxReadsPerSecond"), 0)));
+        context.memory_soft_limit = ULONGLONG(std::max<LONG>(0, ReadRegLong(TEXT("ScanMemorySoftLimitMB"), 0))) << 20;
+        context.collapse_below = ULONGLONG(std::max<LONG>(0, ReadRegLong(TEXT("ScanCollapseBelowKB"), 64))) << 10;
 
         if (!g_show_dontscan_anyway)
             ReadRegStrings(TEXT("DontScanDirectories"), context.dontscan);
@@ -502,13 +593,18 @@ void ScannerThread::ThreadProc(ScannerThread* pThis)
 
         while (generation == pThis->m_generation)
         {
-            std::shared_ptr<DirNode> root;
+            std::vector<std::shared_ptr<DirNode>> batch;
+            std::vector<std::shared_ptr<DirNode>> mounts;
+            bool fullscan = false;
+            size_t epoch = 0;
 
             {
                 std::lock_guard<std::mutex> lock(pThis->m_mutex);
 
                 if (pThis->m_cursor >= pThis->m_roots.size())
                 {
+                    std::lock_guard<std::recursive_mutex> lock2(pThis->m_ui_mutex);
+
                     // This is important for the Rescan case.
                     for (const auto& top : pThis->m_roots)
                     {
@@ -522,8 +618,6 @@ void ScannerThread::ThreadProc(ScannerThread* pThis)
                         }
                     }
 
-                    std::lock_guard<std::recursive_mutex> lock2(pThis->m_ui_mutex);
-
                     pThis->m_current.reset();
                     pThis->m_roots.clear();
                     pThis->m_cursor = 0;
@@ -555,11 +649,16 @@ void ScannerThread::ThreadProc(ScannerThread* pThis)
                         }
                         else
                         {
-                            // For each drive, update its free space.  This is
-                            // intended for the Rescan case.
+                            // For each drive or mount point, update its free
+                            // space.  This is intended for the Rescan case.
                             std::shared_ptr<DirNode> parent = root;
                             while (parent)
                             {
+                                if (parent->IsMountPoint())
+                                {
+                                    mounts.emplace_back(parent);
+                                    break;
+                                }
                                 std::shared_ptr<DirNode> up = parent->GetParent();
                                 if (!up)
                                     break;
@@ -574,12 +673,173 @@ void ScannerThread::ThreadProc(ScannerThread* pThis)
                     }
                 }
 
-                root = pThis->m_roots[pThis->m_cursor++];
+                batch.assign(pThis->m_roots.begin() + pThis->m_cursor, pThis->m_roots.end());
+                pThis->m_cursor = pThis->m_roots.size();
+                fullscan = pThis->m_fullscan;
+                epoch = pThis->m_epoch;
+            }
+
+            // Querying a volume can be slow, so it's done without holding
+            // any locks.
+            for (const auto& mount : mounts)
+                mount->AsMountPoint()->AddFreeSpace(pThis->m_ui_mutex);
+
+            // Roots on different volumes are scanned concurrently, each
+            // with its own pool; roots on the same volume are scanned one
+            // after another.
+            std::vector<std::wstring> volumes;
+            std::vector<std::vector<std::shared_ptr<DirNode>>> groups;
+            for (const auto& root : batch)
+            {
+                std::wstring volume;
+                GetScanVolume(root, volume);
+
+                size_t index = 0;
+                while (index < volumes.size() && wcsicmp(volumes[index].c_str(), volume.c_str()))
+                    ++index;
+                if (index == volumes.size())
+                {
+                    volumes.emplace_back(std::move(volume));
+                    groups.emplace_back();
+                }
+                groups[index].emplace_back(root);
+            }
+
+            std::vector<std::vector<std::shared_ptr<DirNode>>> unfinished(groups.size());
+            std::vector<std::thread> threads;
+            for (size_t ii = 1; ii < groups.size(); ++ii)
+            {
+                threads.emplace_back([pThis, &groups, &unfinished, ii, generation, fullscan, context]() mutable
+                {
+                    for (const auto& root : groups[ii])
+                    {
+                        if (!pThis->ScanRoot(root, fullscan, generation, context))
+                            unfinished[ii].emplace_back(root);
+                    }
+                });
+            }
+
+            for (const auto& root : groups[0])
+            {
+                if (!pThis->ScanRoot(root, fullscan, generation, context))
+                    unfinished[0].emplace_back(root);
+            }
+
+            for (auto& thread : threads)
+                thread.join();
+
+            // Starting more roots interrupts the batch, so the roots it
+            // didn't finish go back in line ahead of the new ones.  When the
+            // roots were replaced or the scanner is stopping, they're
+            // simply dropped.
+            std::lock_guard<std::mutex> lock(pThis->m_mutex);
+            if (epoch == pThis->m_epoch)
+            {
+                std::lock_guard<std::recursive_mutex> lock2(pThis->m_ui_mutex);
+
+                std::vector<std::shared_ptr<DirNode>> restart;
+                for (const auto& roots : unfinished)
+                {
+                    for (const auto& root : roots)
+                    {
+                        std::shared_ptr<DirNode> fresh = RestartRoot(root);
+                        if (fresh)
+                            restart.emplace_back(std::move(fresh));
+                    }
+                }
+                pThis->m_roots.insert(pThis->m_roots.begin() + pThis->m_cursor, restart.begin(), restart.end());
             }
+        }
+    }
+}
+
+bool ScannerThread::ScanRoot(const std::shared_ptr<DirNode>& root, const bool fullscan, const LONG generation, ScanContext& context)
+{
+    if (generation != m_generation)
+        return false;
+
+    // Only full scans of top level roots are checkpointed; Rescan
+    // is expected to produce fresh results.
+    if (g_resume_scans && fullscan && !root->GetParent())
+    {
+#ifdef DEBUG
+        if (!g_fake_data)
+#endif
+        {
+            std::wstring path;
+            root->GetFullPath(path);
+            const DWORD options = ((context.use_compressed_size ? CPF_COMPRESSED : CPF_NONE) |
+                                   (context.use_size_on_disk ? CPF_SIZE_ON_DISK : CPF_NONE) |
+                                   (context.count_links_once ? CPF_LINKS_ONCE : CPF_NONE) |
+                                   (context.cross_mount_points ? CPF_CROSS_MOUNTS : CPF_NONE));
+            context.checkpoint = ScanCheckpoint::Open(path.c_str(), options);
+        }
+    }
+
+    Scan(root, generation, &m_generation, context);
+
+    // A rescan builds a shadow subtree while the original stays
+    // visible.  Swap it in with one update under the UI mutex, so
+    // readers never see a partially scanned subtree.  A cancelled
+    // rescan just drops the shadow.
+    const bool shadow = root->IsShadow();
+    std::shared_ptr<DirNode> original;
+    if (shadow && generation == m_generation)
+    {
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_ui_mutex);
+            original = root->Attach();
+        }
 
-            Scan(root, generation, &pThis->m_generation, context);
+        if (original)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_replaced.emplace_back(original, root);
         }
     }
+
+    if (!shadow || original)
+    {
+        // Mount points found by an earlier scan of the same subtree
+        // are stale now.
+        const DirNode* const scanned = original ? original.get() : root.get();
+
+        std::lock_guard<std::mutex> lock(m_mounts_mutex);
+        auto& mounts = m_mounts;
+        mounts.erase(std::remove_if(mounts.begin(), mounts.end(), [scanned](const std::shared_ptr<MountPointNode>& mount){ return is_under(mount, scanned); }), mounts.end());
+        if (root->IsMountPoint() && root->GetParent())
+            mounts.emplace_back(std::static_pointer_cast<MountPointNode>(root));
+        mounts.insert(mounts.end(), context.mounts.begin(), context.mounts.end());
+    }
+    context.mounts.clear();
+
+    if (context.checkpoint)
+    {
+        // A completed scan has nothing left to resume.
+        if (generation == m_generation)
+            context.checkpoint->Discard();
+        context.checkpoint.reset();
+    }
+
+    return (generation == m_generation);
+}
+
+std::shared_ptr<DirNode> ScannerThread::RestartRoot(const std::shared_ptr<DirNode>& root)
+{
+    // Called with m_ui_mutex held.  A root may have been partly scanned, so
+    // it starts over the same way Rescan starts it:  a shadow is replaced
+    // by a fresh shadow, and anything else is cleared.
+    if (root->IsShadow())
+    {
+        const std::shared_ptr<DirNode> original = root->GetOriginal();
+        std::shared_ptr<DirNode> shadow = original ? original->MakeShadow() : nullptr;
+        if (shadow)
+            shadow->SetCompressed(root->IsCompressed());
+        return shadow;
+    }
+
+    root->Clear();
+    return root;
 }
 
 //----------------------------------------------------------------------------
@@ -961,6 +1221,758 @@ void Buttons::SuppressDescriptionTemporarily(const UINT id)
     }
 }
 
+//----------------------------------------------------------------------------
+// LayoutThread.
+//
+// Building the rings for a large tree can take much longer than a frame, so
+// it happens on a dedicated thread instead of in WM_PAINT.  Each paint asks
+// for a layout that matches its current inputs, and immediately paints the
+// latest completed layout.  Only the newest request is kept:  it replaces a
+// pending one, and cancels the layout in progress if its inputs differ.  A
+// layout in progress with the same inputs is allowed to finish, so that a
+// stream of paints (e.g. from hovering) can't starve it.
+//
+// Finished layouts are published with an atomic swap, and the window is only
+// notified when the result differs from the previous one, so that painting
+// the new layout doesn't lead to an endless series of layouts.
+
+#define WMU_LAYOUTREADY         (WM_USER + 9990)
+
+struct LayoutRequest
+{
+    bool                    SameInputs(const LayoutRequest& other) const;
+
+    std::vector<std::shared_ptr<DirNode>> m_roots;
+    DpiScaler               m_dpi;
+    D2D1_RECT_F             m_bounds = D2D1::RectF();
+    FLOAT                   m_max_extent = 0;
+    bool                    m_dark_mode = false;
+    bool                    m_show_free_space = false;
+    bool                    m_proportional_area = false;
+    long                    m_color_mode = 0;
+    size_t                  m_max_depth = 0;    // See Sunburst::SetLayoutBudget.
+    size_t                  m_max_arcs = 0;
+    LONGLONG                m_requested = 0;    // GetMicroseconds() when requested.
+};
+
+bool LayoutRequest::SameInputs(const LayoutRequest& other) const
+{
+    return (m_roots == other.m_roots &&
+            m_dpi.IsDpiEqual(other.m_dpi) &&
+            !memcmp(&m_bounds, &other.m_bounds, sizeof(m_bounds)) &&
+            m_max_extent == other.m_max_extent &&
+            m_dark_mode == other.m_dark_mode &&
+            m_show_free_space == other.m_show_free_space &&
+            m_proportional_area == other.m_proportional_area &&
+            m_color_mode == other.m_color_mode &&
+            m_max_depth == other.m_max_depth &&
+            m_max_arcs == other.m_max_arcs);
+}
+
+// Navigating Back and Forward (or Up and back down) lays out the same roots
+// again, so recent complete layouts are kept in a small LRU cache, keyed by
+// the request's inputs.  Their display lists come along, since a Sunburst
+// retains its own.  An entry is only valid while the change generations of
+// its roots match the ones saved when its layout started; heatmap colors are
+// relative to each root's topmost ancestor, so with those the ancestors'
+// generations are saved too.  The cache is capped by an estimate of the
+// memory the layouts hold.  That estimate doesn't include the nodes a layout
+// keeps alive, so entries that refer to subtrees replaced by a rescan are
+// evicted right away, instead of pinning the old subtrees.
+
+static const size_t c_layout_cache_max_entries = 16;
+
+class LayoutCache
+{
+public:
+    void                    SetCapacity(size_t bytes) { m_capacity = bytes; }
+    std::shared_ptr<Sunburst> Find(const LayoutRequest& request);
+    bool                    Contains(const LayoutRequest& request) const;
+    void                    Add(const LayoutRequest& request, std::vector<ULONGLONG>&& generations, const std::shared_ptr<Sunburst>& sunburst, bool speculative=false);
+    void                    EvictReplaced(const std::vector<std::shared_ptr<DirNode>>& originals);
+    void                    Clear();
+
+    static void             GetGenerations(const LayoutRequest& request, std::vector<ULONGLONG>& out);
+
+    size_t                  GetBytes() const { return m_bytes; }
+    size_t                  GetCount() const { return m_entries.size(); }
+    LONG                    GetHits() const { return m_hits; }
+    LONG                    GetMisses() const { return m_misses; }
+    LONG                    GetSpeculativeHits() const { return m_speculative_hits; }
+
+private:
+    struct Entry
+    {
+        LayoutRequest       m_request;
+        std::vector<ULONGLONG> m_generations;   // See GetGenerations.
+        std::shared_ptr<Sunburst> m_sunburst;
+        size_t              m_bytes = 0;
+        bool                m_speculative = false;  // Speculated, and not used yet.
+    };
+
+    std::list<Entry>        m_entries;      // Most recently used first.
+    size_t                  m_bytes = 0;
+    size_t                  m_capacity = 0;
+    LONG                    m_hits = 0;
+    LONG                    m_misses = 0;
+    LONG                    m_speculative_hits = 0;
+};
+
+void LayoutCache::GetGenerations(const LayoutRequest& request, std::vector<ULONGLONG>& out)
+{
+    out.clear();
+    for (const auto& root : request.m_roots)
+    {
+        out.emplace_back(root->GetChangeGeneration());
+
+        if (request.m_color_mode == CM_HEATMAP)
+        {
+            std::shared_ptr<DirNode> top = root;
+            for (std::shared_ptr<DirNode> up = top->GetParent(); up; up = up->GetParent())
+                top = up;
+            out.emplace_back(top->GetChangeGeneration());
+        }
+    }
+}
+
+std::shared_ptr<Sunburst> LayoutCache::Find(const LayoutRequest& request)
+{
+    std::vector<ULONGLONG> generations;
+    GetGenerations(request, generations);
+
+    for (auto iter = m_entries.begin(); iter != m_entries.end(); ++iter)
+    {
+        if (!iter->m_request.SameInputs(request))
+            continue;
+
+        if (iter->m_generations != generations)
+        {
+            m_bytes -= iter->m_bytes;
+            m_entries.erase(iter);
+            break;
+        }
+
+        m_entries.splice(m_entries.begin(), m_entries, iter);
+        ++m_hits;
+
+        Entry& entry = m_entries.front();
+        if (entry.m_speculative)
+        {
+            entry.m_speculative = false;
+            ++m_speculative_hits;
+        }
+        return entry.m_sunburst;
+    }
+
+    ++m_misses;
+    return nullptr;
+}
+
+bool LayoutCache::Contains(const LayoutRequest& request) const
+{
+    std::vector<ULONGLONG> generations;
+    GetGenerations(request, generations);
+
+    for (const auto& entry : m_entries)
+    {
+        if (entry.m_request.SameInputs(request))
+            return (entry.m_generations == generations);
+    }
+
+    return false;
+}
+
+void LayoutCache::Add(const LayoutRequest& request, std::vector<ULONGLONG>&& generations, const std::shared_ptr<Sunburst>& sunburst, const bool speculative)
+{
+    for (auto iter = m_entries.begin(); iter != m_entries.end(); ++iter)
+    {
+        if (iter->m_request.SameInputs(request))
+        {
+            m_bytes -= iter->m_bytes;
+            m_entries.erase(iter);
+            break;
+        }
+    }
+
+    const size_t bytes = sunburst->GetLayoutBytes();
+    if (bytes > m_capacity)
+        return;
+
+    m_entries.emplace_front();
+    Entry& entry = m_entries.front();
+    entry.m_request = request;
+    entry.m_generations = std::move(generations);
+    entry.m_sunburst = sunburst;
+    entry.m_bytes = bytes;
+    entry.m_speculative = speculative;
+    m_bytes += bytes;
+
+    while (m_entries.size() > c_layout_cache_max_entries || m_bytes > m_capacity)
+    {
+        m_bytes -= m_entries.back().m_bytes;
+        m_entries.pop_back();
+    }
+
+    TRACE_COUNTER("layout cache KB", m_bytes / 1024);
+}
+
+void LayoutCache::EvictReplaced(const std::vector<std::shared_ptr<DirNode>>& originals)
+{
+    std::vector<ULONGLONG> generations;
+    for (auto iter = m_entries.begin(); iter != m_entries.end();)
+    {
+        // Roots inside a replaced subtree are detached now, and ancestors
+        // of one have a new change generation.
+        bool evict = false;
+        for (const auto& root : iter->m_request.m_roots)
+        {
+            for (const auto& original : originals)
+                evict = evict || is_under(root, original.get());
+        }
+        if (!evict)
+        {
+            GetGenerations(iter->m_request, generations);
+            evict = (iter->m_generations != generations);
+        }
+
+        if (evict)
+        {
+            m_bytes -= iter->m_bytes;
+            iter = m_entries.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+
+    TRACE_COUNTER("layout cache KB", m_bytes / 1024);
+}
+
+void LayoutCache::Clear()
+{
+    m_entries.clear();
+    m_bytes = 0;
+}
+
+class LayoutThread
+{
+public:
+                            LayoutThread(std::recursive_mutex& ui_mutex);
+                            ~LayoutThread() { Stop(); }
+
+    void                    Request(HWND hwnd, const LayoutRequest& request);
+    void                    Stop();
+    void                    ClearCache();
+    void                    EvictReplaced(const std::vector<std::shared_ptr<DirNode>>& originals);
+
+    void                    Speculate(const LayoutRequest& request);
+    void                    CancelSpeculation();
+
+    std::shared_ptr<Sunburst> GetLatest() const { return std::atomic_load(&m_latest); }
+
+    LONGLONG                GetLatency() const { return m_latency_us; }
+    LONG                    GetCompleted() const { return m_completed; }
+    LONG                    GetDropped() const { return m_dropped; }
+    void                    GetCacheStats(size_t& bytes, size_t& count, LONG& hits, LONG& misses);
+    void                    GetSpeculationStats(LONG& completed, LONG& canceled, LONG& used);
+
+protected:
+    static void             ThreadProc(LayoutThread* pThis);
+    static void             SpeculateProc(LayoutThread* pThis);
+
+private:
+    std::mutex              m_mutex;
+    std::condition_variable m_cv;
+    bool                    m_stop = false;
+    bool                    m_busy = false;
+    bool                    m_has_pending = false;
+    LayoutRequest           m_pending;
+    LayoutRequest           m_running;      // Inputs for the layout in progress (when m_busy).
+    HWND                    m_hwnd = 0;
+    volatile LONG           m_generation = 0;
+    std::unique_ptr<std::thread> m_thread;
+
+    std::recursive_mutex&   m_ui_mutex;
+    std::shared_ptr<Sunburst> m_latest;     // Only accessed with std::atomic_load and std::atomic_store.
+    LayoutCache             m_cache;        // Protected by m_mutex.
+
+    volatile LONGLONG       m_latency_us = 0; // From request to publish, for the latest layout.
+    volatile LONG           m_completed = 0;
+    volatile LONG           m_dropped = 0;  // Replaced while pending, or canceled while in progress.
+
+    std::condition_variable m_speculate_cv;
+    bool                    m_has_speculative = false;
+    bool                    m_speculating = false;
+    LayoutRequest           m_speculative;  // Pending speculation.
+    LayoutRequest           m_speculating_request; // Inputs for the speculation in progress (when m_speculating).
+    volatile LONG           m_speculate_generation = 0;
+    std::unique_ptr<std::thread> m_speculate_thread;
+    volatile LONG           m_speculated = 0;
+    volatile LONG           m_speculate_canceled = 0;
+};
+
+LayoutThread::LayoutThread(std::recursive_mutex& ui_mutex)
+: m_ui_mutex(ui_mutex)
+{
+    m_cache.SetCapacity(size_t(std::max<LONG>(0, ReadRegLong(TEXT("LayoutCacheMB"), 64))) * 1024 * 1024);
+}
+
+void LayoutThread::Request(const HWND hwnd, const LayoutRequest& request)
+{
+    if (!m_thread)
+        m_thread = std::make_unique<std::thread>(ThreadProc, this);
+
+    bool published = false;
+    LONG hits = 0;
+    LONG speculative_hits = 0;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // A cached layout is published right away, so the paint that asked
+        // for it can already use it.
+        if (request.m_max_depth == 0 && request.m_max_arcs == 0)
+        {
+            std::shared_ptr<Sunburst> cached = m_cache.Find(request);
+            if (cached)
+            {
+                if (m_has_pending && !m_pending.SameInputs(request))
+                    InterlockedIncrement(&m_dropped);
+                if (m_busy)
+                    InterlockedIncrement(&m_generation);
+
+                m_has_pending = false;
+                m_pending.m_roots.clear();
+                m_latency_us = 0;
+                std::atomic_store(&m_latest, cached);
+                published = true;
+                hits = m_cache.GetHits();
+                speculative_hits = m_cache.GetSpeculativeHits();
+            }
+        }
+    }
+
+    if (published)
+    {
+        TRACE_COUNTER("layout cache hits", hits);
+        TRACE_COUNTER("speculative layout hits", speculative_hits);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Repeating the same request only coalesces; latency is measured
+        // from the first one.
+        LONGLONG requested = request.m_requested;
+        if (m_has_pending)
+        {
+            if (m_pending.SameInputs(request))
+                requested = m_pending.m_requested;
+            else
+                InterlockedIncrement(&m_dropped);
+        }
+
+        if (m_busy && !m_running.SameInputs(request))
+            InterlockedIncrement(&m_generation);
+
+        // Something changed, so whatever is being speculated is probably
+        // moot; it would also compete with this layout for the tree.
+        if (m_speculating && !m_speculating_request.SameInputs(request))
+            InterlockedIncrement(&m_speculate_generation);
+
+        m_hwnd = hwnd;
+        m_pending = request;
+        m_pending.m_requested = requested;
+        m_has_pending = true;
+    }
+
+    m_cv.notify_one();
+}
+
+void LayoutThread::Stop()
+{
+    if (m_thread || m_speculate_thread)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+            InterlockedIncrement(&m_generation);
+            InterlockedIncrement(&m_speculate_generation);
+        }
+
+        m_cv.notify_one();
+        m_speculate_cv.notify_one();
+        if (m_thread)
+        {
+            m_thread->join();
+            m_thread.reset();
+        }
+        if (m_speculate_thread)
+        {
+            m_speculate_thread->join();
+            m_speculate_thread.reset();
+        }
+
+        m_stop = false;
+        m_has_pending = false;
+        m_pending = LayoutRequest();
+        m_has_speculative = false;
+        m_speculative = LayoutRequest();
+        m_cache.Clear();
+        std::atomic_store(&m_latest, std::shared_ptr<Sunburst>());
+    }
+}
+
+void LayoutThread::ClearCache()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cache.Clear();
+}
+
+void LayoutThread::EvictReplaced(const std::vector<std::shared_ptr<DirNode>>& originals)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cache.EvictReplaced(originals);
+}
+
+void LayoutThread::GetCacheStats(size_t& bytes, size_t& count, LONG& hits, LONG& misses)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bytes = m_cache.GetBytes();
+    count = m_cache.GetCount();
+    hits = m_cache.GetHits();
+    misses = m_cache.GetMisses();
+}
+
+// Speculation lays out a directory the user is likely to zoom into next, at
+// low priority, and parks the result in the cache, where the zoom's own
+// request finds it.  Only one speculation is pending or in progress at a
+// time, and a newer one cancels it.
+
+void LayoutThread::Speculate(const LayoutRequest& request)
+{
+    if (!m_speculate_thread)
+        m_speculate_thread = std::make_unique<std::thread>(SpeculateProc, this);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (m_speculating && m_speculating_request.SameInputs(request))
+            return;
+        if (m_cache.Contains(request))
+            return;
+
+        if (m_speculating)
+            InterlockedIncrement(&m_speculate_generation);
+
+        m_speculative = request;
+        m_has_speculative = true;
+    }
+
+    m_speculate_cv.notify_one();
+}
+
+void LayoutThread::CancelSpeculation()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_has_speculative = false;
+    m_speculative.m_roots.clear();
+    if (m_speculating)
+        InterlockedIncrement(&m_speculate_generation);
+}
+
+void LayoutThread::GetSpeculationStats(LONG& completed, LONG& canceled, LONG& used)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    completed = m_speculated;
+    canceled = m_speculate_canceled;
+    used = m_cache.GetSpeculativeHits();
+}
+
+static std::shared_ptr<Sunburst> build_layout(const LayoutRequest& request, std::recursive_mutex& ui_mutex, const volatile LONG* cancel, const LONG generation, const bool parallel)
+{
+    std::shared_ptr<Sunburst> sunburst = std::make_shared<Sunburst>();
+
+    SunburstMetrics mx(request.m_dpi, request.m_bounds, request.m_max_extent, request.m_proportional_area);
+    sunburst->UseDarkMode(request.m_dark_mode);
+    sunburst->SetChartOptions(request.m_show_free_space, request.m_proportional_area, request.m_color_mode);
+    sunburst->OnDpiChanged(request.m_dpi);
+    sunburst->SetBounds(request.m_bounds, request.m_max_extent);
+    sunburst->SetLayoutBudget(request.m_max_depth, request.m_max_arcs);
+    sunburst->SetLayoutMutex(&ui_mutex);
+    sunburst->SetLayoutCancel(cancel, generation);
+    sunburst->SetLayoutParallel(parallel);
+    sunburst->BuildRings(mx, request.m_roots);
+
+    return sunburst;
+}
+
+void LayoutThread::ThreadProc(LayoutThread* pThis)
+{
+    while (true)
+    {
+        LayoutRequest request;
+        std::vector<ULONGLONG> generations;
+        LONG generation = 0;
+        HWND hwnd = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(pThis->m_mutex);
+
+            pThis->m_busy = false;
+            pThis->m_cv.wait(lock, [pThis]{ return pThis->m_stop || pThis->m_has_pending; });
+            if (pThis->m_stop)
+                break;
+
+            request = pThis->m_pending;
+            pThis->m_pending.m_roots.clear();
+            pThis->m_has_pending = false;
+            pThis->m_running = request;
+            pThis->m_busy = true;
+            generation = pThis->m_generation;
+            hwnd = pThis->m_hwnd;
+        }
+
+        // Saved before the layout starts, so that changes made while it's
+        // in progress invalidate it in the cache.
+        LayoutCache::GetGenerations(request, generations);
+
+        std::shared_ptr<Sunburst> sunburst;
+        {
+            TRACE_SCOPE("Layout");
+            sunburst = build_layout(request, pThis->m_ui_mutex, &pThis->m_generation, generation, true/*parallel*/);
+        }
+
+        if (sunburst->IsLayoutCanceled() || generation != pThis->m_generation)
+        {
+            InterlockedIncrement(&pThis->m_dropped);
+            TRACE_COUNTER("layouts dropped", pThis->m_dropped);
+            continue;
+        }
+
+        InterlockedIncrement(&pThis->m_completed);
+
+        if (request.m_max_depth == 0 && request.m_max_arcs == 0)
+        {
+            std::lock_guard<std::mutex> lock(pThis->m_mutex);
+            pThis->m_cache.Add(request, std::move(generations), sunburst);
+        }
+
+        // The UI thread only changes the display list and selection of the
+        // published layout, and SameLayout doesn't look at those.
+        const std::shared_ptr<Sunburst> published = std::atomic_load(&pThis->m_latest);
+        if (published && published->SameLayout(*sunburst))
+            continue;
+
+        pThis->m_latency_us = GetMicroseconds() - request.m_requested;
+        TRACE_COUNTER("layout latency us", pThis->m_latency_us);
+
+        std::atomic_store(&pThis->m_latest, sunburst);
+
+        PostMessage(hwnd, WMU_LAYOUTREADY, 0, 0);
+    }
+}
+
+void LayoutThread::SpeculateProc(LayoutThread* pThis)
+{
+    // Speculation should only use otherwise idle time, so it runs at low
+    // priority, and builds each ring on just this thread.
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+
+    while (true)
+    {
+        LayoutRequest request;
+        std::vector<ULONGLONG> generations;
+        LONG generation = 0;
+
+        {
+            std::unique_lock<std::mutex> lock(pThis->m_mutex);
+
+            pThis->m_speculating = false;
+            pThis->m_speculating_request.m_roots.clear();
+            pThis->m_speculate_cv.wait(lock, [pThis]{ return pThis->m_stop || pThis->m_has_speculative; });
+            if (pThis->m_stop)
+                break;
+
+            request = pThis->m_speculative;
+            pThis->m_speculative.m_roots.clear();
+            pThis->m_has_speculative = false;
+            pThis->m_speculating_request = request;
+            pThis->m_speculating = true;
+            generation = pThis->m_speculate_generation;
+        }
+
+        LayoutCache::GetGenerations(request, generations);
+
+        std::shared_ptr<Sunburst> sunburst;
+        {
+            TRACE_SCOPE("Speculative layout");
+            sunburst = build_layout(request, pThis->m_ui_mutex, &pThis->m_speculate_generation, generation, false/*parallel*/);
+        }
+
+        if (sunburst->IsLayoutCanceled() || generation != pThis->m_speculate_generation)
+        {
+            InterlockedIncrement(&pThis->m_speculate_canceled);
+            continue;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(pThis->m_mutex);
+            pThis->m_cache.Add(request, std::move(generations), sunburst, true/*speculative*/);
+        }
+
+        InterlockedIncrement(&pThis->m_speculated);
+        TRACE_COUNTER("speculative layouts", pThis->m_speculated);
+    }
+}
+
+//----------------------------------------------------------------------------
+// ProgressiveLayout.
+//
+// While a scan is running, every progress tick lays out a tree that keeps
+// changing, while holding the UI mutex and so stalling the scanner.  Detail
+// isn't readable mid-scan anyway, so layout is limited to a depth and arc
+// budget that adapts to keep the measured layout time within a target.  Once
+// the scan is complete, layout goes back to full detail.
+
+static const size_t c_progressive_min_depth = 2;
+static const size_t c_progressive_initial_depth = 4;
+static const size_t c_progressive_min_arcs = 500;
+static const size_t c_progressive_initial_arcs = 5000;
+
+class ProgressiveLayout
+{
+public:
+    void                    Apply(LayoutRequest& request, bool scanning);
+    void                    Measure(const Sunburst& sunburst);
+
+    bool                    IsActive() const { return m_active; }
+    LONGLONG                GetBudget() const { return m_budget_us; }
+    LONGLONG                GetLayoutTime() const { return m_layout_us; }
+    size_t                  GetDepth() const { return m_depth; }
+    size_t                  GetArcs() const { return m_arcs; }
+
+private:
+    bool                    m_active = false;
+    LONGLONG                m_budget_us = 0;
+    size_t                  m_max_depth = c_progressive_initial_depth;
+    size_t                  m_max_arcs = c_progressive_initial_arcs;
+    LONGLONG                m_layout_us = 0;    // Last measured layout.
+    size_t                  m_depth = 0;        // Depth the last layout achieved.
+    size_t                  m_arcs = 0;         // Arcs the last layout produced.
+};
+
+void ProgressiveLayout::Apply(LayoutRequest& request, const bool scanning)
+{
+    if (scanning && !m_active)
+    {
+        // Each scan starts coarse, and refines as frame times allow.
+        m_budget_us = LONGLONG(std::max<LONG>(1, ReadRegLong(TEXT("ScanFrameBudgetMs"), 20))) * 1000;
+        m_max_depth = c_progressive_initial_depth;
+        m_max_arcs = c_progressive_initial_arcs;
+    }
+    m_active = scanning;
+
+    if (m_active)
+    {
+        request.m_max_depth = m_max_depth;
+        request.m_max_arcs = m_max_arcs;
+    }
+}
+
+void ProgressiveLayout::Measure(const Sunburst& sunburst)
+{
+    const LONGLONG elapsed_us = sunburst.GetLayoutTime();
+
+    m_layout_us = elapsed_us;
+    m_depth = sunburst.GetLayoutDepth();
+    m_arcs = sunburst.GetLayoutArcs();
+
+    if (m_active)
+    {
+        if (elapsed_us > m_budget_us)
+        {
+            // Over budget:  scale the arcs down in proportion, and give up
+            // a ring when far over.
+            m_max_arcs = std::max<size_t>(c_progressive_min_arcs, size_t(double(m_arcs) * m_budget_us / elapsed_us));
+            if (elapsed_us > m_budget_us * 2 && m_max_depth > c_progressive_min_depth)
+                --m_max_depth;
+        }
+        else if (elapsed_us < m_budget_us / 2 && sunburst.IsLayoutTruncated())
+        {
+            // Well under budget:  refine gradually.
+            m_max_arcs += m_max_arcs / 2;
+            if (m_depth >= m_max_depth && m_max_depth < MAX_SUNBURST_DEPTH)
+                ++m_max_depth;
+        }
+    }
+
+    TRACE_COUNTER("layout time us", m_layout_us);
+    TRACE_COUNTER("layout budget us", m_active ? m_budget_us : 0);
+    TRACE_COUNTER("layout depth", m_depth);
+    TRACE_COUNTER("layout arcs", m_arcs);
+}
+
+//----------------------------------------------------------------------------
+// Expander.
+//
+// Expanding grouped small files reads the directory again, so it runs on a
+// worker thread.  One expansion runs at a time, and the window gets
+// WMU_EXPANDED when it's done; WPARAM says whether the group was expanded.
+
+#define WMU_EXPANDED            (WM_USER + 9989)
+#define WMU_BULKDELETE          (WM_USER + 9988)
+
+class Expander
+{
+public:
+                            ~Expander() { Finish(); }
+
+    bool                    Start(HWND hwnd, const std::shared_ptr<DirNode>& dir, ULONGLONG below, std::recursive_mutex& ui_mutex);
+    std::shared_ptr<DirNode> Finish(ULONGLONG* below=nullptr);
+
+protected:
+    static void             ThreadProc(HWND hwnd, std::shared_ptr<DirNode> dir, std::recursive_mutex* ui_mutex);
+
+private:
+    std::shared_ptr<DirNode> m_dir;
+    ULONGLONG               m_below = 0;    // For collapsing the files again.
+    std::unique_ptr<std::thread> m_thread;
+};
+
+bool Expander::Start(const HWND hwnd, const std::shared_ptr<DirNode>& dir, const ULONGLONG below, std::recursive_mutex& ui_mutex)
+{
+    if (m_thread)
+        return false;
+
+    m_dir = dir;
+    m_below = below;
+    m_thread = std::make_unique<std::thread>(ThreadProc, hwnd, dir, &ui_mutex);
+    return true;
+}
+
+std::shared_ptr<DirNode> Expander::Finish(ULONGLONG* below)
+{
+    if (m_thread)
+    {
+        m_thread->join();
+        m_thread.reset();
+    }
+
+    if (below)
+        *below = m_below;
+    return std::move(m_dir);
+}
+
+void Expander::ThreadProc(const HWND hwnd, std::shared_ptr<DirNode> dir, std::recursive_mutex* ui_mutex)
+{
+    const bool expanded = ExpandAggregate(dir, *ui_mutex);
+    PostMessage(hwnd, WMU_EXPANDED, expanded, 0);
+}
+
 //----------------------------------------------------------------------------
 // MainWindow.
 
@@ -970,6 +1982,8 @@ class MainWindow
     {
         TIMER_PROGRESS          = 1,
         INTERVAL_PROGRESS               = 100,
+        TIMER_SPECULATE         = 2,
+        INTERVAL_SPECULATE              = 300,  // Hover dwell before speculating.
     };
 
 public:
@@ -992,7 +2006,10 @@ protected:
     void                    DrawNodeInfo(DirectHwndRenderTarget& target, D2D1_RECT_F rect, const std::shared_ptr<Node>& node, bool free_space);
     void                    DrawAppInfo(DirectHwndRenderTarget& target, D2D1_RECT_F rect);
 
+    std::shared_ptr<Node>   HitTest(POINT pt, bool* is_free=nullptr);
     void                    Expand(const std::shared_ptr<Node>& node);
+    void                    ExpandGroup(const std::shared_ptr<DirNode>& dir);
+    void                    CollapseExpanded();
     void                    SetRoot(const std::shared_ptr<DirNode>& root);
     void                    SetRoots(const std::vector<std::shared_ptr<DirNode>>& roots);
     void                    Up();
@@ -1000,10 +2017,18 @@ protected:
     void                    Forward();
     void                    Summary();
     void                    DeleteNode(const std::shared_ptr<Node>& node);
+    void                    DeleteNodes(const std::vector<std::shared_ptr<Node>>& nodes, bool permanent);
+    void                    RemoveDeleted(const std::vector<std::shared_ptr<Node>>& nodes);
+    void                    ToggleSelection(const std::shared_ptr<Node>& node);
+    void                    ClearSelection();
     void                    UpdateRecycleBin(const std::shared_ptr<RecycleBinNode>& recycle);
     void                    EnumDrives();
     void                    Refresh(bool all=false);
     void                    Rescan(const std::shared_ptr<DirNode>& dir);
+    void                    Rescan(const std::vector<std::shared_ptr<DirNode>>& dirs);
+    void                    ReplaceRescannedDirs();
+    void                    ExportImage(bool svg);
+    void                    Speculate();
 
     void                    SetFrameProgress(bool working);
 
@@ -1025,8 +2050,9 @@ private:
     bool                    m_inWmDpiChanged = false;
     RECT                    m_rcMonitor = {};
     LONG                    m_max_extent = 0;
+    D2D1_RECT_F             m_chart_bounds = D2D1::RectF();
 
-    std::recursive_mutex    m_ui_mutex; // Synchronize m_scanner vs m_sunburst.
+    std::recursive_mutex    m_ui_mutex; // Synchronize m_scanner vs m_layout and m_sunburst.
 
     std::vector<std::wstring> m_drives;
 
@@ -1035,13 +2061,22 @@ private:
     std::vector<std::shared_ptr<DirNode>> m_back_stack; // (nullptr means use m_original_roots)
     size_t                  m_back_current = 0;
     ScannerThread           m_scanner;
+    LayoutThread            m_layout;
+    LayoutRequest           m_layout_request;   // The latest paint's request.
 
     DirectHwndRenderTarget  m_directRender;
-    Sunburst                m_sunburst;
+    std::shared_ptr<Sunburst> m_sunburst;   // Latest layout adopted from m_layout; never null.
+    ArcTextFitCache         m_arc_text_fits;
+    ProgressiveLayout       m_progressive;
     Buttons                 m_buttons;
+    Expander                m_expander;
+    std::vector<std::pair<std::shared_ptr<DirNode>, ULONGLONG>> m_expanded; // (dir, collapse below) pairs.
 
     std::shared_ptr<Node>   m_hover_node;
     bool                    m_hover_free = false;
+    std::vector<std::shared_ptr<Node>> m_selection; // Ctrl+Click, for bulk delete.
+    std::unique_ptr<BulkDeleter> m_deleter;
+    std::vector<std::shared_ptr<Node>> m_deleting;  // Items m_deleter is deleting.
 
     bool                    m_dark_mode = false;
     bool                    m_ever_painted = false;
@@ -1066,6 +2101,8 @@ MainWindow::MainWindow(HINSTANCE hinst)
 : m_hinst(hinst)
 , m_sizeTracker(800, 600)
 , m_scanner(m_ui_mutex)
+, m_layout(m_ui_mutex)
+, m_sunburst(std::make_shared<Sunburst>())
 {
 }
 
@@ -1111,6 +2148,16 @@ HWND MainWindow::Create()
 void MainWindow::Scan(int argc, const WCHAR** argv, bool rescan)
 {
     SetFrameProgress(true);
+    ClearSelection();
+
+    // The previous scan's trees are torn down in the background, once
+    // nothing else (e.g. the current sunburst) refers to them.
+    if (!rescan)
+    {
+        m_layout.CancelSpeculation();
+        m_layout.ClearCache();
+        ReclaimInBackground(std::vector<std::shared_ptr<DirNode>>(m_original_roots), std::vector<std::shared_ptr<FileNode>>());
+    }
 
     SetRoots(m_scanner.Start(argc, argv));
     if (!rescan)
@@ -1150,11 +2197,52 @@ void MainWindow::SetRoots(const std::vector<std::shared_ptr<DirNode>>& roots)
     }
     SetWindowText(m_hwnd, title.c_str());
 
+    CollapseExpanded();
+
     InvalidateRect(m_hwnd, nullptr, false);
 }
 
+// A layout may have been made for other bounds than the chart's current
+// bounds (e.g. while resizing); this is the transform that scales it to fit.
+static bool get_layout_transform(const Sunburst& sunburst, const D2D1_RECT_F& bounds, D2D1::Matrix3x2F& transform)
+{
+    const D2D1_RECT_F& from = sunburst.GetBounds();
+    const FLOAT extent = from.right - from.left;
+    if (extent <= 0 || !memcmp(&from, &bounds, sizeof(from)))
+        return false;
+
+    const FLOAT scale = (bounds.right - bounds.left) / extent;
+    const D2D1_POINT_2F center = D2D1::Point2F((from.left + from.right) / 2, (from.top + from.bottom) / 2);
+    transform = (D2D1::Matrix3x2F::Scale(scale, scale, center) *
+                 D2D1::Matrix3x2F::Translation((bounds.left + bounds.right) / 2 - center.x, (bounds.top + bounds.bottom) / 2 - center.y));
+    return true;
+}
+
+std::shared_ptr<Node> MainWindow::HitTest(POINT pt, bool* is_free)
+{
+    D2D1::Matrix3x2F transform;
+    if (get_layout_transform(*m_sunburst, m_chart_bounds, transform) && transform.Invert())
+    {
+        const D2D1_POINT_2F point = transform.TransformPoint(D2D1::Point2F(FLOAT(pt.x), FLOAT(pt.y)));
+        pt.x = LONG(point.x);
+        pt.y = LONG(point.y);
+    }
+
+    SunburstMetrics mx(*m_sunburst);
+    return m_sunburst->HitTest(mx, pt, is_free);
+}
+
 void MainWindow::Expand(const std::shared_ptr<Node>& node)
 {
+    if (node && node->AsAggregate() && is_root_finished(node) && m_scanner.IsComplete())
+    {
+        // Expanding a group of small files brings back the individual files.
+        const std::shared_ptr<DirNode> parent = node->GetParent();
+        if (parent)
+            ExpandGroup(parent);
+        return;
+    }
+
     if (!node || node->AsFile() || node->AsRecycleBin() || node->AsFreeSpace() || !is_root_finished(node))
         return;
 
@@ -1177,18 +2265,97 @@ void MainWindow::Expand(const std::shared_ptr<Node>& node)
         else if (node->AsDir())
             dir = std::static_pointer_cast<DirNode>(node->AsDir()->shared_from_this());
 
-        if (!dir)
-            return;
+        if (!dir)
+            return;
+
+        // Zooming into a directory brings back its grouped small files.
+        if (!up && m_scanner.IsComplete())
+            ExpandGroup(dir);
+
+        SetRoot(dir);
+        back = dir;
+    }
+
+    assert(m_back_stack.size() > m_back_current);
+    m_back_stack.resize(++m_back_current);
+    m_back_stack.emplace_back(back);
+
+    InvalidateRect(m_hwnd, nullptr, false);
+}
+
+void MainWindow::ExpandGroup(const std::shared_ptr<DirNode>& dir)
+{
+    // Only files no larger than the largest one in the group get collapsed
+    // again later; the directory's other files were always too large.
+    for (const auto& file : dir->CopyFiles())
+    {
+        if (file->AsAggregate())
+        {
+            m_expander.Start(m_hwnd, dir, file->AsAggregate()->GetMaxSize() + 1, m_ui_mutex);
+            break;
+        }
+    }
+}
+
+void MainWindow::CollapseExpanded()
+{
+    // Expanded groups are collapsed again once their directory is out of
+    // view, so that browsing around doesn't keep growing the tree.
+    for (auto iter = m_expanded.begin(); iter != m_expanded.end();)
+    {
+        const std::shared_ptr<DirNode>& dir = iter->first;
+
+        bool visible = false;
+        for (const auto& root : m_roots)
+            visible = visible || is_under(dir, root.get());
+        if (visible)
+        {
+            ++iter;
+            continue;
+        }
+
+        {
+            std::lock_guard<std::recursive_mutex> lock(m_ui_mutex);
+            dir->CollapseFiles(iter->second);
+        }
+
+        // Selected files may have gone into the group.
+        const DirNode* const collapsed = dir.get();
+        const ULONGLONG below = iter->second;
+        m_selection.erase(std::remove_if(m_selection.begin(), m_selection.end(), [collapsed, below](const std::shared_ptr<Node>& node){ return node->AsFile() && node->AsFile()->GetSize() < below && node->GetParent().get() == collapsed; }), m_selection.end());
+        m_sunburst->SetSelection(m_selection);
 
-        SetRoot(dir);
-        back = dir;
+        iter = m_expanded.erase(iter);
     }
+}
 
-    assert(m_back_stack.size() > m_back_current);
-    m_back_stack.resize(++m_back_current);
-    m_back_stack.emplace_back(back);
+void MainWindow::Speculate()
+{
+    // A click to zoom in usually follows hovering over a directory for a
+    // moment, so lay out the directory in advance; see LayoutThread.
+    const std::shared_ptr<Node> node = m_hover_node;
+    if (!node || !node->AsDir() || node->AsRecycleBin() || !is_root_finished(node) || !m_scanner.IsComplete())
+        return;
+    if (m_roots.size() == 1 && node == m_roots[0])
+        return;
+    if (m_layout_request.m_roots.empty() || m_layout_request.m_max_depth || m_layout_request.m_max_arcs)
+        return;
 
-    InvalidateRect(m_hwnd, nullptr, false);
+    const std::shared_ptr<DirNode> dir = std::static_pointer_cast<DirNode>(node->AsDir()->shared_from_this());
+
+    // Zooming in expands grouped small files, which changes the directory
+    // and would invalidate the speculative layout.
+    for (const auto& file : dir->CopyFiles())
+    {
+        if (file->AsAggregate())
+            return;
+    }
+
+    LayoutRequest request = m_layout_request;
+    request.m_roots.clear();
+    request.m_roots.emplace_back(dir);
+    request.m_requested = GetMicroseconds();
+    m_layout.Speculate(request);
 }
 
 void MainWindow::Up()
@@ -1248,49 +2415,150 @@ void MainWindow::Refresh(bool all)
 
 void MainWindow::Rescan(const std::shared_ptr<DirNode>& dir)
 {
-#ifdef DEBUG
-    if (dir->IsFake())
-        return;
-#endif
+    std::vector<std::shared_ptr<DirNode>> dirs;
+    dirs.emplace_back(dir);
+    Rescan(dirs);
+}
 
-    if (!m_scanner.IsComplete())
+void MainWindow::Rescan(const std::vector<std::shared_ptr<DirNode>>& dirs)
+{
+    if (!m_scanner.IsComplete() || m_deleter)
     {
         MessageBeep(0xffffffff);
         return;
     }
 
-    bool compressed = false;
+    // The selection may be inside the subtrees being replaced.
+    ClearSelection();
+
+    std::vector<std::shared_ptr<DirNode>> starts;
+    for (const auto& dir : dirs)
     {
-        std::wstring path;
-        dir->GetFullPath(path);
-        strip_separator(path);
+#ifdef DEBUG
+        if (dir->IsFake())
+            continue;
+#endif
+
+        bool compressed = false;
+        {
+            std::wstring path;
+            dir->GetFullPath(path);
+            strip_separator(path);
+
+            if (!is_drive(path.c_str()))
+            {
+                WIN32_FIND_DATA fd;
+                HANDLE hFind = FindFirstFile(path.c_str(), &fd);
+                if (hFind != INVALID_HANDLE_VALUE)
+                {
+                    if (fd.dwFileAttributes & FILE_ATTRIBUTE_COMPRESSED)
+                        compressed = true;
+                    FindClose(hFind);
+                }
+            }
+        }
+
+        // Scan into a shadow so the old subtree stays visible until the new
+        // one is ready.  Top level roots have no parent to swap a shadow
+        // into, so they're cleared and rescanned in place.
+        std::shared_ptr<DirNode> shadow = dir->MakeShadow();
 
-        if (!is_drive(path.c_str()))
         {
-            WIN32_FIND_DATA fd;
-            HANDLE hFind = FindFirstFile(path.c_str(), &fd);
-            if (hFind != INVALID_HANDLE_VALUE)
+            std::lock_guard<std::recursive_mutex> lock(m_ui_mutex);
+
+            if (shadow)
+            {
+                shadow->SetCompressed(compressed);
+            }
+            else
             {
-                if (fd.dwFileAttributes & FILE_ATTRIBUTE_COMPRESSED)
-                    compressed = true;
-                FindClose(hFind);
+                dir->Clear();
+                dir->SetCompressed(compressed);
             }
         }
+
+        starts.emplace_back(shadow ? shadow : dir);
     }
 
+    if (starts.empty())
+        return;
+
+    // One start for all of them; each start cancels the scan in progress.
+    m_scanner.Start(starts);
+
+    SetFrameProgress(true);
+
+    SetTimer(m_hwnd, TIMER_PROGRESS, INTERVAL_PROGRESS, nullptr);
+    InvalidateRect(m_hwnd, nullptr, false);
+}
+
+static std::shared_ptr<DirNode> find_replacement(const std::shared_ptr<DirNode>& node, const std::shared_ptr<DirNode>& original, const std::shared_ptr<DirNode>& shadow)
+{
+    std::vector<const WCHAR*> names;
+    std::shared_ptr<DirNode> walk = node;
+    while (walk && walk != original)
     {
-        std::lock_guard<std::recursive_mutex> lock(m_ui_mutex);
+        names.emplace_back(walk->GetName());
+        walk = walk->GetParent();
+    }
+
+    if (!walk)
+        return node;
 
-        dir->Clear();
-        dir->SetCompressed(compressed);
+    // Find the same path in the shadow, or else its nearest ancestor that
+    // still exists.
+    std::shared_ptr<DirNode> found = shadow;
+    for (auto name = names.rbegin(); name != names.rend(); ++name)
+    {
+        std::shared_ptr<DirNode> next;
+        for (const auto& dir : found->CopyDirs())
+        {
+            if (!wcsicmp(dir->GetName(), *name))
+            {
+                next = dir;
+                break;
+            }
+        }
+        if (!next)
+            break;
+        found = next;
     }
+    return found;
+}
 
-    SetFrameProgress(true);
+void MainWindow::ReplaceRescannedDirs()
+{
+    std::vector<ScannerThread::Replaced> replaced;
+    m_scanner.TakeReplaced(replaced);
+    if (replaced.empty())
+        return;
 
-    m_scanner.Start(dir);
+    for (const auto& r : replaced)
+    {
+        for (auto& root : m_roots)
+            root = find_replacement(root, r.first, r.second);
+        for (auto& root : m_original_roots)
+            root = find_replacement(root, r.first, r.second);
+        for (auto& back : m_back_stack)
+            back = find_replacement(back, r.first, r.second);
+    }
 
-    SetTimer(m_hwnd, TIMER_PROGRESS, INTERVAL_PROGRESS, nullptr);
+    m_hover_node.reset();
+    m_hover_free = false;
+
+    // Repaint now, so the sunburst no longer refers to the old subtrees
+    // before they're handed off to be torn down.
     InvalidateRect(m_hwnd, nullptr, false);
+    UpdateWindow(m_hwnd);
+
+    // Cached layouts would otherwise keep the old subtrees alive.
+    std::vector<std::shared_ptr<DirNode>> originals;
+    for (const auto& r : replaced)
+        originals.emplace_back(r.first);
+    m_layout.EvictReplaced(originals);
+
+    for (const auto& r : replaced)
+        ReclaimInBackground(r.first);
 }
 
 void MainWindow::SetFrameProgress(bool working)
@@ -1492,7 +2760,7 @@ void MainWindow::DrawNodeInfo(DirectHwndRenderTarget& t, D2D1_RECT_F rect, const
 #endif
 
             D2D1_COLOR_F oldColor = t.TextBrush()->GetColor();
-            m_sunburst.FormatSize(bytes, text, units);
+            m_sunburst->FormatSize(bytes, text, units);
 
             if (node->IsSparse() || node->IsCompressed())
                 t.TextBrush()->SetColor(D2D1::ColorF(m_dark_mode ? 0x3388ff : 0x0033ff));
@@ -1506,10 +2774,23 @@ void MainWindow::DrawNodeInfo(DirectHwndRenderTarget& t, D2D1_RECT_F rect, const
                 units.append(TEXT(" sparse"));
             else if (node->IsCompressed())
                 units.append(TEXT(" compressed"));
+            else if (node->AsAggregate())
+            {
+                std::wstring count, maxtext, maxunits;
+                FormatCount(node->AsAggregate()->CountFiles(), count);
+                m_sunburst->FormatSize(node->AsAggregate()->GetMaxSize(), maxtext, maxunits);
+                units.append(TEXT("    ("));
+                units.append(count);
+                units.append(TEXT(" Files, Largest "));
+                units.append(maxtext);
+                units.append(TEXT(" "));
+                units.append(maxunits);
+                units.append(TEXT(")"));
+            }
             else if (!g_show_free_space && node->AsDrive() && node->AsDrive()->GetFreeSpace())
             {
                 std::wstring freetext, freeunits;
-                m_sunburst.FormatSize(node->AsDrive()->GetFreeSpace()->GetFreeSize(), freetext, freeunits);
+                m_sunburst->FormatSize(node->AsDrive()->GetFreeSpace()->GetFreeSize(), freetext, freeunits);
                 units.append(TEXT("    ("));
                 units.append(freetext);
                 units.append(TEXT(" "));
@@ -1541,6 +2822,25 @@ void MainWindow::DrawNodeInfo(DirectHwndRenderTarget& t, D2D1_RECT_F rect, const
             text = TEXT("Dirs");
             t.WriteText(t.TextFormat(), rectLine.left + m_cxNumberArea + padding, rectLine.top, rectLine, text);
             rectLine.top += t.FontSize();
+
+            // Per-volume breakdown, when the root contains mounted volumes.
+            std::vector<VolumeUsage> volumes;
+            if (!node->GetParent())
+                m_scanner.GetVolumeBreakdown(std::static_pointer_cast<DirNode>(node), volumes);
+            for (const auto& volume : volumes)
+            {
+                std::wstring path;
+                m_sunburst->FormatSize(volume.m_size, text, units);
+                volume.m_dir->GetFullPath(path);
+                units.append(TEXT(" on "));
+                units.append(path);
+
+                rectNumber = rectLine;
+                rectNumber.right = FLOAT(m_cxNumberArea);
+                t.WriteText(t.TextFormat(), 0.0f, rectNumber.top, rectNumber, text, WTO_RIGHT_ALIGN);
+                t.WriteText(t.TextFormat(), rectLine.left + m_cxNumberArea + padding, rectLine.top, rectLine, units, WTO_CLIP);
+                rectLine.top += t.FontSize();
+            }
         }
     }
 
@@ -1564,8 +2864,46 @@ void MainWindow::DrawAppInfo(DirectHwndRenderTarget& t, D2D1_RECT_F rect)
         rectDbgInfo.bottom -= m_margin_reserve;
         rectDbgInfo.left = summaryRect.right + m_dpi.ScaleF(24);
 
-        swprintf_s(sz, _countof(sz), TEXT("%u nodes / %u paints"), CountNodes(), s_counter);
-        t.WriteText(t.TextFormat(), rectDbgInfo.left, 0.0f, rectDbgInfo, sz, wcslen(sz), WTO_BOTTOM_ALIGN);
+        swprintf_s(sz, _countof(sz), TEXT("%u nodes / %u paints / %llu KB reclaiming"), CountNodes(), s_counter, GetPendingReclaimBytes() / 1024);
+        text = sz;
+
+        swprintf_s(sz, _countof(sz), TEXT(" / depth %zu, %zu arcs, %lld us"), m_progressive.GetDepth(), m_progressive.GetArcs(), m_progressive.GetLayoutTime());
+        text.append(sz);
+        if (m_progressive.IsActive())
+        {
+            swprintf_s(sz, _countof(sz), TEXT(" (budget %lld us)"), m_progressive.GetBudget());
+            text.append(sz);
+        }
+
+        swprintf_s(sz, _countof(sz), TEXT(" / layout latency %lld us, %ld done, %ld dropped"), m_layout.GetLatency(), m_layout.GetCompleted(), m_layout.GetDropped());
+        text.append(sz);
+
+        size_t cache_bytes;
+        size_t cache_count;
+        LONG cache_hits;
+        LONG cache_misses;
+        m_layout.GetCacheStats(cache_bytes, cache_count, cache_hits, cache_misses);
+        swprintf_s(sz, _countof(sz), TEXT(" / layout cache %zu, %zu KB, %ld hits, %ld misses"), cache_count, cache_bytes / 1024, cache_hits, cache_misses);
+        text.append(sz);
+
+        LONG speculated;
+        LONG speculate_canceled;
+        LONG speculate_used;
+        m_layout.GetSpeculationStats(speculated, speculate_canceled, speculate_used);
+        swprintf_s(sz, _countof(sz), TEXT(" / speculated %ld, %ld canceled, %ld used"), speculated, speculate_canceled, speculate_used);
+        text.append(sz);
+
+        std::vector<ScanTelemetry> telemetry;
+        GetScanTelemetry(telemetry);
+        for (const auto& volume : telemetry)
+        {
+            swprintf_s(sz, _countof(sz), TEXT(" %u threads, %llu/sec, %llu us (%s)"), volume.threads, volume.entries_per_sec, volume.latency_us, volume.reason);
+            text.append(TEXT(" / "));
+            text.append(volume.volume);
+            text.append(sz);
+        }
+
+        t.WriteText(t.TextFormat(), rectDbgInfo.left, 0.0f, rectDbgInfo, text.c_str(), text.length(), WTO_BOTTOM_ALIGN);
     }
 #endif
 
@@ -1645,6 +2983,8 @@ LRESULT MainWindow::WndProc(UINT msg, WPARAM wParam, LPARAM lParam)
 
     case WM_PAINT:
         {
+            TRACE_SCOPE("Paint");
+
             m_ever_painted = true;
 
             PAINTSTRUCT ps;
@@ -1682,32 +3022,59 @@ LRESULT MainWindow::WndProc(UINT msg, WPARAM wParam, LPARAM lParam)
                 FLOAT yy = m_margin_reserve + m_top_reserve + (height - extent) / 2;
                 const D2D1_RECT_F bounds = D2D1::RectF(xx, yy, xx + extent, yy + extent);
 
-                static size_t s_gen = 0;
-                const size_t gen = ++s_gen;
-
-                Sunburst sunburst;
-                SunburstMetrics mx(m_dpi, bounds, FLOAT(m_max_extent));
-                {
-                    std::lock_guard<std::recursive_mutex> lock(m_ui_mutex);
+                m_chart_bounds = bounds;
 
-                    sunburst.UseDarkMode(m_dark_mode);
-                    sunburst.OnDpiChanged(m_dpi);
-                    sunburst.SetBounds(bounds, FLOAT(m_max_extent));
+                SunburstMetrics mx(m_dpi, bounds, FLOAT(m_max_extent), g_show_proportional_area);
+                const bool scanning = !m_scanner.IsComplete();
 
-                    // FUTURE: Only rebuild rings when something has changed?
-                    sunburst.BuildRings(mx, m_roots);
-                    m_hover_node = sunburst.HitTest(mx, pt, &m_hover_free);
-                    sunburst.RenderRings(m_directRender, mx, m_hover_node);
+                // Ask for a layout that matches the current inputs.  It's
+                // built on the layout thread, and when it differs from the
+                // latest one, WMU_LAYOUTREADY causes another paint.
+                {
+                    LayoutRequest request;
+                    request.m_roots = m_roots;
+                    request.m_dpi = m_dpi;
+                    request.m_bounds = bounds;
+                    request.m_max_extent = FLOAT(m_max_extent);
+                    request.m_dark_mode = m_dark_mode;
+                    request.m_show_free_space = g_show_free_space;
+                    request.m_proportional_area = g_show_proportional_area;
+                    request.m_color_mode = g_color_mode;
+                    m_progressive.Apply(request, scanning);
+                    request.m_requested = GetMicroseconds();
+                    m_layout.Request(m_hwnd, request);
+                    m_layout_request = request;
                 }
 
-                if (gen == s_gen)
+                // Meanwhile, paint the latest layout that's been completed.
+                std::shared_ptr<Sunburst> latest = m_layout.GetLatest();
+                if (latest && latest != m_sunburst)
                 {
-                    m_sunburst = std::move(sunburst);
+                    latest->SetArcTextFitCache(&m_arc_text_fits);
+                    latest->SetSelection(m_selection);
+                    m_progressive.Measure(*latest);
                 }
                 else
                 {
-                    m_hover_node.reset();
-                    m_hover_free = false;
+                    latest = m_sunburst;
+                }
+
+                {
+                    std::lock_guard<std::recursive_mutex> lock(m_ui_mutex);
+
+                    // Until a layout for the current bounds arrives (e.g.
+                    // while resizing), scale the latest one to fit.
+                    D2D1::Matrix3x2F transform;
+                    if (get_layout_transform(*latest, bounds, transform))
+                        pTarget->SetTransform(transform);
+
+                    SunburstMetrics layout_mx(*latest);
+                    latest->BuildDisplayList(&m_directRender, layout_mx, m_sunburst.get());
+                    m_sunburst = std::move(latest);
+                    m_hover_node = HitTest(pt, &m_hover_free);
+                    m_sunburst->RenderRings(m_directRender, layout_mx, m_hover_node);
+
+                    pTarget->SetTransform(D2D1::Matrix3x2F::Identity());
                 }
 
                 m_buttons.RenderButtons(m_directRender);
@@ -1782,7 +3149,7 @@ LShowTotal:
 
                     std::wstring text;
                     std::wstring units;
-                    m_sunburst.FormatSize(bytes, text, units);
+                    m_sunburst->FormatSize(bytes, text, units);
                     text.append(TEXT(" "));
                     text.append(units);
 
@@ -1835,12 +3202,18 @@ LShowTotal:
 
             const std::shared_ptr<Node> hover(m_hover_node);
             const bool hover_free = m_hover_free;
-            SunburstMetrics mx(m_sunburst);
-            m_hover_node = m_sunburst.HitTest(mx, pt, &m_hover_free);
+            m_hover_node = HitTest(pt, &m_hover_free);
 
             if (hover != m_hover_node || hover_free != m_hover_free)
                 InvalidateRect(m_hwnd, nullptr, false);
 
+            if (hover != m_hover_node)
+            {
+                KillTimer(m_hwnd, TIMER_SPECULATE);
+                if (m_hover_node && m_hover_node->AsDir())
+                    SetTimer(m_hwnd, TIMER_SPECULATE, INTERVAL_SPECULATE, nullptr);
+            }
+
             if (hover)
             {
                 TRACKMOUSEEVENT track = { sizeof(track) };
@@ -1854,12 +3227,49 @@ LShowTotal:
         }
         break;
     case WM_MOUSELEAVE:
+        KillTimer(m_hwnd, TIMER_SPECULATE);
         m_hover_node.reset();
         m_hover_free = false;
         m_buttons.OnCancelMode();
         InvalidateRect(m_hwnd, nullptr, false);
         break;
 
+    case WMU_LAYOUTREADY:
+        InvalidateRect(m_hwnd, nullptr, false);
+        break;
+
+    case WMU_BULKDELETE:
+        if (m_deleter)
+        {
+            if (wParam == BDM_DONE)
+            {
+                m_deleter->Finish();
+                m_deleter.reset();
+
+                std::vector<std::shared_ptr<Node>> deleted;
+                deleted.swap(m_deleting);
+                RemoveDeleted(deleted);
+            }
+            else
+            {
+                m_deleter->UpdateProgress();
+            }
+        }
+        break;
+
+    case WMU_EXPANDED:
+        {
+            ULONGLONG below = 0;
+            std::shared_ptr<DirNode> dir = m_expander.Finish(&below);
+            if (wParam && dir)
+            {
+                m_expanded.emplace_back(std::move(dir), below);
+                CollapseExpanded();
+                InvalidateRect(m_hwnd, nullptr, false);
+            }
+        }
+        break;
+
     case WM_TIMER:
         if (wParam == TIMER_PROGRESS)
         {
@@ -1867,9 +3277,15 @@ LShowTotal:
             {
                 KillTimer(m_hwnd, wParam);
                 SetFrameProgress(false);
+                ReplaceRescannedDirs();
             }
             InvalidateRect(m_hwnd, nullptr, false);
         }
+        else if (wParam == TIMER_SPECULATE)
+        {
+            KillTimer(m_hwnd, wParam);
+            Speculate();
+        }
         break;
 
     case WM_LBUTTONDOWN:
@@ -1879,9 +3295,11 @@ LShowTotal:
             pt.x = GET_X_LPARAM(lParam);
             pt.y = GET_Y_LPARAM(lParam);
 
-            SunburstMetrics mx(m_sunburst);
-            std::shared_ptr<Node> node = m_sunburst.HitTest(mx, pt);
-            Expand(node);
+            std::shared_ptr<Node> node = HitTest(pt);
+            if (wParam & MK_CONTROL)
+                ToggleSelection(node);
+            else
+                Expand(node);
 
             m_buttons.OnMouseMessage(msg, &pt);
 
@@ -1906,8 +3324,7 @@ LShowTotal:
             pt.x = GET_X_LPARAM(lParam);
             pt.y = GET_Y_LPARAM(lParam);
 
-            SunburstMetrics mx(m_sunburst);
-            std::shared_ptr<Node> node = m_sunburst.HitTest(mx, pt);
+            std::shared_ptr<Node> node = HitTest(pt);
 
             POINT ptScreen = pt;
             ClientToScreen(m_hwnd, &ptScreen);
@@ -1978,6 +3395,9 @@ LShowTotal:
         case VK_RIGHT:
             Forward();
             break;
+        case VK_ESCAPE:
+            ClearSelection();
+            break;
         default:
             goto LDefault;
         }
@@ -2054,7 +3474,6 @@ LShowTotal:
                                       DarkModeMode::Auto);
             m_dark_mode = DarkModeOnThemeChanged(m_hwnd, dmm);
             m_buttons.UseDarkMode(m_dark_mode);
-            m_sunburst.UseDarkMode(m_dark_mode);
             m_directRender.ReleaseDeviceResources();
             InvalidateRect(m_hwnd, nullptr, true);
             UpdateWindow(m_hwnd);
@@ -2142,6 +3561,10 @@ void MainWindow::ContextMenu(const POINT& ptScreen, const std::shared_ptr<Node>&
             return;
     }
 
+    // Recycle and Delete act on the whole selection when the node is part
+    // of it.
+    const bool bulk = (node && m_selection.size() > 1 && std::find(m_selection.begin(), m_selection.end(), node) != m_selection.end());
+
     const int nPos = node ? 0 : 1;
     HMENU hmenu = LoadMenu(m_hinst, MAKEINTRESOURCE(IDR_CONTEXT_MENU));
     HMENU hmenuSub = GetSubMenu(hmenu, nPos);
@@ -2159,6 +3582,13 @@ void MainWindow::ContextMenu(const POINT& ptScreen, const std::shared_ptr<Node>&
         DeleteMenu(hmenuSub, IDM_RESCAN, MF_BYCOMMAND);
         DeleteMenu(hmenuSub, IDM_OPEN_DIRECTORY, MF_BYCOMMAND);
     }
+    if (file && file->AsAggregate())
+    {
+        // The individual files aren't known.
+        DeleteMenu(hmenuSub, IDM_OPEN_FILE, MF_BYCOMMAND);
+        DeleteMenu(hmenuSub, IDM_RECYCLE_ENTRY, MF_BYCOMMAND);
+        DeleteMenu(hmenuSub, IDM_DELETE_ENTRY, MF_BYCOMMAND);
+    }
     if (file || !parent)
     {
         DeleteMenu(hmenuSub, IDM_HIDE_DIRECTORY, MF_BYCOMMAND);
@@ -2179,6 +3609,14 @@ void MainWindow::ContextMenu(const POINT& ptScreen, const std::shared_ptr<Node>&
 
     if (g_use_compressed_size)
         CheckMenuItem(hmenuSub, IDM_OPTION_COMPRESSED, MF_BYCOMMAND|MF_CHECKED);
+    if (g_use_size_on_disk)
+        CheckMenuItem(hmenuSub, IDM_OPTION_SIZEONDISK, MF_BYCOMMAND|MF_CHECKED);
+    if (g_count_links_once)
+        CheckMenuItem(hmenuSub, IDM_OPTION_LINKSONCE, MF_BYCOMMAND|MF_CHECKED);
+    if (g_cross_mount_points)
+        CheckMenuItem(hmenuSub, IDM_OPTION_CROSSMOUNTS, MF_BYCOMMAND|MF_CHECKED);
+    if (g_group_small_files)
+        CheckMenuItem(hmenuSub, IDM_OPTION_GROUPSMALL, MF_BYCOMMAND|MF_CHECKED);
     if (g_show_free_space)
         CheckMenuItem(hmenuSub, IDM_OPTION_FREESPACE, MF_BYCOMMAND|MF_CHECKED);
     if (g_show_names)
@@ -2189,6 +3627,12 @@ void MainWindow::ContextMenu(const POINT& ptScreen, const std::shared_ptr<Node>&
         CheckMenuItem(hmenuSub, IDM_OPTION_PROPORTION, MF_BYCOMMAND|MF_CHECKED);
     if (g_show_dontscan_anyway)
         CheckMenuItem(hmenuSub, IDM_OPTION_SCANDONTSCAN, MF_BYCOMMAND|MF_CHECKED);
+    if (g_resume_scans)
+        CheckMenuItem(hmenuSub, IDM_OPTION_RESUMESCANS, MF_BYCOMMAND|MF_CHECKED);
+    if (g_scan_disk_order)
+        CheckMenuItem(hmenuSub, IDM_OPTION_DISKORDER, MF_BYCOMMAND|MF_CHECKED);
+    if (g_scan_low_priority)
+        CheckMenuItem(hmenuSub, IDM_OPTION_LOWPRIORITY, MF_BYCOMMAND|MF_CHECKED);
     CheckMenuRadioItem(hmenuSub, IDM_OPTION_PLAIN, IDM_OPTION_HEATMAP, IDM_OPTION_PLAIN + g_color_mode, MF_BYCOMMAND|MF_CHECKED);
     CheckMenuRadioItem(hmenuSub, IDM_OPTION_AUTOCOLOR, IDM_OPTION_DARKMODE, IDM_OPTION_AUTOCOLOR + g_syscolor_mode, MF_BYCOMMAND|MF_CHECKED);
 #ifdef DEBUG
@@ -2230,6 +3674,23 @@ void MainWindow::ContextMenu(const POINT& ptScreen, const std::shared_ptr<Node>&
         }
     }
 
+    if (bulk)
+    {
+        WCHAR sz[100];
+        MENUITEMINFO mii = { sizeof(mii) };
+        mii.fMask = MIIM_FTYPE|MIIM_STRING;
+        mii.fType = MFT_STRING;
+        mii.dwTypeData = sz;
+
+        swprintf_s(sz, _countof(sz), TEXT("Rec&ycle %zu Selected Items"), m_selection.size());
+        mii.cch = UINT(wcslen(sz));
+        SetMenuItemInfo(hmenuSub, IDM_RECYCLE_ENTRY, false, &mii);
+
+        swprintf_s(sz, _countof(sz), TEXT("&Delete %zu Selected Items"), m_selection.size());
+        mii.cch = UINT(wcslen(sz));
+        SetMenuItemInfo(hmenuSub, IDM_DELETE_ENTRY, false, &mii);
+    }
+
     const UINT idm = TrackPopupMenu(hmenuSub, TPM_RIGHTBUTTON|TPM_RETURNCMD, ptScreen.x, ptScreen.y, 0, m_hwnd, nullptr);
     switch (idm)
     {
@@ -2249,11 +3710,15 @@ void MainWindow::ContextMenu(const POINT& ptScreen, const std::shared_ptr<Node>&
         break;
 
     case IDM_RECYCLE_ENTRY:
-        if (node && ShellRecycle(m_hwnd, path.c_str()))
+        if (bulk)
+            DeleteNodes(m_selection, false/*permanent*/);
+        else if (node && ShellRecycle(m_hwnd, path.c_str()))
             DeleteNode(node);
         break;
     case IDM_DELETE_ENTRY:
-        if (node && ShellDelete(m_hwnd, path.c_str()))
+        if (bulk)
+            DeleteNodes(m_selection, true/*permanent*/);
+        else if (node && ShellDelete(m_hwnd, path.c_str()))
             DeleteNode(node);
         break;
     case IDM_EMPTY_RECYCLEBIN:
@@ -2283,6 +3748,22 @@ LAskRescan:
         if (IDYES == MessageBox(m_hwnd, TEXT("The setting will take effect in the next scan.\n\nRescan now?"), TEXT("Confirm Rescan"), MB_YESNOCANCEL|MB_ICONQUESTION))
             Refresh(true/*all*/);
         break;
+    case IDM_OPTION_SIZEONDISK:
+        g_use_size_on_disk = !g_use_size_on_disk;
+        WriteRegLong(TEXT("UseSizeOnDisk"), g_use_size_on_disk);
+        goto LAskRescan;
+    case IDM_OPTION_LINKSONCE:
+        g_count_links_once = !g_count_links_once;
+        WriteRegLong(TEXT("CountHardLinksOnce"), g_count_links_once);
+        goto LAskRescan;
+    case IDM_OPTION_CROSSMOUNTS:
+        g_cross_mount_points = !g_cross_mount_points;
+        WriteRegLong(TEXT("CrossMountPoints"), g_cross_mount_points);
+        goto LAskRescan;
+    case IDM_OPTION_GROUPSMALL:
+        g_group_small_files = !g_group_small_files;
+        WriteRegLong(TEXT("GroupSmallFiles"), g_group_small_files);
+        goto LAskRescan;
     case IDM_OPTION_FREESPACE:
         g_show_free_space = !g_show_free_space;
         WriteRegLong(TEXT("ShowFreeSpace"), g_show_free_space);
@@ -2304,6 +3785,11 @@ LAskRescan:
         InvalidateRect(m_hwnd, nullptr, false);
         break;
 
+    case IDM_EXPORT_PNG:
+    case IDM_EXPORT_SVG:
+        ExportImage(idm == IDM_EXPORT_SVG);
+        break;
+
     case IDM_OPTION_DONTSCAN:
         if (ConfigureDontScanFiles(m_hinst, m_hwnd))
             goto LAskRescan;
@@ -2312,6 +3798,18 @@ LAskRescan:
         g_show_dontscan_anyway = !g_show_dontscan_anyway;
         WriteRegLong(TEXT("ShowDontScanAnyway"), g_show_dontscan_anyway);
         goto LAskRescan;
+    case IDM_OPTION_RESUMESCANS:
+        g_resume_scans = !g_resume_scans;
+        WriteRegLong(TEXT("ResumeInterruptedScans"), g_resume_scans);
+        break;
+    case IDM_OPTION_DISKORDER:
+        g_scan_disk_order = !g_scan_disk_order;
+        WriteRegLong(TEXT("ScanInDiskOrder"), g_scan_disk_order);
+        break;
+    case IDM_OPTION_LOWPRIORITY:
+        g_scan_low_priority = !g_scan_low_priority;
+        WriteRegLong(TEXT("ScanAtLowPriority"), g_scan_low_priority);
+        break;
 
     case IDM_OPTION_PLAIN:
     case IDM_OPTION_RAINBOW:
@@ -2412,7 +3910,6 @@ void MainWindow::OnDpiChanged(const DpiScaler& dpi)
         ReleaseDC(m_hwnd, hdc);
     }
 
-    m_sunburst.OnDpiChanged(dpi);
     m_buttons.OnDpiChanged(dpi);
 
     RECT rcClient;
@@ -2498,21 +3995,38 @@ LRESULT MainWindow::OnNcDestroy()
     return 0;
 }
 
+static std::shared_ptr<Node> find_volume(const std::shared_ptr<Node>& node)
+{
+    for (std::shared_ptr<Node> n = node; n; n = n->GetParent())
+    {
+        if ((n->AsDrive() || n->AsMountPoint()) && n->AsDir()->GetFreeSpace())
+            return n;
+    }
+    return nullptr;
+}
+
+// Call this without holding the UI mutex; mount points query their volume
+// before locking it.
+static void update_free_space(const std::shared_ptr<Node>& volume, std::recursive_mutex& ui_mutex)
+{
+    if (volume && volume->AsDrive())
+    {
+        std::lock_guard<std::recursive_mutex> lock(ui_mutex);
+        volume->AsDrive()->AddFreeSpace();
+    }
+    else if (volume)
+    {
+        volume->AsMountPoint()->AddFreeSpace(ui_mutex);
+    }
+}
+
 void MainWindow::DeleteNode(const std::shared_ptr<Node>& node)
 {
     assert(node);
     if (!node)
         return;
 
-    std::shared_ptr<Node> drive;
-    for (std::shared_ptr<Node> n = node; n; n = n->GetParent())
-    {
-        if (n->AsDrive() && n->AsDrive()->GetFreeSpace())
-        {
-            drive = n;
-            break;
-        }
-    }
+    const std::shared_ptr<Node> volume = find_volume(node);
 
     const std::shared_ptr<Node> parent = node->GetParent();
     assert(parent);
@@ -2522,10 +4036,213 @@ void MainWindow::DeleteNode(const std::shared_ptr<Node>& node)
     {
         std::lock_guard<std::recursive_mutex> lock(m_ui_mutex);
         parent->AsDir()->DeleteChild(node);
-        if (drive)
-            drive->AsDrive()->AddFreeSpace();
     }
 
+    update_free_space(volume, m_ui_mutex);
+
+    InvalidateRect(m_hwnd, nullptr, false);
+}
+
+void MainWindow::DeleteNodes(const std::vector<std::shared_ptr<Node>>& nodes, const bool permanent)
+{
+    if (m_deleter)
+    {
+        MessageBeep(0xffffffff);
+        return;
+    }
+
+    // Items inside other selected directories go along with them.
+    std::vector<std::shared_ptr<Node>> top;
+    for (const auto& node : nodes)
+    {
+        bool covered = false;
+        for (std::shared_ptr<Node> up = node->GetParent(); up && !covered; up = up->GetParent())
+            covered = (std::find(nodes.begin(), nodes.end(), up) != nodes.end());
+        if (!covered)
+            top.emplace_back(node);
+    }
+
+    std::vector<std::wstring> paths;
+    for (const auto& node : top)
+    {
+        std::wstring path;
+        node->GetFullPath(path);
+        paths.emplace_back(std::move(path));
+    }
+
+    if (permanent)
+    {
+        // Permanent deletes run in the background; the tree is updated
+        // when WMU_BULKDELETE reports that it's done.
+        m_deleter = ShellDeleteMany(m_hwnd, paths, WMU_BULKDELETE);
+        if (m_deleter)
+        {
+            m_deleting = std::move(top);
+            ClearSelection();
+        }
+        return;
+    }
+
+    if (ShellRecycleMany(m_hwnd, paths))
+        RemoveDeleted(top);
+}
+
+void MainWindow::RemoveDeleted(const std::vector<std::shared_ptr<Node>>& nodes)
+{
+    // Probe the items before taking the lock; paths don't need it.  Only
+    // items the file system reports as not found are removed.  The rest
+    // were skipped, failed, or cancelled (or can't be queried, e.g. access
+    // denied).  Directories among them may have lost part of their
+    // contents, so they're rescanned.
+    std::vector<bool> gone(nodes.size());
+    {
+        std::wstring path;
+        for (size_t ii = 0; ii < nodes.size(); ++ii)
+        {
+            nodes[ii]->GetFullPath(path);
+            strip_separator(path);
+            if (GetFileAttributes(path.c_str()) == INVALID_FILE_ATTRIBUTES)
+            {
+                const DWORD err = GetLastError();
+                gone[ii] = (err == ERROR_FILE_NOT_FOUND || err == ERROR_PATH_NOT_FOUND);
+            }
+        }
+    }
+
+    // Apply the whole batch under one lock, and requery the free space of
+    // each affected volume once at the end.
+    std::vector<std::shared_ptr<Node>> volumes;
+    std::vector<std::shared_ptr<DirNode>> rescan;
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_ui_mutex);
+
+        for (size_t ii = 0; ii < nodes.size(); ++ii)
+        {
+            const std::shared_ptr<Node>& node = nodes[ii];
+            const std::shared_ptr<DirNode> parent = node->GetParent();
+            if (!parent)
+                continue;
+
+            const std::shared_ptr<Node> volume = find_volume(node);
+            if (volume && std::find(volumes.begin(), volumes.end(), volume) == volumes.end())
+                volumes.emplace_back(volume);
+
+            if (gone[ii])
+                parent->DeleteChild(node);
+            else if (node->AsDir())
+                rescan.emplace_back(std::static_pointer_cast<DirNode>(node->AsDir()->shared_from_this()));
+        }
+    }
+
+    for (const auto& volume : volumes)
+        update_free_space(volume, m_ui_mutex);
+
+    ClearSelection();
+    InvalidateRect(m_hwnd, nullptr, false);
+
+    if (!rescan.empty())
+        Rescan(rescan);
+}
+
+void MainWindow::ExportImage(const bool svg)
+{
+    std::wstring file(svg ? TEXT("Elucidisk.svg") : TEXT("Elucidisk.png"));
+    if (!ShellChooseSaveFile(m_hwnd,
+                             svg ? TEXT("Export as SVG") : TEXT("Export as PNG"),
+                             svg ? TEXT("SVG Image") : TEXT("PNG Image"),
+                             svg ? TEXT("svg") : TEXT("png"), file))
+        return;
+
+    // The export doesn't depend on the window size, so it uses its own
+    // layout with square bounds at the requested size.
+    const LONG size = std::min<LONG>(std::max<LONG>(ReadRegLong(TEXT("ExportImageSize"), 2048), 256), 16384);
+    const D2D1_RECT_F bounds = D2D1::RectF(0, 0, FLOAT(size), FLOAT(size));
+
+    HRESULT hr = S_OK;
+    RasterScene scene;
+    Sunburst sunburst;
+    SunburstMetrics mx(m_dpi, bounds, FLOAT(size), g_show_proportional_area);
+    {
+        std::lock_guard<std::recursive_mutex> lock(m_ui_mutex);
+
+        sunburst.UseDarkMode(m_dark_mode);
+        sunburst.SetChartOptions(g_show_free_space, g_show_proportional_area, g_color_mode);
+        sunburst.SetArcTextFitCache(&m_arc_text_fits);
+        sunburst.OnDpiChanged(m_dpi);
+        sunburst.SetBounds(bounds, FLOAT(size));
+        sunburst.BuildRings(mx, m_roots);
+
+        // Writing the SVG can take a while, so what it needs from the nodes
+        // is copied now and the document is written without the lock.
+        if (svg)
+            sunburst.SnapshotSvgData();
+        else
+            sunburst.MakeRasterScene(mx, scene);
+    }
+
+    if (svg)
+    {
+        StreamWriter out;
+        if (out.Open(file.c_str()))
+            sunburst.WriteSvg(&m_directRender, mx, out);
+        if (!out.Close())
+            hr = HRESULT_FROM_WIN32(out.GetError());
+    }
+    else
+    {
+        // The largest size needs 1 GiB, so a failed allocation must be
+        // reported rather than end the process.
+        const SIZE_T bytes = SIZE_T(size) * SIZE_T(size) * sizeof(uint32_t);
+        uint32_t* pixels = static_cast<uint32_t*>(VirtualAlloc(nullptr, bytes, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE));
+        if (!pixels)
+        {
+            hr = E_OUTOFMEMORY;
+        }
+        else
+        {
+            RasterizeSunburst(scene, pixels, size, size, 0/*all cores*/);
+            WritePngFile(file.c_str(), pixels, UINT(size), UINT(size), &hr);
+            VirtualFree(pixels, 0, MEM_RELEASE);
+        }
+    }
+
+    if (FAILED(hr))
+    {
+        WCHAR sz[1024];
+        swprintf_s(sz, _countof(sz), TEXT("Unable to export \"%s\" (error 0x%08X)."), file.c_str(), hr);
+        MessageBox(m_hwnd, sz, TEXT("Elucidisk"), MB_OK|MB_ICONERROR);
+    }
+}
+
+void MainWindow::ToggleSelection(const std::shared_ptr<Node>& node)
+{
+    // Only things that can be deleted can be selected.  Deleting a mount
+    // point would delete the contents of the mounted volume.
+    if (!node || !node->GetParent() || !is_root_finished(node) ||
+        node->AsFreeSpace() || node->AsDrive() || node->IsRecycleBin() || node->AsAggregate() ||
+        node->IsMountPoint())
+    {
+        MessageBeep(0xffffffff);
+        return;
+    }
+
+    const auto iter = std::find(m_selection.begin(), m_selection.end(), node);
+    if (iter != m_selection.end())
+        m_selection.erase(iter);
+    else
+        m_selection.emplace_back(node);
+
+    m_sunburst->SetSelection(m_selection);
+    InvalidateRect(m_hwnd, nullptr, false);
+}
+
+void MainWindow::ClearSelection()
+{
+    if (m_selection.empty())
+        return;
+
+    m_selection.clear();
+    m_sunburst->SetSelection(m_selection);
     InvalidateRect(m_hwnd, nullptr, false);
 }
 
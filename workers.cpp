@@ -0,0 +1,60 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+#include "workers.h"
+#include <thread>
+
+WorkerPool& WorkerPool::Get()
+{
+    // Never destroyed:  the workers are detached and may still be waiting
+    // on the pool while the process exits.
+    static WorkerPool* s_pool = new WorkerPool;
+    return *s_pool;
+}
+
+bool WorkerPool::TryRun(const unsigned threads, const std::function<void()>& work)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    if (m_work)
+        return false;
+
+    while (m_threads + 1 < threads)
+    {
+        std::thread(ThreadProc, this).detach();
+        ++m_threads;
+    }
+
+    m_work = &work;
+    m_wanted = threads ? threads - 1 : 0;
+    lock.unlock();
+    m_wake.notify_all();
+
+    work();
+
+    // Workers that haven't picked up the work yet are too late to help.
+    lock.lock();
+    m_wanted = 0;
+    m_done.wait(lock, [this]() { return !m_running; });
+    m_work = nullptr;
+    return true;
+}
+
+void WorkerPool::ThreadProc(WorkerPool* pThis)
+{
+    std::unique_lock<std::mutex> lock(pThis->m_mutex);
+    while (true)
+    {
+        pThis->m_wake.wait(lock, [pThis]() { return pThis->m_wanted > 0; });
+        --pThis->m_wanted;
+        ++pThis->m_running;
+
+        const std::function<void()>& work = *pThis->m_work;
+        lock.unlock();
+        work();
+        lock.lock();
+
+        if (!--pThis->m_running)
+            pThis->m_done.notify_all();
+    }
+}
@@ -0,0 +1,41 @@
+// Copyright (c) 2026 Christopher Antos
+// License: http://opensource.org/licenses/MIT
+
+// A persistent pool of worker threads for short bursts of parallel work.
+//
+// Starting threads costs more than building a typical ring, so the threads
+// are started the first time they're needed and then wait for more work.
+// Only one caller uses the pool at a time; a caller that finds it busy does
+// the work by itself instead of waiting.
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+class WorkerPool
+{
+public:
+    static WorkerPool&      Get();
+
+    // Runs work on the calling thread and on up to threads-1 workers, and
+    // returns once every call has returned.  The work must divide itself
+    // between however many calls actually run; the calling thread alone
+    // must be able to do all of it.  Returns false without running anything
+    // if the pool is busy.
+    bool                    TryRun(unsigned threads, const std::function<void()>& work);
+
+private:
+                            WorkerPool() = default;
+    static void             ThreadProc(WorkerPool* pThis);
+
+private:
+    std::mutex              m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    const std::function<void()>* m_work = nullptr;
+    unsigned                m_threads = 0;  // Workers started so far.
+    unsigned                m_wanted = 0;   // Workers still to join the current work.
+    unsigned                m_running = 0;  // Workers running the current work.
+};